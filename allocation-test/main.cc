@@ -0,0 +1,159 @@
+#include "allocation_counter.h"
+#include "frame_arena.h"
+#include "shader_program.h"
+#include "util.h"
+#include "window.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <unistd.h>
+#include <cstdio>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// checks that the per-frame paths of gl::demo stop touching the heap once
+// they're warmed up. "arena" needs no GL, "gl" needs a display and exits with
+// 77 (skipped) without one. "demo path args..." runs a demo, which checks its
+// own frames with -p allocation_check, or skips like "gl".
+
+namespace {
+
+constexpr auto WarmupFrames = 4;
+constexpr auto Frames = 16;
+
+constexpr auto SkipReturnCode = 77;
+
+// resets the arena and runs a frame, for the warm-up and then for the frames
+// measured; returns the heap allocations of the measured frames
+template<typename Frame>
+gl::allocation_stats steady_state_allocations(gl::frame_arena &arena, Frame frame)
+{
+    for (int i = 0; i < WarmupFrames; ++i) {
+        arena.reset();
+        frame(i);
+    }
+    const auto start = gl::allocation_totals();
+    for (int i = WarmupFrames; i < WarmupFrames + Frames; ++i) {
+        arena.reset();
+        frame(i);
+    }
+    return gl::allocation_totals() - start;
+}
+
+bool check(const char *name, const gl::allocation_stats &allocations)
+{
+    if (allocations.count != 0) {
+        std::printf("%s: %zu heap allocations, %zu bytes\n", name, allocations.count, allocations.bytes);
+        return false;
+    }
+    std::printf("%s: no heap allocations\n", name);
+    return true;
+}
+
+int test_arena()
+{
+    // the counter must see allocations that go to the heap, or the checks
+    // below prove nothing
+    {
+        const auto start = gl::allocation_totals();
+        std::pmr::vector<int> v(100, std::pmr::new_delete_resource());
+        if ((gl::allocation_totals() - start).count == 0) {
+            std::printf("allocation counter isn't linked in\n");
+            return 1;
+        }
+    }
+
+    // small, so the first frames overflow it and reset() grows it
+    gl::frame_arena arena(256);
+
+    // what a frame typically builds: growing vectors, strings past the small
+    // string buffer, nodes. the sizes cycle within the warm-up, the largest
+    // frame decides the capacity
+    const auto frame = [&arena](int i) {
+        auto *resource = arena.resource();
+        const auto count = 100 * (1 + i % WarmupFrames);
+
+        std::pmr::vector<glm::mat4> transforms(resource);
+        for (int j = 0; j < count; ++j)
+            transforms.push_back(glm::mat4(static_cast<float>(j)));
+
+        std::pmr::map<int, std::pmr::string> names(resource);
+        for (int j = 0; j < count / 10; ++j)
+            names.emplace(j, std::pmr::string(64, static_cast<char>('a' + j % 26), resource));
+
+        std::pmr::vector<std::pmr::vector<int>> lists(resource);
+        for (int j = 0; j < 8; ++j)
+            lists.emplace_back(static_cast<std::size_t>(count), j);
+    };
+
+    const bool ok = check("frame_arena", steady_state_allocations(arena, frame));
+    std::printf("arena capacity %zu bytes\n", arena.capacity());
+    return ok ? 0 : 1;
+}
+
+int test_gl()
+{
+    if (!glfwInit()) {
+        std::printf("no display, skipped\n");
+        return SkipReturnCode;
+    }
+
+    constexpr auto Width = 64;
+    constexpr auto Height = 64;
+    gl::window window(Width, Height, "allocation-test", false);
+
+    gl::shader_program program;
+    program.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/depth_only.vert");
+    program.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/depth_only.frag");
+    program.link();
+
+    gl::frame_arena arena;
+
+    bool ok = check("uniform_location", steady_state_allocations(arena, [&program](int) {
+                        program.bind();
+                        program.set_uniform("mvp", glm::mat4(1.0f));
+                    }));
+
+    constexpr auto Path = "allocation-test.ppm";
+    ok &= check("dump_frame_to_file", steady_state_allocations(arena, [&arena](int) {
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    dump_frame_to_file(Path, Width, Height, arena.resource());
+                }));
+    std::remove(Path);
+
+    return ok ? 0 : 1;
+}
+
+int run_demo(char *argv[])
+{
+    if (!glfwInit()) {
+        std::printf("no display, skipped\n");
+        return SkipReturnCode;
+    }
+    glfwTerminate();
+
+    execv(argv[0], argv);
+    std::printf("failed to run %s\n", argv[0]);
+    return 1;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string_view test = argc > 1 ? argv[1] : "";
+    if (test == "arena")
+        return test_arena();
+    if (test == "gl")
+        return test_gl();
+    if (test == "demo" && argc > 2)
+        return run_demo(argv + 2);
+    std::fprintf(stderr, "usage: %s arena|gl|demo path args...\n", argv[0]);
+    return 1;
+}
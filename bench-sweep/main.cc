@@ -0,0 +1,417 @@
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// runs demos headless over a grid of parameters and collects frame time
+// percentiles, GPU pass timings and memory use into CSV and JSON.
+//
+// each line of the sweep file is a demo invocation where {a,b,c} marks an
+// axis; all axes of a line are combined. a leading NAME=value sets an
+// environment variable, so LP_NUM_THREADS={1,2,4} sweeps llvmpipe threads.
+// an axis can declare how frame time is expected to grow with it, e.g.
+// grid={8,16,32}^3 for a cube of instances; growth past that is flagged.
+//
+//   # demo and arguments
+//   tiling -w {256,512,1024} -p rows={12,24,48}
+//   LP_NUM_THREADS={1,4} xcube -p grid={4,8,16}^3
+//
+// with no display (or -x) demos run under xvfb-run; -s forces Mesa's
+// llvmpipe so CPU-only machines give comparable numbers.
+
+namespace {
+
+struct axis
+{
+    std::string label;
+    std::size_t token; // token replaced by the values
+    std::string prefix, suffix;
+    std::vector<std::string> values;
+    double expected_exponent = 1.0;
+};
+
+struct sweep_line
+{
+    std::vector<std::string> tokens; // environment, demo, arguments
+    std::vector<axis> axes;
+};
+
+struct run
+{
+    int line;
+    std::string demo;
+    std::vector<std::string> environment;
+    std::vector<std::string> arguments;
+    std::vector<std::string> values; // one per axis of the line
+    bool ok = false;
+    std::vector<std::pair<std::string, double>> metrics;
+    std::vector<std::pair<std::string, double>> passes;
+
+    double metric(const std::string &name) const
+    {
+        for (const auto &[key, value] : metrics) {
+            if (key == name)
+                return value;
+        }
+        return 0;
+    }
+};
+
+const char *const MetricNames[] = { "frames", "mean_ms", "p50_ms", "p90_ms", "p99_ms",
+                                    "max_ms", "gpu_ms", "pool_bytes", "max_rss_kib" };
+
+std::vector<std::string> split(const std::string &s, char separator)
+{
+    std::vector<std::string> parts;
+    std::istringstream stream(s);
+    std::string part;
+    while (std::getline(stream, part, separator))
+        parts.push_back(part);
+    return parts;
+}
+
+bool is_environment(const std::string &token)
+{
+    const auto equals = token.find('=');
+    return equals != std::string::npos && equals > 0 &&
+           std::all_of(token.begin(), token.begin() + equals, [](char c) { return std::isupper(c) || c == '_'; });
+}
+
+std::vector<sweep_line> load_sweep(const char *path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::fprintf(stderr, "bench-sweep: failed to open %s\n", path);
+        std::exit(1);
+    }
+
+    std::vector<sweep_line> lines;
+    std::string text;
+    while (std::getline(file, text)) {
+        std::istringstream stream(text);
+        sweep_line line;
+        std::string token;
+        while (stream >> token)
+            line.tokens.push_back(token);
+        if (line.tokens.empty() || line.tokens[0][0] == '#')
+            continue;
+
+        for (std::size_t i = 0; i < line.tokens.size(); ++i) {
+            const auto &token = line.tokens[i];
+            const auto open = token.find('{');
+            const auto close = token.find('}');
+            if (open == std::string::npos || close == std::string::npos || close < open)
+                continue;
+            axis a;
+            a.token = i;
+            a.prefix = token.substr(0, open);
+            a.values = split(token.substr(open + 1, close - open - 1), ',');
+            a.suffix = token.substr(close + 1);
+            if (!a.suffix.empty() && a.suffix[0] == '^') {
+                a.expected_exponent = std::atof(a.suffix.c_str() + 1);
+                a.suffix.clear();
+            }
+            a.label = a.prefix;
+            if (!a.label.empty() && a.label.back() == '=')
+                a.label.pop_back();
+            if (a.label.empty() && i > 0)
+                a.label = line.tokens[i - 1];
+            line.axes.push_back(a);
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::vector<run> expand(const std::vector<sweep_line> &lines)
+{
+    std::vector<run> runs;
+    for (int l = 0; l < static_cast<int>(lines.size()); ++l) {
+        const auto &line = lines[l];
+        std::vector<std::size_t> index(line.axes.size(), 0);
+        for (;;) {
+            auto tokens = line.tokens;
+            run r;
+            r.line = l;
+            for (std::size_t i = 0; i < line.axes.size(); ++i) {
+                const auto &a = line.axes[i];
+                tokens[a.token] = a.prefix + a.values[index[i]] + a.suffix;
+                r.values.push_back(a.values[index[i]]);
+            }
+            std::size_t t = 0;
+            while (t < tokens.size() && is_environment(tokens[t]))
+                r.environment.push_back(tokens[t++]);
+            if (t == tokens.size()) {
+                std::fprintf(stderr, "bench-sweep: line %d has no demo\n", l + 1);
+                std::exit(1);
+            }
+            r.demo = tokens[t++];
+            r.arguments.assign(tokens.begin() + t, tokens.end());
+            runs.push_back(r);
+
+            // next combination, last axis fastest
+            std::size_t i = line.axes.size();
+            while (i > 0 && ++index[i - 1] == line.axes[i - 1].values.size())
+                index[--i] = 0;
+            if (i == 0)
+                break;
+        }
+    }
+    return runs;
+}
+
+void execute(run &r, const std::string &build_dir, int frames, bool use_xvfb, bool software)
+{
+    std::string command = "cd '" + build_dir + "/" + r.demo + "' && env";
+    if (software)
+        command += " LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe";
+    for (const auto &variable : r.environment)
+        command += " " + variable;
+    if (use_xvfb)
+        command += " xvfb-run -a -s '-screen 0 4096x4096x24'";
+    command += " ./" + r.demo;
+    for (const auto &argument : r.arguments)
+        command += " '" + argument + "'";
+    command += " -p benchmark=" + std::to_string(frames) + " 2>&1";
+
+    std::printf("%s\n", command.c_str());
+    std::fflush(stdout);
+
+    auto *pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        std::fprintf(stderr, "bench-sweep: failed to run %s\n", r.demo.c_str());
+        return;
+    }
+
+    constexpr const auto Tag = "benchmark: ";
+    char buffer[4096];
+    while (std::fgets(buffer, sizeof(buffer), pipe)) {
+        const std::string output(buffer);
+        const auto tag = output.find(Tag);
+        if (tag == std::string::npos)
+            continue;
+        std::istringstream stream(output.substr(tag + std::string(Tag).size()));
+        std::string field;
+        while (stream >> field) {
+            const auto equals = field.find('=');
+            if (equals == std::string::npos)
+                continue;
+            const auto key = field.substr(0, equals);
+            const auto value = std::atof(field.c_str() + equals + 1);
+            if (key.compare(0, 5, "pass.") == 0)
+                r.passes.emplace_back(key.substr(5), value);
+            else
+                r.metrics.emplace_back(key, value);
+        }
+        r.ok = true;
+    }
+
+    const auto status = pclose(pipe);
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        r.ok = false;
+    if (!r.ok)
+        std::fprintf(stderr, "bench-sweep: %s failed\n", r.demo.c_str());
+}
+
+struct scaling_flag
+{
+    std::string demo;
+    std::string axis;
+    std::string from, to;
+    double elasticity;
+    double expected;
+};
+
+// frame time growth between neighbouring points of each axis, the other
+// axes held fixed. elasticity 1 means frame time doubles when the value does
+std::vector<scaling_flag> check_scaling(const std::vector<sweep_line> &lines, const std::vector<run> &runs,
+                                        double threshold)
+{
+    std::vector<scaling_flag> flags;
+    for (const auto &r0 : runs) {
+        if (!r0.ok)
+            continue;
+        const auto &line = lines[r0.line];
+        for (std::size_t a = 0; a < line.axes.size(); ++a) {
+            const auto &values = line.axes[a].values;
+            const auto position = std::find(values.begin(), values.end(), r0.values[a]) - values.begin();
+            if (position + 1 >= static_cast<long>(values.size()))
+                continue;
+
+            // the run with only this axis moved to its next value
+            auto key = r0.values;
+            key[a] = values[position + 1];
+            const auto r1 = std::find_if(runs.begin(), runs.end(),
+                                         [&r0, &key](const run &r) { return r.line == r0.line && r.values == key; });
+            if (r1 == runs.end() || !r1->ok)
+                continue;
+
+            const auto x0 = std::atof(r0.values[a].c_str());
+            const auto x1 = std::atof(r1->values[a].c_str());
+            const auto t0 = r0.metric("p50_ms");
+            const auto t1 = r1->metric("p50_ms");
+            if (x0 <= 0 || x1 <= 0 || x0 == x1 || t0 <= 0 || t1 <= 0)
+                continue;
+
+            const auto elasticity = std::log(t1 / t0) / std::log(x1 / x0);
+            const auto expected = line.axes[a].expected_exponent;
+            if (elasticity > threshold * expected)
+                flags.push_back({ r0.demo, line.axes[a].label, r0.values[a], r1->values[a], elasticity, expected });
+        }
+    }
+    return flags;
+}
+
+std::string config_string(const std::vector<sweep_line> &lines, const run &r)
+{
+    std::string config;
+    for (std::size_t i = 0; i < r.values.size(); ++i) {
+        if (!config.empty())
+            config += ';';
+        config += lines[r.line].axes[i].label + "=" + r.values[i];
+    }
+    return config;
+}
+
+std::string json_string(const std::string &s)
+{
+    std::string quoted = "\"";
+    for (auto c : s) {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void write_csv(const std::string &path, const std::vector<sweep_line> &lines, const std::vector<run> &runs)
+{
+    auto *out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "bench-sweep: failed to write %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(out, "demo,config,ok");
+    for (const auto *name : MetricNames)
+        std::fprintf(out, ",%s", name);
+    std::fprintf(out, ",passes\n");
+    for (const auto &r : runs) {
+        std::fprintf(out, "%s,%s,%d", r.demo.c_str(), config_string(lines, r).c_str(), r.ok ? 1 : 0);
+        for (const auto *name : MetricNames)
+            std::fprintf(out, ",%g", r.metric(name));
+        std::string passes;
+        for (const auto &[name, ms] : r.passes)
+            passes += (passes.empty() ? "" : ";") + name + "=" + std::to_string(ms);
+        std::fprintf(out, ",%s\n", passes.c_str());
+    }
+    std::fclose(out);
+}
+
+void write_json(const std::string &path, const std::vector<sweep_line> &lines, const std::vector<run> &runs,
+                const std::vector<scaling_flag> &flags)
+{
+    auto *out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "bench-sweep: failed to write %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(out, "{\n  \"runs\": [");
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+        const auto &r = runs[i];
+        std::fprintf(out, "%s\n    { \"demo\": %s, \"ok\": %s, \"config\": {", i ? "," : "", json_string(r.demo).c_str(),
+                     r.ok ? "true" : "false");
+        for (std::size_t j = 0; j < r.values.size(); ++j)
+            std::fprintf(out, "%s %s: %s", j ? "," : "", json_string(lines[r.line].axes[j].label).c_str(),
+                         json_string(r.values[j]).c_str());
+        std::fprintf(out, " }, \"metrics\": {");
+        for (std::size_t j = 0; j < r.metrics.size(); ++j)
+            std::fprintf(out, "%s %s: %g", j ? "," : "", json_string(r.metrics[j].first).c_str(), r.metrics[j].second);
+        std::fprintf(out, " }, \"passes\": {");
+        for (std::size_t j = 0; j < r.passes.size(); ++j)
+            std::fprintf(out, "%s %s: %g", j ? "," : "", json_string(r.passes[j].first).c_str(), r.passes[j].second);
+        std::fprintf(out, " } }");
+    }
+    std::fprintf(out, "\n  ],\n  \"nonlinear\": [");
+    for (std::size_t i = 0; i < flags.size(); ++i) {
+        const auto &f = flags[i];
+        std::fprintf(out, "%s\n    { \"demo\": %s, \"axis\": %s, \"from\": %s, \"to\": %s, \"elasticity\": %.3f, "
+                          "\"expected\": %g }",
+                     i ? "," : "", json_string(f.demo).c_str(), json_string(f.axis).c_str(),
+                     json_string(f.from).c_str(), json_string(f.to).c_str(), f.elasticity, f.expected);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    std::fclose(out);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::string build_dir = BUILD_DIR;
+    std::string output = "sweep";
+    int frames = 120;
+    double threshold = 1.25;
+    bool use_xvfb = std::getenv("DISPLAY") == nullptr;
+    bool software = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:o:n:t:xs")) != -1) {
+        switch (opt)
+        {
+        case 'b':
+            build_dir = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'n':
+            frames = std::atoi(optarg);
+            break;
+        case 't':
+            threshold = std::atof(optarg);
+            break;
+        case 'x':
+            use_xvfb = true;
+            break;
+        case 's':
+            software = true;
+            break;
+        }
+    }
+
+    if (optind >= argc) {
+        std::fprintf(stderr, "usage: %s [-b build dir] [-o output prefix] [-n frames] [-t threshold] [-x] [-s] sweep-file\n",
+                     argv[0]);
+        return 1;
+    }
+
+    const auto lines = load_sweep(argv[optind]);
+    auto runs = expand(lines);
+
+    for (auto &r : runs)
+        execute(r, build_dir, frames, use_xvfb, software);
+
+    const auto flags = check_scaling(lines, runs, threshold);
+    for (const auto &f : flags) {
+        std::printf("non-linear: %s %s %s -> %s, frame time elasticity %.2f (expected %g)\n", f.demo.c_str(),
+                    f.axis.c_str(), f.from.c_str(), f.to.c_str(), f.elasticity, f.expected);
+    }
+
+    write_csv(output + ".csv", lines, runs);
+    write_json(output + ".json", lines, runs, flags);
+
+    const auto failed = std::count_if(runs.begin(), runs.end(), [](const run &r) { return !r.ok; });
+    std::printf("%d runs, %d failed, %d non-linear steps, results in %s.csv and %s.json\n",
+                static_cast<int>(runs.size()), static_cast<int>(failed), static_cast<int>(flags.size()),
+                output.c_str(), output.c_str());
+    return failed ? 1 : 0;
+}
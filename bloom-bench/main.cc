@@ -0,0 +1,148 @@
+#include "window.h"
+#include "blur_effect.h"
+#include "bloom_effect.h"
+#include "gpu_timer.h"
+#include "framebuffer_pool.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+// compares the cost of a gaussian glow of a given radius (in pixels) done
+// with repeated blur_effect passes vs a bloom_effect mip chain, for RGBA8,
+// packed float (R11F_G11F_B10F) and half float (RGBA16F) targets.
+//
+// the MB columns estimate the memory traffic of one glow, assuming every
+// pass reads each source texel from memory once (taps hit the texture cache)
+// and writes each target texel once; the blended composite reads and writes
+// the RGBA8 screen. GB/s is that traffic over the measured GPU time.
+
+namespace {
+
+void fill_source(int width, int height)
+{
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // a few bright squares, content doesn't change the cost much
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(1, 1, 1, 1);
+    for (int i = 0; i < 8; ++i) {
+        const auto size = std::max(width, height) / 16;
+        glScissor((i * width) / 8, (i * height) / 8, size, size);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
+
+constexpr std::size_t ScreenPixelSize = 4;
+
+double blur_traffic(int width, int height, int passes, std::size_t pixel_size)
+{
+    // passes x (horizontal + vertical) x (read + write), plus the composite
+    const double pixels = static_cast<double>(width) * height;
+    return passes * 2 * 2 * pixels * pixel_size + pixels * 2 * ScreenPixelSize;
+}
+
+double bloom_traffic(int width, int height, int levels, std::size_t pixel_size)
+{
+    const auto level_pixels = [&](int level) { return static_cast<double>(width >> level) * (height >> level); };
+    double bytes = 0;
+    for (int i = 1; i <= levels; ++i)
+        bytes += (level_pixels(i - 1) + level_pixels(i)) * pixel_size;
+    for (int i = levels - 1; i >= 1; --i)
+        bytes += (level_pixels(i + 1) + level_pixels(i)) * pixel_size;
+    bytes += level_pixels(1) * pixel_size + level_pixels(0) * 2 * ScreenPixelSize;
+    return bytes;
+}
+
+template<typename Effect, typename Render>
+double time_effect(Effect &effect, const gl::gpu_timer &timer, int iterations, Render render)
+{
+    double total = 0;
+    for (int i = 0; i < iterations; ++i) {
+        effect.bind();
+        fill_source(effect.width(), effect.height());
+
+        timer.begin();
+        render();
+        timer.end();
+        total += timer.elapsed_ms();
+    }
+    return total / iterations;
+}
+
+void bench_format(const char *format_name, int width, int height, int iterations, gl::framebuffer_pool &pool,
+                  const gl::gpu_timer &timer)
+{
+    constexpr const auto MaxKernelRadius = 32;
+    constexpr const auto MaxBloomLevels = 8;
+
+    const auto format = gl::color_format(format_name);
+    const auto pixel_size = gl::bytes_per_pixel(format);
+    const gl::framebuffer_format source_format = { { format }, GL_NONE };
+    gl::blur_effect blur(pool, width, height, 4, 2.0f, source_format);
+    gl::bloom_effect bloom(pool, width, height, MaxBloomLevels, source_format);
+
+    for (int radius = 4; radius <= 256; radius *= 2) {
+        // N passes of sigma s add up to sigma s * sqrt(N)
+        const auto kernel_radius = std::min(radius, MaxKernelRadius);
+        const auto passes = static_cast<int>(std::ceil(std::pow(static_cast<float>(radius) / kernel_radius, 2.0f)));
+        blur.set_kernel(kernel_radius, 0.5f * kernel_radius);
+
+        // each level doubles the radius, the first one covers ~4 pixels
+        const auto levels = std::clamp(static_cast<int>(std::log2(radius)) - 1, 1, bloom.max_levels());
+        bloom.set_levels(levels);
+
+        const auto blur_ms = time_effect(blur, timer, iterations, [&] { blur.render(width, height, passes); });
+        const auto bloom_ms = time_effect(bloom, timer, iterations, [&] { bloom.render(width, height); });
+
+        // MB per ms is GB/s
+        const auto blur_mb = blur_traffic(width, height, passes, pixel_size) * 1e-6;
+        const auto bloom_mb = bloom_traffic(width, height, levels, pixel_size) * 1e-6;
+
+        std::printf("%16s %8d %12d %10.3f %10.1f %8.1f %12d %10.3f %10.1f %8.1f\n", format_name, radius, passes,
+                    blur_ms, blur_mb, blur_mb / blur_ms, levels, bloom_ms, bloom_mb, bloom_mb / bloom_ms);
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 800;
+    int height = 800;
+    int iterations = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h:n:")) != -1) {
+        switch (opt)
+        {
+        case 'w':
+            width = std::atoi(optarg);
+            break;
+        case 'h':
+            height = std::atoi(optarg);
+            break;
+        case 'n':
+            iterations = std::atoi(optarg);
+            break;
+        }
+    }
+
+    gl::window w(width, height, "bloom-bench");
+
+    gl::framebuffer_pool pool;
+    gl::gpu_timer timer;
+
+    std::printf("%16s %8s %12s %10s %10s %8s %12s %10s %10s %8s\n", "format", "radius", "blur passes", "blur ms",
+                "blur MB", "GB/s", "bloom levels", "bloom ms", "bloom MB", "GB/s");
+
+    for (const char *format_name : { "rgba8", "r11f_g11f_b10f", "rgba16f" })
+        bench_format(format_name, width, height, iterations, pool, timer);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+namespace gl {
+
+// allocation_counter.cc replaces the global operator new and delete with
+// malloc and free plus two relaxed atomic adds, so the cost is the same
+// whether anyone looks at the counts or not. it's a library of its own that
+// only programs built on gl::demo (which reads the counts for
+// -p allocations and -p allocation_check) and allocation-test link: in
+// libcommon.a it would replace operator new in every program, because
+// every program needs operator new and the linker searches common before
+// libstdc++. allocations made directly with malloc, e.g. by the GL driver,
+// aren't counted.
+struct allocation_stats
+{
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+};
+
+// operator new calls and bytes requested since the program started, on all
+// threads
+allocation_stats allocation_totals();
+
+inline allocation_stats operator-(const allocation_stats &a, const allocation_stats &b)
+{
+    return { a.count - b.count, a.bytes - b.bytes };
+}
+
+} // namespace gl
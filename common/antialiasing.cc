@@ -0,0 +1,216 @@
+#include "antialiasing.h"
+
+#include "panic.h"
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string>
+
+namespace gl {
+
+namespace {
+
+constexpr auto JitterPhases = 8;
+constexpr auto HistoryWeight = 0.9f;
+
+const framebuffer_format SceneFormat = { { GL_RGBA8 }, GL_DEPTH24_STENCIL8 };
+const framebuffer_format HistoryFormat = { { GL_RGBA16F }, GL_NONE };
+
+float halton(int index, int base)
+{
+    float result = 0.0f;
+    float f = 1.0f;
+    while (index > 0) {
+        f /= base;
+        result += f * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+} // namespace
+
+antialiasing::settings antialiasing::parse(std::string_view name)
+{
+    if (name == "none")
+        return { mode::none, 0 };
+    if (name == "fxaa")
+        return { mode::fxaa, 0 };
+    if (name == "taa")
+        return { mode::taa, 0 };
+    for (int samples : { 2, 4, 8, 16 }) {
+        if (name == "msaa" + std::to_string(samples))
+            return { mode::msaa, samples };
+    }
+    panic("unknown anti-aliasing mode %s\n", std::string(name).c_str());
+    return {};
+}
+
+antialiasing::settings antialiasing::multisample(int samples)
+{
+    if (samples < 0)
+        panic("invalid sample count %d\n", samples);
+    return { samples > 0 ? mode::msaa : mode::none, samples };
+}
+
+antialiasing::antialiasing(const settings &settings, int width, int height)
+    : settings_(settings)
+    , width_(width)
+    , height_(height)
+{
+    if (settings_.type == mode::none)
+        return;
+
+    if (settings_.type == mode::msaa) {
+        auto format = SceneFormat;
+        format.samples = settings_.samples;
+        scene_.reset(new gl::framebuffer(width_, height_, format));
+        return;
+    }
+
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    resolve_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    resolve_program_.add_shader(GL_FRAGMENT_SHADER, settings_.type == mode::taa ? COMMON_SHADER_DIR "/taa_resolve.frag"
+                                                                                  : COMMON_SHADER_DIR "/fxaa.frag");
+    resolve_program_.link();
+
+    scene_.reset(new gl::framebuffer(width_, height_, SceneFormat));
+    if (settings_.type == mode::taa) {
+        for (auto &history : history_)
+            history.reset(new gl::framebuffer(width_, height_, HistoryFormat));
+    }
+}
+
+antialiasing::~antialiasing()
+{
+    if (scene_ && framebuffer::screen() == scene_->handle())
+        framebuffer::set_screen(0);
+}
+
+int antialiasing::still_frames() const
+{
+    return settings_.type == mode::taa ? 2 * JitterPhases : 1;
+}
+
+void antialiasing::reset()
+{
+    frame_ = 0;
+}
+
+glm::mat4 antialiasing::jitter(const glm::mat4 &projection) const
+{
+    if (settings_.type != mode::taa)
+        return projection;
+    // offsetting clip space x, y by jitter * w shifts the image by a constant
+    // amount in NDC for perspective and orthographic projections alike
+    return glm::translate(glm::mat4(1), glm::vec3(jitter_, 0)) * projection;
+}
+
+void antialiasing::set_view_projection(const glm::mat4 &view_projection)
+{
+    view_projection_ = glm::translate(glm::mat4(1), glm::vec3(-jitter_, 0)) * view_projection;
+}
+
+void antialiasing::begin_frame()
+{
+    if (!scene_)
+        return;
+
+    if (settings_.type == mode::taa) {
+        // halton(2, 3) offsets in [-0.5, 0.5) pixels, in NDC units
+        const int index = frame_ % JitterPhases + 1;
+        jitter_ = glm::vec2((halton(index, 2) - 0.5f) * 2.0f / width_, (halton(index, 3) - 0.5f) * 2.0f / height_);
+        prev_view_projection_ = view_projection_;
+    }
+
+    framebuffer::set_screen(scene_->handle());
+    framebuffer::unbind();
+}
+
+void antialiasing::end_frame()
+{
+    if (!scene_)
+        return;
+
+    framebuffer::set_screen(0);
+
+    if (settings_.type == mode::msaa) {
+        blit_to_screen(*scene_);
+        ++frame_;
+        return;
+    }
+
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    const GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+
+    if (settings_.type == mode::taa) {
+        resolve_taa();
+    } else {
+        framebuffer::unbind();
+        glViewport(0, 0, width_, height_);
+
+        glActiveTexture(GL_TEXTURE0);
+        scene_->bind_texture();
+
+        resolve_program_.bind();
+        quad_.bind();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    if (depth_test)
+        glEnable(GL_DEPTH_TEST);
+    if (blend)
+        glEnable(GL_BLEND);
+    if (cull_face)
+        glEnable(GL_CULL_FACE);
+
+    ++frame_;
+}
+
+void antialiasing::resolve_taa()
+{
+    const auto &history = history_[history_index_];
+    const auto &prev_history = history_[history_index_ ^ 1];
+
+    history->bind();
+    glViewport(0, 0, width_, height_);
+
+    glActiveTexture(GL_TEXTURE0);
+    scene_->bind_texture();
+    glActiveTexture(GL_TEXTURE1);
+    scene_->bind_depth_texture();
+    glActiveTexture(GL_TEXTURE2);
+    prev_history->bind_texture();
+
+    resolve_program_.bind();
+    // NDC of this frame (unjittered) to NDC of the previous one
+    resolve_program_.set_uniform("reprojection", prev_view_projection_ * glm::inverse(view_projection_));
+    resolve_program_.set_uniform("unjitter", -jitter_);
+    resolve_program_.set_uniform("historyValid", frame_ > 0 ? 1 : 0);
+    resolve_program_.set_uniform("historyWeight", HistoryWeight);
+
+    quad_.bind();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    blit_to_screen(*history);
+
+    history_index_ ^= 1;
+}
+
+void antialiasing::blit_to_screen(const framebuffer &source) const
+{
+    // resolves the samples when the source is multisampled
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source.handle());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    framebuffer::unbind();
+}
+
+} // namespace gl
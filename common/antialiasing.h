@@ -0,0 +1,83 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "framebuffer.h"
+#include "geometry.h"
+#include "shader_program.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <string_view>
+
+namespace gl {
+
+// anti-aliasing of the frame. the frame is rendered offscreen by redirecting
+// framebuffer::unbind() to a scene target between begin_frame() and
+// end_frame(), which resolves it into the (single sampled) default
+// framebuffer: msaa renders into a multisampled target resolved with a blit,
+// fxaa and taa into a single sampled one resolved with a shader pass. none
+// renders straight into the default framebuffer.
+//
+// taa offsets the projection by a halton(2, 3) sub-pixel jitter every frame
+// and blends the frame with the history reprojected through the depth and
+// the camera motion, clamped to the color range of the 3x3 neighborhood so
+// moving objects and disocclusions don't ghost.
+class antialiasing : private noncopyable
+{
+public:
+    enum class mode { none, msaa, fxaa, taa };
+
+    struct settings
+    {
+        mode type = mode::taa;
+        int samples = 0; // for msaa
+    };
+
+    // "none", "fxaa", "taa", "msaa2", "msaa4", "msaa8" or "msaa16"
+    static settings parse(std::string_view name);
+    // msaa, or none for 0 samples
+    static settings multisample(int samples);
+
+    antialiasing(const settings &settings, int width, int height);
+    ~antialiasing();
+
+    mode type() const { return settings_.type; }
+
+    // frames to render a still for, so the taa history converges
+    int still_frames() const;
+    // drops the taa history, e.g. when the view jumps
+    void reset();
+
+    // the projection to render the frame with, jittered for taa
+    glm::mat4 jitter(const glm::mat4 &projection) const;
+
+    // the (jittered) view-projection the frame is rendered with, for history
+    // reprojection. without it taa assumes a static camera
+    void set_view_projection(const glm::mat4 &view_projection);
+
+    void begin_frame();
+    void end_frame();
+
+private:
+    void resolve_taa();
+    void blit_to_screen(const framebuffer &source) const;
+
+    settings settings_;
+    int width_;
+    int height_;
+    int frame_ = 0;
+    glm::vec2 jitter_ = glm::vec2(0);
+    glm::mat4 view_projection_ = glm::mat4(1);
+    glm::mat4 prev_view_projection_ = glm::mat4(1);
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad_;
+    gl::shader_program resolve_program_;
+    std::unique_ptr<gl::framebuffer> scene_;
+    std::array<std::unique_ptr<gl::framebuffer>, 2> history_;
+    int history_index_ = 0;
+};
+
+} // namespace gl
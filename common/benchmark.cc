@@ -0,0 +1,109 @@
+#include "benchmark.h"
+
+#include <GLFW/glfw3.h>
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+namespace gl {
+
+namespace {
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    const auto index = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+}
+
+benchmark::benchmark(int frames, int warmup_frames)
+    : frames_(frames)
+    , warmup_frames_(warmup_frames)
+{
+    glGenQueries(2, queries_);
+    frame_ms_.reserve(frames);
+    gpu_ms_.reserve(frames);
+}
+
+benchmark::~benchmark()
+{
+    glDeleteQueries(2, queries_);
+}
+
+void benchmark::begin_frame()
+{
+    frame_start_ = glfwGetTime();
+    glQueryCounter(queries_[0], GL_TIMESTAMP);
+}
+
+void benchmark::end_frame()
+{
+    glQueryCounter(queries_[1], GL_TIMESTAMP);
+    glFinish();
+
+    if (measuring()) {
+        frame_ms_.push_back((glfwGetTime() - frame_start_) * 1e3);
+
+        GLuint64 start, end;
+        glGetQueryObjectui64v(queries_[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries_[1], GL_QUERY_RESULT, &end);
+        gpu_ms_.push_back((end - start) * 1e-6);
+    }
+
+    ++frame_;
+}
+
+bool benchmark::done() const
+{
+    return frame_ >= warmup_frames_ + frames_;
+}
+
+void benchmark::add_pass_timings(const std::vector<frame_graph::pass_timing> &timings)
+{
+    if (!measuring())
+        return;
+    for (const auto &timing : timings) {
+        auto it = std::find_if(passes_.begin(), passes_.end(),
+                               [&timing](const pass_total &pass) { return pass.name == timing.name; });
+        if (it == passes_.end())
+            it = passes_.insert(passes_.end(), { timing.name, 0.0 });
+        it->gpu_ms += timing.gpu_ms;
+    }
+}
+
+void benchmark::add_memory(const framebuffer_pool::stats &stats)
+{
+    peak_pool_bytes_ = std::max(peak_pool_bytes_, stats.allocated_bytes);
+}
+
+void benchmark::report() const
+{
+    if (frame_ms_.empty())
+        return;
+
+    auto sorted = frame_ms_;
+    std::sort(sorted.begin(), sorted.end());
+    const auto count = static_cast<double>(sorted.size());
+    const auto mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / count;
+    const auto gpu_mean = std::accumulate(gpu_ms_.begin(), gpu_ms_.end(), 0.0) / count;
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::printf("benchmark: frames=%d mean_ms=%.3f p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f gpu_ms=%.3f "
+                "pool_bytes=%zu max_rss_kib=%ld",
+                static_cast<int>(sorted.size()), mean, percentile(sorted, 0.5), percentile(sorted, 0.9),
+                percentile(sorted, 0.99), sorted.back(), gpu_mean, peak_pool_bytes_, usage.ru_maxrss);
+    for (const auto &pass : passes_) {
+        auto name = pass.name;
+        std::replace(name.begin(), name.end(), ' ', '_');
+        std::printf(" pass.%s=%.3f", name.c_str(), pass.gpu_ms / count);
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+} // namespace gl
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "frame_graph.h"
+#include "framebuffer_pool.h"
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+namespace gl {
+
+// headless benchmark runs for bench-sweep. times a fixed number of frames
+// after a warm-up and prints a single line
+//
+//   benchmark: frames=N mean_ms=... p50_ms=... ... pass.<name>=...
+//
+// frame times are wall clock and include waiting for the GPU, which is what
+// matters on software rasterizers. GPU time uses timestamp queries so it
+// doesn't collide with the TIME_ELAPSED queries of the frame graph.
+class benchmark : private noncopyable
+{
+public:
+    benchmark(int frames, int warmup_frames = 10);
+    ~benchmark();
+
+    void begin_frame();
+    void end_frame();
+    bool done() const;
+
+    // per-pass GPU times of the frame that just ended
+    void add_pass_timings(const std::vector<frame_graph::pass_timing> &timings);
+    void add_memory(const framebuffer_pool::stats &stats);
+
+    void report() const;
+
+private:
+    bool measuring() const { return frame_ >= warmup_frames_; }
+
+    struct pass_total
+    {
+        std::string name;
+        double gpu_ms;
+    };
+
+    int frames_;
+    int warmup_frames_;
+    int frame_ = 0;
+    double frame_start_ = 0;
+    GLuint queries_[2];
+    std::vector<double> frame_ms_;
+    std::vector<double> gpu_ms_;
+    std::vector<pass_total> passes_;
+    std::size_t peak_pool_bytes_ = 0;
+};
+
+} // namespace gl
@@ -0,0 +1,119 @@
+#include "bloom_effect.h"
+
+#include "panic.h"
+
+namespace gl {
+
+bloom_effect::bloom_effect(framebuffer_pool &pool, int framebuffer_width, int framebuffer_height, int max_levels,
+                           const framebuffer_format &source_format)
+    : framebuffer_width_(framebuffer_width)
+    , framebuffer_height_(framebuffer_height)
+    , pool_(pool)
+    , source_format_(source_format)
+    , level_format_{ { source_format.color_formats[0] }, GL_NONE }
+{
+    max_levels_ = 0;
+    while (max_levels_ < max_levels && (framebuffer_width >> (max_levels_ + 1)) > 0 &&
+           (framebuffer_height >> (max_levels_ + 1)) > 0)
+        ++max_levels_;
+    levels_ = max_levels_;
+
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    downsample_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    downsample_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/bloom_downsample.frag");
+    downsample_program_.link();
+    downsample_threshold_location_ = downsample_program_.uniform_location("threshold");
+
+    upsample_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    upsample_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/bloom_upsample.frag");
+    upsample_program_.link();
+    upsample_intensity_location_ = upsample_program_.uniform_location("intensity");
+    upsample_exposure_location_ = upsample_program_.uniform_location("exposure");
+}
+
+void bloom_effect::set_levels(int levels)
+{
+    if (levels < 1 || levels > max_levels())
+        panic("bloom levels %d out of range [1, %d]\n", levels, max_levels());
+    levels_ = levels;
+}
+
+void bloom_effect::bind()
+{
+    if (framebuffers_.empty())
+        framebuffers_.push_back(pool_.acquire(framebuffer_width_, framebuffer_height_, source_format_));
+    framebuffers_[0]->bind();
+    glViewport(0, 0, framebuffer_width_, framebuffer_height_);
+}
+
+void bloom_effect::render(int width, int height)
+{
+    if (framebuffers_.empty())
+        panic("bloom_effect::render() without bind()\n");
+
+    for (int i = 1; i <= levels_; ++i)
+        framebuffers_.push_back(pool_.acquire(framebuffer_width_ >> i, framebuffer_height_ >> i, level_format_));
+
+    apply(framebuffers_, width, height);
+
+    for (const auto *fb : framebuffers_)
+        pool_.release(fb);
+    framebuffers_.clear();
+}
+
+void bloom_effect::render(const std::vector<const framebuffer *> &levels, int width, int height)
+{
+    if (static_cast<int>(levels.size()) <= levels_)
+        panic("bloom_effect::render() with %d levels, needs %d\n", static_cast<int>(levels.size()), levels_ + 1);
+    apply(levels, width, height);
+}
+
+void bloom_effect::apply(const std::vector<const framebuffer *> &framebuffers, int width, int height) const
+{
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    quad_.bind();
+
+    // downsample, the threshold is only applied when reading the source
+
+    downsample_program_.bind();
+    for (int i = 1; i <= levels_; ++i) {
+        const auto &target = framebuffers[i];
+        target->bind();
+        glViewport(0, 0, target->width(), target->height());
+        framebuffers[i - 1]->bind_texture();
+        downsample_program_.set_uniform(downsample_threshold_location_, i == 1 ? threshold_ : 0.0f);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    // upsample back to level 1
+
+    upsample_program_.bind();
+    upsample_program_.set_uniform(upsample_intensity_location_, 1.0f);
+    upsample_program_.set_uniform(upsample_exposure_location_, 0.0f);
+    for (int i = levels_ - 1; i >= 1; --i) {
+        const auto &target = framebuffers[i];
+        target->bind();
+        glViewport(0, 0, target->width(), target->height());
+        framebuffers[i + 1]->bind_texture();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    // last upsample is added to the screen
+
+    gl::framebuffer::unbind();
+    glViewport(0, 0, width, height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    framebuffers[1]->bind_texture();
+    upsample_program_.set_uniform(upsample_intensity_location_, intensity_);
+    upsample_program_.set_uniform(upsample_exposure_location_, exposure_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glDisable(GL_BLEND);
+}
+
+} // namespace gl
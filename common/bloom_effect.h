@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "shader_program.h"
+#include "framebuffer_pool.h"
+#include "geometry.h"
+
+#include <vector>
+
+namespace gl {
+
+// glow using a dual filter (kawase) mip chain: the source is progressively
+// downsampled to 1/2, 1/4... resolution and upsampled back with a tent
+// filter, the last upsample is added to the screen. the glow radius doubles
+// with every level while the cost stays at a fraction of a full-screen pass.
+// the mip chain has the source's color format, so an HDR source
+// (GL_R11F_G11F_B10F, GL_RGBA16F) keeps values above 1 until the composite.
+class bloom_effect : private noncopyable
+{
+public:
+    bloom_effect(framebuffer_pool &pool, int framebuffer_width, int framebuffer_height, int max_levels = 6,
+                 const framebuffer_format &source_format = {});
+
+    int width() const { return framebuffer_width_; }
+    int height() const { return framebuffer_height_; }
+
+    int max_levels() const { return max_levels_; }
+    int levels() const { return levels_; }
+    void set_levels(int levels);
+
+    void set_threshold(float threshold) { threshold_ = threshold; }
+    void set_intensity(float intensity) { intensity_ = intensity; }
+    // > 0 tone maps the glow with 1 - exp(-exposure * c) as it is added to
+    // the screen, 0 (default) adds it as is
+    void set_exposure(float exposure) { exposure_ = exposure; }
+
+    // the mip chain is acquired from the pool in bind() and render() and
+    // released at the end of render()
+    void bind();
+    void render(int width, int height);
+
+    // for frame graphs: the caller provides the chain, levels[0] is the
+    // source (source_format(), rendered to by the caller) and levels[i] is
+    // (framebuffer_width >> i, framebuffer_height >> i) with level_format(),
+    // for i up to levels(). nothing is acquired from the pool
+    void render(const std::vector<const framebuffer *> &levels, int width, int height);
+
+    const framebuffer_format &source_format() const { return source_format_; }
+    const framebuffer_format &level_format() const { return level_format_; }
+
+private:
+    void apply(const std::vector<const framebuffer *> &levels, int width, int height) const;
+    int framebuffer_width_;
+    int framebuffer_height_;
+    int max_levels_;
+    int levels_;
+    float threshold_ = 0.0f;
+    float intensity_ = 1.0f;
+    float exposure_ = 0.0f;
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad_;
+
+    gl::shader_program downsample_program_;
+    int downsample_threshold_location_;
+
+    gl::shader_program upsample_program_;
+    int upsample_intensity_location_;
+    int upsample_exposure_location_;
+
+    framebuffer_pool &pool_;
+    framebuffer_format source_format_;
+    framebuffer_format level_format_;
+
+    // level 0 is the source, level i is (width >> i, height >> i)
+    std::vector<const gl::framebuffer *> framebuffers_;
+};
+
+} // namespace gl
@@ -0,0 +1,222 @@
+#include "blur_effect.h"
+
+#include "panic.h"
+
+#include <cmath>
+
+namespace gl {
+
+namespace {
+
+// must match the definitions in shaders/blur.frag and shaders/blur.comp
+constexpr const auto MaxRadius = 32;
+constexpr const auto TileSize = 128;
+
+}
+
+blur_effect::blur_effect(framebuffer_pool &pool, int framebuffer_width, int framebuffer_height, int radius,
+                         float sigma, const framebuffer_format &source_format)
+    : framebuffer_width_(framebuffer_width)
+    , framebuffer_height_(framebuffer_height)
+    , pool_(pool)
+    , source_format_(source_format)
+    , target_format_{ { source_format.color_formats[0] }, GL_NONE }
+{
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/blur.frag");
+    program_.link();
+    image_location_ = program_.uniform_location("image");
+    direction_location_ = program_.uniform_location("direction");
+    tap_count_location_ = program_.uniform_location("tapCount");
+    weights_location_ = program_.uniform_location("weights");
+    offsets_location_ = program_.uniform_location("offsets");
+    exposure_location_ = program_.uniform_location("exposure");
+
+    compute_program_.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/blur.comp");
+    compute_program_.link();
+    compute_direction_location_ = compute_program_.uniform_location("direction");
+    compute_radius_location_ = compute_program_.uniform_location("radius");
+    compute_weights_location_ = compute_program_.uniform_location("weights");
+
+    copy_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    copy_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/copy.frag");
+    copy_program_.link();
+    copy_exposure_location_ = copy_program_.uniform_location("exposure");
+
+    set_kernel(radius, sigma);
+}
+
+void blur_effect::set_kernel(int radius, float sigma)
+{
+    if (radius < 1 || radius > MaxRadius)
+        panic("blur radius %d out of range [1, %d]\n", radius, MaxRadius);
+    if (sigma <= 0.0f)
+        panic("invalid blur sigma %f\n", sigma);
+
+    weights_.resize(radius + 1);
+    float sum = 0.0f;
+    for (int i = 0; i <= radius; ++i) {
+        weights_[i] = std::exp(-static_cast<float>(i * i) / (2.0f * sigma * sigma));
+        sum += i == 0 ? weights_[i] : 2.0f * weights_[i];
+    }
+    for (auto &weight : weights_)
+        weight /= sum;
+
+    // merge texels (i, i + 1) into a single tap placed so that bilinear
+    // filtering returns w[i] * texel[i] + w[i + 1] * texel[i + 1]
+
+    linear_weights_.assign(1, weights_[0]);
+    linear_offsets_.assign(1, 0.0f);
+    for (int i = 1; i <= radius; i += 2) {
+        const auto w0 = weights_[i];
+        const auto w1 = i < radius ? weights_[i + 1] : 0.0f;
+        linear_weights_.push_back(w0 + w1);
+        linear_offsets_.push_back((i * w0 + (i + 1) * w1) / (w0 + w1));
+    }
+
+    program_.bind();
+    program_.set_uniform(tap_count_location_, static_cast<int>(linear_weights_.size()));
+    program_.set_uniform(weights_location_, linear_weights_);
+    program_.set_uniform(offsets_location_, linear_offsets_);
+
+    compute_program_.bind();
+    compute_program_.set_uniform(compute_radius_location_, radius);
+    compute_program_.set_uniform(compute_weights_location_, weights_);
+}
+
+void blur_effect::bind()
+{
+    if (!framebuffers_[0])
+        framebuffers_[0] = pool_.acquire(framebuffer_width_, framebuffer_height_, source_format_);
+    framebuffers_[0]->bind();
+    glViewport(0, 0, framebuffer_width_, framebuffer_height_);
+}
+
+void blur_effect::render(int width, int height, int passes)
+{
+    if (!framebuffers_[0])
+        panic("blur_effect::render() without bind()\n");
+
+    framebuffers_[1] = pool_.acquire(framebuffer_width_, framebuffer_height_, target_format_);
+
+    apply(width, height, passes);
+
+    for (auto &fb : framebuffers_) {
+        pool_.release(fb);
+        fb = nullptr;
+    }
+}
+
+void blur_effect::render(const framebuffer &source, const framebuffer &target, int width, int height, int passes)
+{
+    if (framebuffers_[0])
+        panic("blur_effect::render() with targets after bind()\n");
+
+    framebuffers_ = { &source, &target };
+    apply(width, height, passes);
+    framebuffers_ = {};
+}
+
+void blur_effect::apply(int width, int height, int passes) const
+{
+    switch (mode_) {
+    case mode::fragment:
+        render_fragment(width, height, passes);
+        break;
+    case mode::compute:
+        render_compute(width, height, passes);
+        break;
+    }
+}
+
+void blur_effect::render_fragment(int width, int height, int passes) const
+{
+    glDisable(GL_DEPTH_TEST);
+    quad_.bind();
+
+    program_.bind();
+    program_.set_uniform(image_location_, 0);
+    program_.set_uniform(exposure_location_, 0.0f);
+
+    for (int i = 0; i < passes; ++i) {
+        // 0 -> 1
+
+        framebuffers_[1]->bind();
+        glViewport(0, 0, framebuffer_width_, framebuffer_height_);
+
+        framebuffers_[0]->bind_texture();
+        program_.set_uniform(direction_location_, glm::vec2(1, 0));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        // 1 -> 0 or screen
+
+        if (i < passes - 1) {
+            framebuffers_[0]->bind();
+            glViewport(0, 0, framebuffer_width_, framebuffer_height_);
+        } else {
+            // last pass, render to screen
+            gl::framebuffer::unbind();
+            glViewport(0, 0, width, height);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            program_.set_uniform(exposure_location_, exposure_);
+        }
+
+        framebuffers_[1]->bind_texture();
+        program_.set_uniform(direction_location_, glm::vec2(0, 1));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glDisable(GL_BLEND);
+}
+
+void blur_effect::render_compute(int width, int height, int passes) const
+{
+    if (source_format_.color_formats[0] != GL_RGBA8)
+        panic("compute blur needs a GL_RGBA8 source\n");
+
+    const auto groups = [](int size) { return (size + TileSize - 1) / TileSize; };
+
+    compute_program_.bind();
+
+    for (int i = 0; i < passes; ++i) {
+        // 0 -> 1, rows
+
+        glBindImageTexture(0, framebuffers_[0]->texture_handle(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+        glBindImageTexture(1, framebuffers_[1]->texture_handle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        compute_program_.set_uniform(compute_direction_location_, glm::ivec2(1, 0));
+        glDispatchCompute(groups(framebuffer_width_), framebuffer_height_, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        // 1 -> 0, columns
+
+        glBindImageTexture(0, framebuffers_[1]->texture_handle(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+        glBindImageTexture(1, framebuffers_[0]->texture_handle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        compute_program_.set_uniform(compute_direction_location_, glm::ivec2(0, 1));
+        glDispatchCompute(groups(framebuffer_height_), framebuffer_width_, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // composite to screen
+
+    gl::framebuffer::unbind();
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    quad_.bind();
+    copy_program_.bind();
+    copy_program_.set_uniform(copy_exposure_location_, exposure_);
+    framebuffers_[0]->bind_texture();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glDisable(GL_BLEND);
+}
+
+} // namespace gl
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "shader_program.h"
+#include "framebuffer_pool.h"
+#include "geometry.h"
+
+#include <array>
+
+namespace gl {
+
+class blur_effect : private noncopyable
+{
+public:
+    enum class mode
+    {
+        fragment, // separable blur on a full-screen quad, linear sampling taps
+        compute,  // separable blur in a compute shader, rows cached in shared memory
+    };
+
+    // the source target rendered to after bind() gets source_format (depth
+    // included by default), the ping-pong targets are color only with the
+    // source's color format, so an HDR source (GL_R11F_G11F_B10F,
+    // GL_RGBA16F) stays HDR through the passes
+    blur_effect(framebuffer_pool &pool, int framebuffer_width, int framebuffer_height, int radius = 4,
+                float sigma = 2.0f, const framebuffer_format &source_format = {});
+
+    int width() const { return framebuffer_width_; }
+    int height() const { return framebuffer_height_; }
+
+    void set_kernel(int radius, float sigma);
+    void set_mode(mode m) { mode_ = m; }
+
+    // > 0 tone maps the blurred result with 1 - exp(-exposure * c) as it is
+    // added to the screen, so HDR glow compresses instead of clipping. 0
+    // (default) adds it as is
+    void set_exposure(float exposure) { exposure_ = exposure; }
+
+    // both targets are acquired from the pool in bind() and released at the
+    // end of render()
+    void bind();
+    void render(int width, int height, int passes);
+
+    // for frame graphs: the source (source_format(), rendered to by the
+    // caller) and the ping-pong target (target_format()) are provided,
+    // framebuffer_width x framebuffer_height, and nothing is acquired from the
+    // pool. the source is overwritten
+    void render(const framebuffer &source, const framebuffer &target, int width, int height, int passes);
+
+    const framebuffer_format &source_format() const { return source_format_; }
+    const framebuffer_format &target_format() const { return target_format_; }
+
+private:
+    void apply(int width, int height, int passes) const;
+    void render_fragment(int width, int height, int passes) const;
+    void render_compute(int width, int height, int passes) const;
+
+    int framebuffer_width_;
+    int framebuffer_height_;
+    mode mode_ = mode::fragment;
+    float exposure_ = 0.0f;
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad_;
+
+    // weights of texels 0..radius, used as-is by the compute path
+    std::vector<float> weights_;
+
+    // weights and offsets of the bilinear taps, used by the fragment path
+    std::vector<float> linear_weights_;
+    std::vector<float> linear_offsets_;
+
+    gl::shader_program program_;
+    int image_location_;
+    int direction_location_;
+    int tap_count_location_;
+    int weights_location_;
+    int offsets_location_;
+    int exposure_location_;
+
+    gl::shader_program compute_program_;
+    int compute_direction_location_;
+    int compute_radius_location_;
+    int compute_weights_location_;
+
+    gl::shader_program copy_program_;
+    int copy_exposure_location_;
+
+    framebuffer_pool &pool_;
+    framebuffer_format source_format_;
+    framebuffer_format target_format_;
+    std::array<const gl::framebuffer *, 2> framebuffers_ = {};
+};
+
+} // namespace gl
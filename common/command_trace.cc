@@ -0,0 +1,1441 @@
+#include "command_trace.h"
+
+#include "panic.h"
+
+#include <dlfcn.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+
+namespace gl {
+
+namespace {
+
+constexpr std::uint32_t TraceMagic = 0x52544c47; // "GLTR"
+constexpr std::uint32_t TraceVersion = 1;
+
+enum class opcode : std::uint8_t {
+    end_frame,
+    enable,
+    disable,
+    viewport,
+    scissor,
+    clear,
+    clear_color,
+    clear_buffer_fv,
+    clear_buffer_fi,
+    depth_func,
+    depth_mask,
+    color_mask,
+    blend_func,
+    blend_func_i,
+    blend_func_separate,
+    cull_face,
+    polygon_offset,
+    line_width,
+    pixel_store_i,
+    read_buffer,
+    draw_buffer,
+    draw_buffers,
+    memory_barrier,
+    gen_textures,
+    delete_textures,
+    bind_texture,
+    active_texture,
+    tex_parameter_i,
+    tex_image_2d,
+    tex_sub_image_2d,
+    tex_image_3d,
+    tex_storage_2d,
+    tex_storage_2d_multisample,
+    tex_storage_3d,
+    tex_storage_3d_multisample,
+    generate_mipmap,
+    bind_image_texture,
+    gen_buffers,
+    delete_buffers,
+    bind_buffer,
+    bind_buffer_base,
+    bind_buffer_range,
+    buffer_data,
+    buffer_sub_data,
+    gen_framebuffers,
+    delete_framebuffers,
+    bind_framebuffer,
+    framebuffer_texture,
+    framebuffer_texture_2d,
+    framebuffer_texture_layer,
+    blit_framebuffer,
+    gen_vertex_arrays,
+    delete_vertex_arrays,
+    bind_vertex_array,
+    enable_vertex_attrib_array,
+    vertex_attrib_pointer,
+    vertex_attrib_i_pointer,
+    vertex_attrib_divisor,
+    create_shader,
+    shader_source,
+    compile_shader,
+    create_program,
+    attach_shader,
+    link_program,
+    use_program,
+    get_uniform_location,
+    uniform_1i,
+    uniform_1f,
+    uniform_1fv,
+    uniform_2fv,
+    uniform_3fv,
+    uniform_4fv,
+    uniform_2iv,
+    uniform_matrix_3fv,
+    uniform_matrix_4fv,
+    draw_arrays,
+    draw_arrays_instanced,
+    draw_arrays_instanced_base_instance,
+    draw_arrays_indirect,
+    multi_draw_arrays_indirect,
+    draw_elements,
+    draw_elements_instanced,
+    dispatch_compute,
+};
+
+// recording
+
+std::FILE *trace_out = nullptr;
+GLint unpack_alignment = 4;
+
+template<typename T>
+void put(const T &value)
+{
+    std::fwrite(&value, sizeof(T), 1, trace_out);
+}
+
+template<typename... Ts>
+void record(opcode op, const Ts &... args)
+{
+    put(op);
+    (put(args), ...);
+}
+
+void put_data(const void *data, std::size_t size)
+{
+    if (!data)
+        size = 0;
+    put(static_cast<std::uint32_t>(size));
+    if (size)
+        std::fwrite(data, 1, size, trace_out);
+}
+
+// buffer offsets passed as pointers
+std::uint64_t offset(const void *pointer)
+{
+    return reinterpret_cast<std::uintptr_t>(pointer);
+}
+
+std::size_t image_size(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type)
+{
+    int components = 0;
+    switch (format) {
+    case GL_RED:
+    case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_STENCIL:
+        components = 1;
+        break;
+    case GL_RG:
+        components = 2;
+        break;
+    case GL_RGB:
+    case GL_BGR:
+        components = 3;
+        break;
+    case GL_RGBA:
+    case GL_BGRA:
+        components = 4;
+        break;
+    default:
+        panic("unsupported pixel format %04x in trace\n", format);
+    }
+
+    int component_size = 0;
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+        component_size = 1;
+        break;
+    case GL_HALF_FLOAT:
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+        component_size = 2;
+        break;
+    case GL_FLOAT:
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_UNSIGNED_INT_24_8:
+        component_size = 4;
+        break;
+    default:
+        panic("unsupported pixel type %04x in trace\n", type);
+    }
+
+    const std::size_t row_size = (width * components * component_size + unpack_alignment - 1) / unpack_alignment *
+                                 unpack_alignment;
+    return row_size * height * depth;
+}
+
+void put_names(GLsizei n, const GLuint *names)
+{
+    put_data(names, n * sizeof(GLuint));
+}
+
+template<typename F>
+F next_function(const char *name)
+{
+    auto *function = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+    if (!function)
+        panic("%s not found\n", name);
+    return function;
+}
+
+// calls the libGL entry point this translation unit interposes
+#define FORWARD(name, ...)                                                                 \
+    static const auto next_##name = gl::next_function<decltype(&::name)>(#name);            \
+    next_##name(__VA_ARGS__)
+
+} // namespace
+
+} // namespace gl
+
+// the GL 1.1 entry points are exported by libGL rather than wrapped by GLEW;
+// defining them here makes the executable's calls go through the recorder
+
+extern "C" {
+
+using gl::opcode;
+using gl::record;
+
+void GLAPIENTRY glEnable(GLenum cap)
+{
+    if (gl::trace_out)
+        record(opcode::enable, cap);
+    FORWARD(glEnable, cap);
+}
+
+void GLAPIENTRY glDisable(GLenum cap)
+{
+    if (gl::trace_out)
+        record(opcode::disable, cap);
+    FORWARD(glDisable, cap);
+}
+
+void GLAPIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (gl::trace_out)
+        record(opcode::viewport, x, y, width, height);
+    FORWARD(glViewport, x, y, width, height);
+}
+
+void GLAPIENTRY glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (gl::trace_out)
+        record(opcode::scissor, x, y, width, height);
+    FORWARD(glScissor, x, y, width, height);
+}
+
+void GLAPIENTRY glClear(GLbitfield mask)
+{
+    if (gl::trace_out)
+        record(opcode::clear, mask);
+    FORWARD(glClear, mask);
+}
+
+void GLAPIENTRY glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+    if (gl::trace_out)
+        record(opcode::clear_color, red, green, blue, alpha);
+    FORWARD(glClearColor, red, green, blue, alpha);
+}
+
+void GLAPIENTRY glDepthFunc(GLenum func)
+{
+    if (gl::trace_out)
+        record(opcode::depth_func, func);
+    FORWARD(glDepthFunc, func);
+}
+
+void GLAPIENTRY glDepthMask(GLboolean flag)
+{
+    if (gl::trace_out)
+        record(opcode::depth_mask, flag);
+    FORWARD(glDepthMask, flag);
+}
+
+void GLAPIENTRY glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+    if (gl::trace_out)
+        record(opcode::color_mask, red, green, blue, alpha);
+    FORWARD(glColorMask, red, green, blue, alpha);
+}
+
+void GLAPIENTRY glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    if (gl::trace_out)
+        record(opcode::blend_func, sfactor, dfactor);
+    FORWARD(glBlendFunc, sfactor, dfactor);
+}
+
+void GLAPIENTRY glCullFace(GLenum mode)
+{
+    if (gl::trace_out)
+        record(opcode::cull_face, mode);
+    FORWARD(glCullFace, mode);
+}
+
+void GLAPIENTRY glPolygonOffset(GLfloat factor, GLfloat units)
+{
+    if (gl::trace_out)
+        record(opcode::polygon_offset, factor, units);
+    FORWARD(glPolygonOffset, factor, units);
+}
+
+void GLAPIENTRY glLineWidth(GLfloat width)
+{
+    if (gl::trace_out)
+        record(opcode::line_width, width);
+    FORWARD(glLineWidth, width);
+}
+
+void GLAPIENTRY glPixelStorei(GLenum pname, GLint param)
+{
+    if (gl::trace_out) {
+        record(opcode::pixel_store_i, pname, param);
+        if (pname == GL_UNPACK_ALIGNMENT)
+            gl::unpack_alignment = param;
+    }
+    FORWARD(glPixelStorei, pname, param);
+}
+
+void GLAPIENTRY glReadBuffer(GLenum mode)
+{
+    if (gl::trace_out)
+        record(opcode::read_buffer, mode);
+    FORWARD(glReadBuffer, mode);
+}
+
+void GLAPIENTRY glDrawBuffer(GLenum mode)
+{
+    if (gl::trace_out)
+        record(opcode::draw_buffer, mode);
+    FORWARD(glDrawBuffer, mode);
+}
+
+void GLAPIENTRY glGenTextures(GLsizei n, GLuint *textures)
+{
+    FORWARD(glGenTextures, n, textures);
+    if (gl::trace_out) {
+        record(opcode::gen_textures);
+        gl::put_names(n, textures);
+    }
+}
+
+void GLAPIENTRY glDeleteTextures(GLsizei n, const GLuint *textures)
+{
+    if (gl::trace_out) {
+        record(opcode::delete_textures);
+        gl::put_names(n, textures);
+    }
+    FORWARD(glDeleteTextures, n, textures);
+}
+
+void GLAPIENTRY glBindTexture(GLenum target, GLuint texture)
+{
+    if (gl::trace_out)
+        record(opcode::bind_texture, target, texture);
+    FORWARD(glBindTexture, target, texture);
+}
+
+void GLAPIENTRY glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+    if (gl::trace_out)
+        record(opcode::tex_parameter_i, target, pname, param);
+    FORWARD(glTexParameteri, target, pname, param);
+}
+
+void GLAPIENTRY glTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+                             GLint border, GLenum format, GLenum type, const void *pixels)
+{
+    if (gl::trace_out) {
+        record(opcode::tex_image_2d, target, level, internal_format, width, height, border, format, type);
+        gl::put_data(pixels, pixels ? gl::image_size(width, height, 1, format, type) : 0);
+    }
+    FORWARD(glTexImage2D, target, level, internal_format, width, height, border, format, type, pixels);
+}
+
+void GLAPIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                                GLsizei height, GLenum format, GLenum type, const void *pixels)
+{
+    if (gl::trace_out) {
+        record(opcode::tex_sub_image_2d, target, level, xoffset, yoffset, width, height, format, type);
+        gl::put_data(pixels, gl::image_size(width, height, 1, format, type));
+    }
+    FORWARD(glTexSubImage2D, target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+void GLAPIENTRY glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    if (gl::trace_out)
+        record(opcode::draw_arrays, mode, first, count);
+    FORWARD(glDrawArrays, mode, first, count);
+}
+
+void GLAPIENTRY glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+    if (gl::trace_out)
+        record(opcode::draw_elements, mode, count, type, gl::offset(indices));
+    FORWARD(glDrawElements, mode, count, type, indices);
+}
+
+} // extern "C"
+
+namespace gl {
+
+namespace {
+
+// the entry points GLEW loads, recorded by swapping GLEW's pointers
+#define GLEW_TRACED_FUNCTIONS(X)      \
+    X(ClearBufferfv)                  \
+    X(ClearBufferfi)                  \
+    X(BlendFunci)                     \
+    X(BlendFuncSeparate)              \
+    X(DrawBuffers)                    \
+    X(MemoryBarrier)                  \
+    X(ActiveTexture)                  \
+    X(TexImage3D)                     \
+    X(TexStorage2D)                   \
+    X(TexStorage2DMultisample)        \
+    X(TexStorage3D)                   \
+    X(TexStorage3DMultisample)        \
+    X(GenerateMipmap)                 \
+    X(BindImageTexture)               \
+    X(GenBuffers)                     \
+    X(DeleteBuffers)                  \
+    X(BindBuffer)                     \
+    X(BindBufferBase)                 \
+    X(BindBufferRange)                \
+    X(BufferData)                     \
+    X(BufferSubData)                  \
+    X(MapBuffer)                      \
+    X(UnmapBuffer)                    \
+    X(GenFramebuffers)                \
+    X(DeleteFramebuffers)             \
+    X(BindFramebuffer)                \
+    X(FramebufferTexture)             \
+    X(FramebufferTexture2D)           \
+    X(FramebufferTextureLayer)        \
+    X(BlitFramebuffer)                \
+    X(GenVertexArrays)                \
+    X(DeleteVertexArrays)             \
+    X(BindVertexArray)                \
+    X(EnableVertexAttribArray)        \
+    X(VertexAttribPointer)            \
+    X(VertexAttribIPointer)           \
+    X(VertexAttribDivisor)            \
+    X(CreateShader)                   \
+    X(ShaderSource)                   \
+    X(CompileShader)                  \
+    X(CreateProgram)                  \
+    X(AttachShader)                   \
+    X(LinkProgram)                    \
+    X(UseProgram)                     \
+    X(GetUniformLocation)             \
+    X(Uniform1i)                      \
+    X(Uniform1f)                      \
+    X(Uniform1fv)                     \
+    X(Uniform2fv)                     \
+    X(Uniform3fv)                     \
+    X(Uniform4fv)                     \
+    X(Uniform2iv)                     \
+    X(UniformMatrix3fv)               \
+    X(UniformMatrix4fv)               \
+    X(DrawArraysInstanced)            \
+    X(DrawArraysInstancedBaseInstance) \
+    X(DrawArraysIndirect)             \
+    X(MultiDrawArraysIndirect)        \
+    X(DrawElementsInstanced)          \
+    X(DispatchCompute)
+
+#define DECLARE_REAL(name) decltype(__glew##name) real_##name = nullptr;
+GLEW_TRACED_FUNCTIONS(DECLARE_REAL)
+#undef DECLARE_REAL
+
+void GLAPIENTRY traced_ClearBufferfv(GLenum buffer, GLint draw_buffer, const GLfloat *value)
+{
+    record(opcode::clear_buffer_fv, buffer, draw_buffer);
+    put_data(value, (buffer == GL_COLOR ? 4 : 1) * sizeof(GLfloat));
+    real_ClearBufferfv(buffer, draw_buffer, value);
+}
+
+void GLAPIENTRY traced_ClearBufferfi(GLenum buffer, GLint draw_buffer, GLfloat depth, GLint stencil)
+{
+    record(opcode::clear_buffer_fi, buffer, draw_buffer, depth, stencil);
+    real_ClearBufferfi(buffer, draw_buffer, depth, stencil);
+}
+
+void GLAPIENTRY traced_BlendFunci(GLuint buf, GLenum src, GLenum dst)
+{
+    record(opcode::blend_func_i, buf, src, dst);
+    real_BlendFunci(buf, src, dst);
+}
+
+void GLAPIENTRY traced_BlendFuncSeparate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+{
+    record(opcode::blend_func_separate, src_rgb, dst_rgb, src_alpha, dst_alpha);
+    real_BlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+void GLAPIENTRY traced_DrawBuffers(GLsizei n, const GLenum *bufs)
+{
+    record(opcode::draw_buffers);
+    put_data(bufs, n * sizeof(GLenum));
+    real_DrawBuffers(n, bufs);
+}
+
+void GLAPIENTRY traced_MemoryBarrier(GLbitfield barriers)
+{
+    record(opcode::memory_barrier, barriers);
+    real_MemoryBarrier(barriers);
+}
+
+void GLAPIENTRY traced_ActiveTexture(GLenum texture)
+{
+    record(opcode::active_texture, texture);
+    real_ActiveTexture(texture);
+}
+
+void GLAPIENTRY traced_TexImage3D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+                                  GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels)
+{
+    record(opcode::tex_image_3d, target, level, internal_format, width, height, depth, border, format, type);
+    put_data(pixels, pixels ? image_size(width, height, depth, format, type) : 0);
+    real_TexImage3D(target, level, internal_format, width, height, depth, border, format, type, pixels);
+}
+
+void GLAPIENTRY traced_TexStorage2D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width,
+                                    GLsizei height)
+{
+    record(opcode::tex_storage_2d, target, levels, internal_format, width, height);
+    real_TexStorage2D(target, levels, internal_format, width, height);
+}
+
+void GLAPIENTRY traced_TexStorage2DMultisample(GLenum target, GLsizei samples, GLenum internal_format,
+                                               GLsizei width, GLsizei height, GLboolean fixed_sample_locations)
+{
+    record(opcode::tex_storage_2d_multisample, target, samples, internal_format, width, height,
+           fixed_sample_locations);
+    real_TexStorage2DMultisample(target, samples, internal_format, width, height, fixed_sample_locations);
+}
+
+void GLAPIENTRY traced_TexStorage3D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width,
+                                    GLsizei height, GLsizei depth)
+{
+    record(opcode::tex_storage_3d, target, levels, internal_format, width, height, depth);
+    real_TexStorage3D(target, levels, internal_format, width, height, depth);
+}
+
+void GLAPIENTRY traced_TexStorage3DMultisample(GLenum target, GLsizei samples, GLenum internal_format,
+                                               GLsizei width, GLsizei height, GLsizei depth,
+                                               GLboolean fixed_sample_locations)
+{
+    record(opcode::tex_storage_3d_multisample, target, samples, internal_format, width, height, depth,
+           fixed_sample_locations);
+    real_TexStorage3DMultisample(target, samples, internal_format, width, height, depth, fixed_sample_locations);
+}
+
+void GLAPIENTRY traced_GenerateMipmap(GLenum target)
+{
+    record(opcode::generate_mipmap, target);
+    real_GenerateMipmap(target);
+}
+
+void GLAPIENTRY traced_BindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer,
+                                       GLenum access, GLenum format)
+{
+    record(opcode::bind_image_texture, unit, texture, level, layered, layer, access, format);
+    real_BindImageTexture(unit, texture, level, layered, layer, access, format);
+}
+
+void GLAPIENTRY traced_GenBuffers(GLsizei n, GLuint *buffers)
+{
+    real_GenBuffers(n, buffers);
+    record(opcode::gen_buffers);
+    put_names(n, buffers);
+}
+
+void GLAPIENTRY traced_DeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    record(opcode::delete_buffers);
+    put_names(n, buffers);
+    real_DeleteBuffers(n, buffers);
+}
+
+void GLAPIENTRY traced_BindBuffer(GLenum target, GLuint buffer)
+{
+    record(opcode::bind_buffer, target, buffer);
+    real_BindBuffer(target, buffer);
+}
+
+void GLAPIENTRY traced_BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    record(opcode::bind_buffer_base, target, index, buffer);
+    real_BindBufferBase(target, index, buffer);
+}
+
+void GLAPIENTRY traced_BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    record(opcode::bind_buffer_range, target, index, buffer, static_cast<std::int64_t>(offset),
+           static_cast<std::int64_t>(size));
+    real_BindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLAPIENTRY traced_BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+    record(opcode::buffer_data, target, static_cast<std::int64_t>(size), usage);
+    put_data(data, size);
+    real_BufferData(target, size, data, usage);
+}
+
+void GLAPIENTRY traced_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+    record(opcode::buffer_sub_data, target, static_cast<std::int64_t>(offset));
+    put_data(data, size);
+    real_BufferSubData(target, offset, size, data);
+}
+
+// the application writes a mapped buffer through a copy, recorded as a
+// buffer_sub_data of the whole buffer when it's unmapped
+struct buffer_mapping
+{
+    void *pointer;
+    std::vector<unsigned char> data;
+};
+std::unordered_map<GLenum, buffer_mapping> buffer_mappings;
+
+void *GLAPIENTRY traced_MapBuffer(GLenum target, GLenum access)
+{
+    GLint size = 0;
+    glGetBufferParameteriv(target, GL_BUFFER_SIZE, &size);
+
+    auto &mapping = buffer_mappings[target];
+    mapping.data.resize(size);
+    glGetBufferSubData(target, 0, size, mapping.data.data());
+
+    mapping.pointer = real_MapBuffer(target, access);
+    return mapping.pointer ? mapping.data.data() : nullptr;
+}
+
+GLboolean GLAPIENTRY traced_UnmapBuffer(GLenum target)
+{
+    const auto it = buffer_mappings.find(target);
+    if (it != buffer_mappings.end()) {
+        auto &mapping = it->second;
+        std::memcpy(mapping.pointer, mapping.data.data(), mapping.data.size());
+        record(opcode::buffer_sub_data, target, std::int64_t(0));
+        put_data(mapping.data.data(), mapping.data.size());
+        buffer_mappings.erase(it);
+    }
+    return real_UnmapBuffer(target);
+}
+
+void GLAPIENTRY traced_GenFramebuffers(GLsizei n, GLuint *framebuffers)
+{
+    real_GenFramebuffers(n, framebuffers);
+    record(opcode::gen_framebuffers);
+    put_names(n, framebuffers);
+}
+
+void GLAPIENTRY traced_DeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+{
+    record(opcode::delete_framebuffers);
+    put_names(n, framebuffers);
+    real_DeleteFramebuffers(n, framebuffers);
+}
+
+void GLAPIENTRY traced_BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    record(opcode::bind_framebuffer, target, framebuffer);
+    real_BindFramebuffer(target, framebuffer);
+}
+
+void GLAPIENTRY traced_FramebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level)
+{
+    record(opcode::framebuffer_texture, target, attachment, texture, level);
+    real_FramebufferTexture(target, attachment, texture, level);
+}
+
+void GLAPIENTRY traced_FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture,
+                                           GLint level)
+{
+    record(opcode::framebuffer_texture_2d, target, attachment, textarget, texture, level);
+    real_FramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+void GLAPIENTRY traced_FramebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture, GLint level,
+                                              GLint layer)
+{
+    record(opcode::framebuffer_texture_layer, target, attachment, texture, level, layer);
+    real_FramebufferTextureLayer(target, attachment, texture, level, layer);
+}
+
+void GLAPIENTRY traced_BlitFramebuffer(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1, GLint dst_x0,
+                                      GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask, GLenum filter)
+{
+    record(opcode::blit_framebuffer, src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1, dst_y1, mask, filter);
+    real_BlitFramebuffer(src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1, dst_y1, mask, filter);
+}
+
+void GLAPIENTRY traced_GenVertexArrays(GLsizei n, GLuint *arrays)
+{
+    real_GenVertexArrays(n, arrays);
+    record(opcode::gen_vertex_arrays);
+    put_names(n, arrays);
+}
+
+void GLAPIENTRY traced_DeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+    record(opcode::delete_vertex_arrays);
+    put_names(n, arrays);
+    real_DeleteVertexArrays(n, arrays);
+}
+
+void GLAPIENTRY traced_BindVertexArray(GLuint array)
+{
+    record(opcode::bind_vertex_array, array);
+    real_BindVertexArray(array);
+}
+
+void GLAPIENTRY traced_EnableVertexAttribArray(GLuint index)
+{
+    record(opcode::enable_vertex_attrib_array, index);
+    real_EnableVertexAttribArray(index);
+}
+
+void GLAPIENTRY traced_VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                          GLsizei stride, const void *pointer)
+{
+    record(opcode::vertex_attrib_pointer, index, size, type, normalized, stride, offset(pointer));
+    real_VertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void GLAPIENTRY traced_VertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride,
+                                           const void *pointer)
+{
+    record(opcode::vertex_attrib_i_pointer, index, size, type, stride, offset(pointer));
+    real_VertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+void GLAPIENTRY traced_VertexAttribDivisor(GLuint index, GLuint divisor)
+{
+    record(opcode::vertex_attrib_divisor, index, divisor);
+    real_VertexAttribDivisor(index, divisor);
+}
+
+GLuint GLAPIENTRY traced_CreateShader(GLenum type)
+{
+    const auto shader = real_CreateShader(type);
+    record(opcode::create_shader, type, shader);
+    return shader;
+}
+
+void GLAPIENTRY traced_ShaderSource(GLuint shader, GLsizei count, const GLchar *const *strings, const GLint *lengths)
+{
+    std::string source;
+    for (GLsizei i = 0; i < count; ++i) {
+        if (lengths && lengths[i] >= 0)
+            source.append(strings[i], lengths[i]);
+        else
+            source.append(strings[i]);
+    }
+    record(opcode::shader_source, shader);
+    put_data(source.data(), source.size());
+    real_ShaderSource(shader, count, strings, lengths);
+}
+
+void GLAPIENTRY traced_CompileShader(GLuint shader)
+{
+    record(opcode::compile_shader, shader);
+    real_CompileShader(shader);
+}
+
+GLuint GLAPIENTRY traced_CreateProgram()
+{
+    const auto program = real_CreateProgram();
+    record(opcode::create_program, program);
+    return program;
+}
+
+void GLAPIENTRY traced_AttachShader(GLuint program, GLuint shader)
+{
+    record(opcode::attach_shader, program, shader);
+    real_AttachShader(program, shader);
+}
+
+void GLAPIENTRY traced_LinkProgram(GLuint program)
+{
+    record(opcode::link_program, program);
+    real_LinkProgram(program);
+}
+
+void GLAPIENTRY traced_UseProgram(GLuint program)
+{
+    record(opcode::use_program, program);
+    real_UseProgram(program);
+}
+
+GLint GLAPIENTRY traced_GetUniformLocation(GLuint program, const GLchar *name)
+{
+    const auto location = real_GetUniformLocation(program, name);
+    record(opcode::get_uniform_location, program, location);
+    put_data(name, std::strlen(name));
+    return location;
+}
+
+void GLAPIENTRY traced_Uniform1i(GLint location, GLint v0)
+{
+    record(opcode::uniform_1i, location, v0);
+    real_Uniform1i(location, v0);
+}
+
+void GLAPIENTRY traced_Uniform1f(GLint location, GLfloat v0)
+{
+    record(opcode::uniform_1f, location, v0);
+    real_Uniform1f(location, v0);
+}
+
+void GLAPIENTRY traced_Uniform1fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    record(opcode::uniform_1fv, location);
+    put_data(value, count * sizeof(GLfloat));
+    real_Uniform1fv(location, count, value);
+}
+
+void GLAPIENTRY traced_Uniform2fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    record(opcode::uniform_2fv, location);
+    put_data(value, count * 2 * sizeof(GLfloat));
+    real_Uniform2fv(location, count, value);
+}
+
+void GLAPIENTRY traced_Uniform3fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    record(opcode::uniform_3fv, location);
+    put_data(value, count * 3 * sizeof(GLfloat));
+    real_Uniform3fv(location, count, value);
+}
+
+void GLAPIENTRY traced_Uniform4fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    record(opcode::uniform_4fv, location);
+    put_data(value, count * 4 * sizeof(GLfloat));
+    real_Uniform4fv(location, count, value);
+}
+
+void GLAPIENTRY traced_Uniform2iv(GLint location, GLsizei count, const GLint *value)
+{
+    record(opcode::uniform_2iv, location);
+    put_data(value, count * 2 * sizeof(GLint));
+    real_Uniform2iv(location, count, value);
+}
+
+void GLAPIENTRY traced_UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    record(opcode::uniform_matrix_3fv, location, transpose);
+    put_data(value, count * 9 * sizeof(GLfloat));
+    real_UniformMatrix3fv(location, count, transpose, value);
+}
+
+void GLAPIENTRY traced_UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    record(opcode::uniform_matrix_4fv, location, transpose);
+    put_data(value, count * 16 * sizeof(GLfloat));
+    real_UniformMatrix4fv(location, count, transpose, value);
+}
+
+void GLAPIENTRY traced_DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count)
+{
+    record(opcode::draw_arrays_instanced, mode, first, count, instance_count);
+    real_DrawArraysInstanced(mode, first, count, instance_count);
+}
+
+void GLAPIENTRY traced_DrawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count,
+                                                       GLsizei instance_count, GLuint base_instance)
+{
+    record(opcode::draw_arrays_instanced_base_instance, mode, first, count, instance_count, base_instance);
+    real_DrawArraysInstancedBaseInstance(mode, first, count, instance_count, base_instance);
+}
+
+void GLAPIENTRY traced_DrawArraysIndirect(GLenum mode, const void *indirect)
+{
+    record(opcode::draw_arrays_indirect, mode, offset(indirect));
+    real_DrawArraysIndirect(mode, indirect);
+}
+
+void GLAPIENTRY traced_MultiDrawArraysIndirect(GLenum mode, const void *indirect, GLsizei draw_count, GLsizei stride)
+{
+    record(opcode::multi_draw_arrays_indirect, mode, offset(indirect), draw_count, stride);
+    real_MultiDrawArraysIndirect(mode, indirect, draw_count, stride);
+}
+
+void GLAPIENTRY traced_DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices,
+                                            GLsizei instance_count)
+{
+    record(opcode::draw_elements_instanced, mode, count, type, offset(indices), instance_count);
+    real_DrawElementsInstanced(mode, count, type, indices, instance_count);
+}
+
+void GLAPIENTRY traced_DispatchCompute(GLuint x, GLuint y, GLuint z)
+{
+    record(opcode::dispatch_compute, x, y, z);
+    real_DispatchCompute(x, y, z);
+}
+
+// replay
+
+class reader
+{
+public:
+    reader(const unsigned char *data)
+        : data_(data)
+    {
+    }
+
+    template<typename T>
+    T get()
+    {
+        T value;
+        std::memcpy(&value, data_, sizeof(T));
+        data_ += sizeof(T);
+        return value;
+    }
+
+    // in order, unlike function arguments
+    template<typename... Ts>
+    std::tuple<Ts...> get_all()
+    {
+        return std::tuple<Ts...>{ get<Ts>()... };
+    }
+
+    // nullptr for no data
+    const void *get_data(std::size_t *size = nullptr)
+    {
+        const auto data_size = get<std::uint32_t>();
+        if (size)
+            *size = data_size;
+        const auto *data = data_size ? data_ : nullptr;
+        data_ += data_size;
+        return data;
+    }
+
+    template<typename T>
+    const T *get_array(GLsizei *count)
+    {
+        std::size_t size;
+        const auto *data = get_data(&size);
+        *count = size / sizeof(T);
+        return static_cast<const T *>(data);
+    }
+
+    const unsigned char *position() const { return data_; }
+
+private:
+    const unsigned char *data_;
+};
+
+const void *to_pointer(std::uint64_t offset)
+{
+    return reinterpret_cast<const void *>(static_cast<std::uintptr_t>(offset));
+}
+
+GLuint replayed(const std::unordered_map<GLuint, GLuint> &names, GLuint name)
+{
+    const auto it = names.find(name);
+    return it != names.end() ? it->second : name;
+}
+
+template<typename Gen>
+void replay_gen(reader &r, std::unordered_map<GLuint, GLuint> &names, Gen gen)
+{
+    GLsizei count;
+    const auto *recorded = r.get_array<GLuint>(&count);
+    for (GLsizei i = 0; i < count; ++i) {
+        GLuint name;
+        gen(1, &name);
+        names[recorded[i]] = name;
+    }
+}
+
+template<typename Delete>
+void replay_delete(reader &r, std::unordered_map<GLuint, GLuint> &names, Delete del)
+{
+    GLsizei count;
+    const auto *recorded = r.get_array<GLuint>(&count);
+    for (GLsizei i = 0; i < count; ++i) {
+        const auto it = names.find(recorded[i]);
+        if (it == names.end())
+            continue;
+        del(1, &it->second);
+        names.erase(it);
+    }
+}
+
+} // namespace
+
+command_trace::command_trace(const char *path, int width, int height)
+{
+    if (trace_out)
+        panic("a command trace is already active\n");
+
+    out_ = std::fopen(path, "wb");
+    if (!out_)
+        panic("failed to open %s\n", path);
+
+    trace_out = out_;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+    put(TraceMagic);
+    put(TraceVersion);
+    put(static_cast<std::int32_t>(width));
+    put(static_cast<std::int32_t>(height));
+    frame_offsets_.push_back(std::ftell(out_));
+
+#define INSTALL(name)              \
+    real_##name = __glew##name;    \
+    __glew##name = traced_##name;
+    GLEW_TRACED_FUNCTIONS(INSTALL)
+#undef INSTALL
+}
+
+command_trace::~command_trace()
+{
+#define UNINSTALL(name) __glew##name = real_##name;
+    GLEW_TRACED_FUNCTIONS(UNINSTALL)
+#undef UNINSTALL
+
+    // frame index at the end: the offsets, then their count
+    for (const auto offset : frame_offsets_)
+        put(static_cast<std::uint64_t>(offset));
+    put(static_cast<std::uint32_t>(frame_offsets_.size()));
+
+    trace_out = nullptr;
+    std::fclose(out_);
+}
+
+void command_trace::end_frame()
+{
+    record(opcode::end_frame);
+    frame_offsets_.push_back(std::ftell(out_));
+    ++frame_count_;
+}
+
+command_replay::command_replay(const char *path)
+{
+    auto *in = std::fopen(path, "rb");
+    if (!in)
+        panic("failed to open %s\n", path);
+    std::fseek(in, 0, SEEK_END);
+    data_.resize(std::ftell(in));
+    std::fseek(in, 0, SEEK_SET);
+    const auto read = std::fread(data_.data(), 1, data_.size(), in);
+    std::fclose(in);
+
+    constexpr auto HeaderSize = 4 * sizeof(std::uint32_t);
+    if (read != data_.size() || data_.size() < HeaderSize + sizeof(std::uint32_t))
+        panic("%s: truncated trace\n", path);
+
+    reader header(data_.data());
+    const auto [magic, version, width, height] = header.get_all<std::uint32_t, std::uint32_t, std::int32_t, std::int32_t>();
+    if (magic != TraceMagic || version != TraceVersion)
+        panic("%s: not a version %u command trace\n", path, TraceVersion);
+    width_ = width;
+    height_ = height;
+
+    std::uint32_t count;
+    std::memcpy(&count, &data_[data_.size() - sizeof(count)], sizeof(count));
+    const auto index_size = count * sizeof(std::uint64_t) + sizeof(count);
+    if (count < 3 || index_size > data_.size() - HeaderSize)
+        panic("%s: no frames in trace, or truncated\n", path);
+
+    reader index(&data_[data_.size() - index_size]);
+    for (std::uint32_t i = 0; i < count; ++i)
+        frame_offsets_.push_back(index.get<std::uint64_t>());
+}
+
+void command_replay::setup()
+{
+    execute(frame_offsets_[0], frame_offsets_[1]);
+}
+
+void command_replay::frame(int index)
+{
+    execute(frame_offsets_[index + 1], frame_offsets_[index + 2]);
+}
+
+GLint command_replay::uniform_location(GLint location) const
+{
+    const auto it = uniform_locations_.find({ program_, location });
+    return it != uniform_locations_.end() ? it->second : location;
+}
+
+void command_replay::execute(std::size_t begin, std::size_t end)
+{
+    reader r(&data_[begin]);
+    while (r.position() < &data_[end]) {
+        const auto op = r.get<opcode>();
+        switch (op) {
+        case opcode::end_frame:
+            break;
+        case opcode::enable:
+            glEnable(r.get<GLenum>());
+            break;
+        case opcode::disable:
+            glDisable(r.get<GLenum>());
+            break;
+        case opcode::viewport:
+            std::apply(glViewport, r.get_all<GLint, GLint, GLsizei, GLsizei>());
+            break;
+        case opcode::scissor:
+            std::apply(glScissor, r.get_all<GLint, GLint, GLsizei, GLsizei>());
+            break;
+        case opcode::clear:
+            glClear(r.get<GLbitfield>());
+            break;
+        case opcode::clear_color:
+            std::apply(glClearColor, r.get_all<GLfloat, GLfloat, GLfloat, GLfloat>());
+            break;
+        case opcode::clear_buffer_fv: {
+            const auto [buffer, draw_buffer] = r.get_all<GLenum, GLint>();
+            glClearBufferfv(buffer, draw_buffer, static_cast<const GLfloat *>(r.get_data()));
+            break;
+        }
+        case opcode::clear_buffer_fi:
+            std::apply(glClearBufferfi, r.get_all<GLenum, GLint, GLfloat, GLint>());
+            break;
+        case opcode::depth_func:
+            glDepthFunc(r.get<GLenum>());
+            break;
+        case opcode::depth_mask:
+            glDepthMask(r.get<GLboolean>());
+            break;
+        case opcode::color_mask:
+            std::apply(glColorMask, r.get_all<GLboolean, GLboolean, GLboolean, GLboolean>());
+            break;
+        case opcode::blend_func:
+            std::apply(glBlendFunc, r.get_all<GLenum, GLenum>());
+            break;
+        case opcode::blend_func_i:
+            std::apply(glBlendFunci, r.get_all<GLuint, GLenum, GLenum>());
+            break;
+        case opcode::blend_func_separate:
+            std::apply(glBlendFuncSeparate, r.get_all<GLenum, GLenum, GLenum, GLenum>());
+            break;
+        case opcode::cull_face:
+            glCullFace(r.get<GLenum>());
+            break;
+        case opcode::polygon_offset:
+            std::apply(glPolygonOffset, r.get_all<GLfloat, GLfloat>());
+            break;
+        case opcode::line_width:
+            glLineWidth(r.get<GLfloat>());
+            break;
+        case opcode::pixel_store_i:
+            std::apply(glPixelStorei, r.get_all<GLenum, GLint>());
+            break;
+        case opcode::read_buffer:
+            glReadBuffer(r.get<GLenum>());
+            break;
+        case opcode::draw_buffer:
+            glDrawBuffer(r.get<GLenum>());
+            break;
+        case opcode::draw_buffers: {
+            GLsizei count;
+            const auto *buffers = r.get_array<GLenum>(&count);
+            glDrawBuffers(count, buffers);
+            break;
+        }
+        case opcode::memory_barrier:
+            glMemoryBarrier(r.get<GLbitfield>());
+            break;
+        case opcode::gen_textures:
+            replay_gen(r, textures_, glGenTextures);
+            break;
+        case opcode::delete_textures:
+            replay_delete(r, textures_, glDeleteTextures);
+            break;
+        case opcode::bind_texture: {
+            const auto [target, texture] = r.get_all<GLenum, GLuint>();
+            glBindTexture(target, replayed(textures_, texture));
+            break;
+        }
+        case opcode::active_texture:
+            glActiveTexture(r.get<GLenum>());
+            break;
+        case opcode::tex_parameter_i:
+            std::apply(glTexParameteri, r.get_all<GLenum, GLenum, GLint>());
+            break;
+        case opcode::tex_image_2d: {
+            const auto [target, level, internal_format, width, height, border, format, type] =
+                    r.get_all<GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum>();
+            glTexImage2D(target, level, internal_format, width, height, border, format, type, r.get_data());
+            break;
+        }
+        case opcode::tex_sub_image_2d: {
+            const auto [target, level, xoffset, yoffset, width, height, format, type] =
+                    r.get_all<GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum>();
+            glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, r.get_data());
+            break;
+        }
+        case opcode::tex_image_3d: {
+            const auto [target, level, internal_format, width, height, depth, border, format, type] =
+                    r.get_all<GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum>();
+            glTexImage3D(target, level, internal_format, width, height, depth, border, format, type, r.get_data());
+            break;
+        }
+        case opcode::tex_storage_2d:
+            std::apply(glTexStorage2D, r.get_all<GLenum, GLsizei, GLenum, GLsizei, GLsizei>());
+            break;
+        case opcode::tex_storage_2d_multisample:
+            std::apply(glTexStorage2DMultisample, r.get_all<GLenum, GLsizei, GLenum, GLsizei, GLsizei, GLboolean>());
+            break;
+        case opcode::tex_storage_3d:
+            std::apply(glTexStorage3D, r.get_all<GLenum, GLsizei, GLenum, GLsizei, GLsizei, GLsizei>());
+            break;
+        case opcode::tex_storage_3d_multisample:
+            std::apply(glTexStorage3DMultisample,
+                       r.get_all<GLenum, GLsizei, GLenum, GLsizei, GLsizei, GLsizei, GLboolean>());
+            break;
+        case opcode::generate_mipmap:
+            glGenerateMipmap(r.get<GLenum>());
+            break;
+        case opcode::bind_image_texture: {
+            const auto [unit, texture, level, layered, layer, access, format] =
+                    r.get_all<GLuint, GLuint, GLint, GLboolean, GLint, GLenum, GLenum>();
+            glBindImageTexture(unit, replayed(textures_, texture), level, layered, layer, access, format);
+            break;
+        }
+        case opcode::gen_buffers:
+            replay_gen(r, buffers_, glGenBuffers);
+            break;
+        case opcode::delete_buffers:
+            replay_delete(r, buffers_, glDeleteBuffers);
+            break;
+        case opcode::bind_buffer: {
+            const auto [target, buffer] = r.get_all<GLenum, GLuint>();
+            glBindBuffer(target, replayed(buffers_, buffer));
+            break;
+        }
+        case opcode::bind_buffer_base: {
+            const auto [target, index, buffer] = r.get_all<GLenum, GLuint, GLuint>();
+            glBindBufferBase(target, index, replayed(buffers_, buffer));
+            break;
+        }
+        case opcode::bind_buffer_range: {
+            const auto [target, index, buffer, offset, size] =
+                    r.get_all<GLenum, GLuint, GLuint, std::int64_t, std::int64_t>();
+            glBindBufferRange(target, index, replayed(buffers_, buffer), offset, size);
+            break;
+        }
+        case opcode::buffer_data: {
+            const auto [target, size, usage] = r.get_all<GLenum, std::int64_t, GLenum>();
+            glBufferData(target, size, r.get_data(), usage);
+            break;
+        }
+        case opcode::buffer_sub_data: {
+            const auto [target, offset] = r.get_all<GLenum, std::int64_t>();
+            std::size_t size;
+            const auto *data = r.get_data(&size);
+            glBufferSubData(target, offset, size, data);
+            break;
+        }
+        case opcode::gen_framebuffers:
+            replay_gen(r, framebuffers_, glGenFramebuffers);
+            break;
+        case opcode::delete_framebuffers:
+            replay_delete(r, framebuffers_, glDeleteFramebuffers);
+            break;
+        case opcode::bind_framebuffer: {
+            const auto [target, framebuffer] = r.get_all<GLenum, GLuint>();
+            glBindFramebuffer(target, replayed(framebuffers_, framebuffer));
+            break;
+        }
+        case opcode::framebuffer_texture: {
+            const auto [target, attachment, texture, level] = r.get_all<GLenum, GLenum, GLuint, GLint>();
+            glFramebufferTexture(target, attachment, replayed(textures_, texture), level);
+            break;
+        }
+        case opcode::framebuffer_texture_2d: {
+            const auto [target, attachment, textarget, texture, level] =
+                    r.get_all<GLenum, GLenum, GLenum, GLuint, GLint>();
+            glFramebufferTexture2D(target, attachment, textarget, replayed(textures_, texture), level);
+            break;
+        }
+        case opcode::framebuffer_texture_layer: {
+            const auto [target, attachment, texture, level, layer] = r.get_all<GLenum, GLenum, GLuint, GLint, GLint>();
+            glFramebufferTextureLayer(target, attachment, replayed(textures_, texture), level, layer);
+            break;
+        }
+        case opcode::blit_framebuffer:
+            std::apply(glBlitFramebuffer, r.get_all<GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint,
+                                                    GLbitfield, GLenum>());
+            break;
+        case opcode::gen_vertex_arrays:
+            replay_gen(r, vertex_arrays_, glGenVertexArrays);
+            break;
+        case opcode::delete_vertex_arrays:
+            replay_delete(r, vertex_arrays_, glDeleteVertexArrays);
+            break;
+        case opcode::bind_vertex_array:
+            glBindVertexArray(replayed(vertex_arrays_, r.get<GLuint>()));
+            break;
+        case opcode::enable_vertex_attrib_array:
+            glEnableVertexAttribArray(r.get<GLuint>());
+            break;
+        case opcode::vertex_attrib_pointer: {
+            const auto [index, size, type, normalized, stride, offset] =
+                    r.get_all<GLuint, GLint, GLenum, GLboolean, GLsizei, std::uint64_t>();
+            glVertexAttribPointer(index, size, type, normalized, stride, to_pointer(offset));
+            break;
+        }
+        case opcode::vertex_attrib_i_pointer: {
+            const auto [index, size, type, stride, offset] = r.get_all<GLuint, GLint, GLenum, GLsizei, std::uint64_t>();
+            glVertexAttribIPointer(index, size, type, stride, to_pointer(offset));
+            break;
+        }
+        case opcode::vertex_attrib_divisor:
+            std::apply(glVertexAttribDivisor, r.get_all<GLuint, GLuint>());
+            break;
+        case opcode::create_shader: {
+            const auto [type, shader] = r.get_all<GLenum, GLuint>();
+            programs_[shader] = glCreateShader(type);
+            break;
+        }
+        case opcode::shader_source: {
+            const auto shader = r.get<GLuint>();
+            std::size_t size;
+            const auto *source = static_cast<const GLchar *>(r.get_data(&size));
+            const GLint length = size;
+            glShaderSource(replayed(programs_, shader), 1, &source, &length);
+            break;
+        }
+        case opcode::compile_shader:
+            glCompileShader(replayed(programs_, r.get<GLuint>()));
+            break;
+        case opcode::create_program:
+            programs_[r.get<GLuint>()] = glCreateProgram();
+            break;
+        case opcode::attach_shader: {
+            const auto [program, shader] = r.get_all<GLuint, GLuint>();
+            glAttachShader(replayed(programs_, program), replayed(programs_, shader));
+            break;
+        }
+        case opcode::link_program:
+            glLinkProgram(replayed(programs_, r.get<GLuint>()));
+            break;
+        case opcode::use_program:
+            program_ = replayed(programs_, r.get<GLuint>());
+            glUseProgram(program_);
+            break;
+        case opcode::get_uniform_location: {
+            const auto [program, location] = r.get_all<GLuint, GLint>();
+            std::size_t size;
+            const auto *name = static_cast<const char *>(r.get_data(&size));
+            const auto replayed_program = replayed(programs_, program);
+            uniform_locations_[{ replayed_program, location }] =
+                    glGetUniformLocation(replayed_program, std::string(name, size).c_str());
+            break;
+        }
+        case opcode::uniform_1i: {
+            const auto [location, value] = r.get_all<GLint, GLint>();
+            glUniform1i(uniform_location(location), value);
+            break;
+        }
+        case opcode::uniform_1f: {
+            const auto [location, value] = r.get_all<GLint, GLfloat>();
+            glUniform1f(uniform_location(location), value);
+            break;
+        }
+        case opcode::uniform_1fv:
+        case opcode::uniform_2fv:
+        case opcode::uniform_3fv:
+        case opcode::uniform_4fv: {
+            const auto location = uniform_location(r.get<GLint>());
+            GLsizei count;
+            const auto *values = r.get_array<GLfloat>(&count);
+            if (op == opcode::uniform_1fv)
+                glUniform1fv(location, count, values);
+            else if (op == opcode::uniform_2fv)
+                glUniform2fv(location, count / 2, values);
+            else if (op == opcode::uniform_3fv)
+                glUniform3fv(location, count / 3, values);
+            else
+                glUniform4fv(location, count / 4, values);
+            break;
+        }
+        case opcode::uniform_2iv: {
+            const auto location = uniform_location(r.get<GLint>());
+            GLsizei count;
+            const auto *values = r.get_array<GLint>(&count);
+            glUniform2iv(location, count / 2, values);
+            break;
+        }
+        case opcode::uniform_matrix_3fv:
+        case opcode::uniform_matrix_4fv: {
+            const auto [location, transpose] = r.get_all<GLint, GLboolean>();
+            GLsizei count;
+            const auto *values = r.get_array<GLfloat>(&count);
+            if (op == opcode::uniform_matrix_3fv)
+                glUniformMatrix3fv(uniform_location(location), count / 9, transpose, values);
+            else
+                glUniformMatrix4fv(uniform_location(location), count / 16, transpose, values);
+            break;
+        }
+        case opcode::draw_arrays:
+            std::apply(glDrawArrays, r.get_all<GLenum, GLint, GLsizei>());
+            break;
+        case opcode::draw_arrays_instanced:
+            std::apply(glDrawArraysInstanced, r.get_all<GLenum, GLint, GLsizei, GLsizei>());
+            break;
+        case opcode::draw_arrays_instanced_base_instance:
+            std::apply(glDrawArraysInstancedBaseInstance, r.get_all<GLenum, GLint, GLsizei, GLsizei, GLuint>());
+            break;
+        case opcode::draw_arrays_indirect: {
+            const auto [mode, offset] = r.get_all<GLenum, std::uint64_t>();
+            glDrawArraysIndirect(mode, to_pointer(offset));
+            break;
+        }
+        case opcode::multi_draw_arrays_indirect: {
+            const auto [mode, offset, draw_count, stride] = r.get_all<GLenum, std::uint64_t, GLsizei, GLsizei>();
+            glMultiDrawArraysIndirect(mode, to_pointer(offset), draw_count, stride);
+            break;
+        }
+        case opcode::draw_elements: {
+            const auto [mode, count, type, offset] = r.get_all<GLenum, GLsizei, GLenum, std::uint64_t>();
+            glDrawElements(mode, count, type, to_pointer(offset));
+            break;
+        }
+        case opcode::draw_elements_instanced: {
+            const auto [mode, count, type, offset, instance_count] =
+                    r.get_all<GLenum, GLsizei, GLenum, std::uint64_t, GLsizei>();
+            glDrawElementsInstanced(mode, count, type, to_pointer(offset), instance_count);
+            break;
+        }
+        case opcode::dispatch_compute:
+            std::apply(glDispatchCompute, r.get_all<GLuint, GLuint, GLuint>());
+            break;
+        default:
+            panic("unknown opcode %d in trace\n", static_cast<int>(op));
+        }
+    }
+}
+
+} // namespace gl
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <GL/glew.h>
+
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gl {
+
+// records the GL commands the application issues (state, uploads, uniform
+// values, draws and dispatches) into a compact binary trace that
+// trace-replay re-issues without any of the application's CPU work, to time
+// drivers on identical workloads.
+//
+// start it right after the window is created so the trace holds the
+// resources the frames use: everything before the first end_frame() is
+// setup, replayed once. while a trace is active GLEW's function pointers are
+// swapped for recording ones, and the GL 1.1 entry points GLEW doesn't wrap
+// are interposed by command_trace.cc and forwarded to libGL. queries and
+// reads (glGet*, glReadPixels, timer queries) aren't recorded; a mapped
+// buffer is recorded as the data written to it when it's unmapped.
+class command_trace : private noncopyable
+{
+public:
+    command_trace(const char *path, int width, int height);
+    ~command_trace();
+
+    // marks the end of a frame, after the buffers are swapped
+    void end_frame();
+    int frame_count() const { return frame_count_; }
+
+private:
+    std::FILE *out_;
+    int frame_count_ = 0;
+    std::vector<long> frame_offsets_;
+};
+
+// plays a command_trace back. the trace is loaded without a context, setup()
+// and frame() replay into the current one, which should be the size the
+// trace was recorded with
+class command_replay : private noncopyable
+{
+public:
+    explicit command_replay(const char *path);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int frame_count() const { return frame_offsets_.size() - 2; }
+
+    // creates the resources, once before the frames
+    void setup();
+    void frame(int index);
+
+private:
+    void execute(std::size_t begin, std::size_t end);
+    GLint uniform_location(GLint location) const;
+
+    std::vector<unsigned char> data_;
+    // start of the setup and of each frame, then the end of the last frame
+    std::vector<std::size_t> frame_offsets_;
+    int width_;
+    int height_;
+
+    // recorded object names to the ones created on replay
+    std::unordered_map<GLuint, GLuint> buffers_;
+    std::unordered_map<GLuint, GLuint> textures_;
+    std::unordered_map<GLuint, GLuint> framebuffers_;
+    std::unordered_map<GLuint, GLuint> vertex_arrays_;
+    std::unordered_map<GLuint, GLuint> programs_; // and shaders
+    std::map<std::pair<GLuint, GLint>, GLint> uniform_locations_; // by replayed program
+    GLuint program_ = 0;
+};
+
+} // namespace gl
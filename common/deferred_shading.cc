@@ -0,0 +1,173 @@
+#include "deferred_shading.h"
+
+#include "panic.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace gl {
+
+namespace {
+
+const framebuffer_format GBufferFormat = { { GL_RG16_SNORM, GL_RGBA8 }, GL_DEPTH_COMPONENT24 };
+const framebuffer_format AccumulationFormat = { { GL_RGBA16F }, GL_NONE };
+
+}
+
+deferred_shading::deferred_shading(framebuffer_pool &pool, int width, int height)
+    : width_(width)
+    , height_(height)
+    , pool_(pool)
+{
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    light_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    light_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/deferred_light.frag");
+    attach_normal_encoding(light_program_);
+    light_program_.link();
+    inverse_view_projection_location_ = light_program_.uniform_location("inverseViewProjection");
+    light_position_location_ = light_program_.uniform_location("lightPosition");
+    light_color_location_ = light_program_.uniform_location("lightColor");
+    shadow_layer_location_ = light_program_.uniform_location("shadowLayer");
+    light_view_projection_location_ = light_program_.uniform_location("lightViewProjection");
+
+    composite_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    composite_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/deferred_composite.frag");
+    composite_program_.link();
+    ambient_location_ = composite_program_.uniform_location("ambient");
+}
+
+void deferred_shading::attach_normal_encoding(shader_program &program)
+{
+    program.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/octahedral.glsl");
+}
+
+void deferred_shading::bind_gbuffer()
+{
+    if (!gbuffer_)
+        gbuffer_ = pool_.acquire(width_, height_, GBufferFormat);
+    gbuffer_->bind();
+    glViewport(0, 0, width_, height_);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// screen bounds of the light's sphere, false if it is off-screen
+bool deferred_shading::scissor_rect(const light &l, const glm::mat4 &view_projection, glm::ivec4 &rect) const
+{
+    glm::vec2 ndc_min(1.0f), ndc_max(-1.0f);
+    for (int i = 0; i < 8; ++i) {
+        const auto corner = l.position + l.radius * glm::vec3(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+        const auto p = view_projection * glm::vec4(corner, 1.0f);
+        if (p.w <= 0.0f) {
+            // straddles the eye plane
+            rect = glm::ivec4(0, 0, width_, height_);
+            return true;
+        }
+        const auto ndc = glm::vec2(p.x, p.y) / p.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+    }
+    ndc_min = glm::max(ndc_min, glm::vec2(-1.0f));
+    ndc_max = glm::min(ndc_max, glm::vec2(1.0f));
+    if (ndc_min.x >= ndc_max.x || ndc_min.y >= ndc_max.y)
+        return false;
+
+    const auto x0 = static_cast<int>((0.5f * ndc_min.x + 0.5f) * width_);
+    const auto y0 = static_cast<int>((0.5f * ndc_min.y + 0.5f) * height_);
+    const auto x1 = static_cast<int>(std::ceil((0.5f * ndc_max.x + 0.5f) * width_));
+    const auto y1 = static_cast<int>(std::ceil((0.5f * ndc_max.y + 0.5f) * height_));
+    rect = glm::ivec4(x0, y0, x1 - x0, y1 - y0);
+    return true;
+}
+
+void deferred_shading::render(const std::vector<light> &lights, const glm::mat4 &view_projection,
+                              GLuint shadow_map_texture)
+{
+    if (!gbuffer_)
+        panic("deferred_shading::render() without bind_gbuffer()\n");
+
+    GLint target_framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer);
+
+    auto *accumulation = pool_.acquire(width_, height_, AccumulationFormat);
+
+    glDisable(GL_DEPTH_TEST);
+    quad_.bind();
+
+    // lighting
+
+    accumulation->bind();
+    glViewport(0, 0, width_, height_);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_SCISSOR_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    gbuffer_->bind_texture(0);
+    glActiveTexture(GL_TEXTURE1);
+    gbuffer_->bind_texture(1);
+    glActiveTexture(GL_TEXTURE2);
+    gbuffer_->bind_depth_texture();
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_map_texture);
+
+    light_program_.bind();
+    light_program_.set_uniform(inverse_view_projection_location_, glm::inverse(view_projection));
+
+    for (const auto &l : lights) {
+        glm::ivec4 rect;
+        if (!scissor_rect(l, view_projection, rect))
+            continue;
+        if (l.shadow_layer >= 0 && !shadow_map_texture)
+            panic("deferred_shading: shadowed light without a shadow map\n");
+        glScissor(rect.x, rect.y, rect.z, rect.w);
+        light_program_.set_uniform(light_position_location_, glm::vec4(l.position, l.radius));
+        light_program_.set_uniform(light_color_location_, l.color);
+        light_program_.set_uniform(shadow_layer_location_, l.shadow_layer);
+        light_program_.set_uniform(light_view_projection_location_, l.view_projection);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+
+    // composite
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+    glViewport(0, 0, width_, height_);
+
+    glActiveTexture(GL_TEXTURE0);
+    accumulation->bind_texture();
+    glActiveTexture(GL_TEXTURE1);
+    gbuffer_->bind_texture(1);
+
+    // blended with the albedo alpha so the background of the target shows
+    // through where nothing was drawn
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    composite_program_.bind();
+    composite_program_.set_uniform(ambient_location_, ambient_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnable(GL_DEPTH_TEST);
+
+    pool_.release(accumulation);
+    pool_.release(gbuffer_);
+    gbuffer_ = nullptr;
+}
+
+} // namespace gl
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "shader_program.h"
+#include "framebuffer_pool.h"
+#include "geometry.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gl {
+
+// deferred shading with a compact g-buffer: octahedral normal (RG16_SNORM),
+// albedo (RGBA8) and depth. positions are reconstructed from depth. every
+// light is drawn as a full-screen quad scissored to the screen bounds of
+// its sphere of influence and added to an RGBA16F accumulation target,
+// which is composited to the screen together with the ambient term.
+//
+// geometry shaders write the normal to location 0 (use encodeNormal(),
+// linked in with attach_normal_encoding()) and the albedo to location 1.
+class deferred_shading : private noncopyable
+{
+public:
+    struct light
+    {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 color;
+        int shadow_layer = -1; // layer in the shadow map array, negative if unshadowed
+        glm::mat4 view_projection = glm::mat4(1.0f);
+    };
+
+    deferred_shading(framebuffer_pool &pool, int width, int height);
+
+    static void attach_normal_encoding(shader_program &program);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    void set_ambient(const glm::vec3 &ambient) { ambient_ = ambient; }
+
+    // acquires the g-buffer from the pool, binds and clears it
+    void bind_gbuffer();
+
+    // lights the g-buffer and composites the result over the currently
+    // bound framebuffer (color only), releases the g-buffer
+    void render(const std::vector<light> &lights, const glm::mat4 &view_projection, GLuint shadow_map_texture = 0);
+
+private:
+    bool scissor_rect(const light &l, const glm::mat4 &view_projection, glm::ivec4 &rect) const;
+
+    int width_;
+    int height_;
+    glm::vec3 ambient_ = glm::vec3(0.05f);
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad_;
+
+    gl::shader_program light_program_;
+    int inverse_view_projection_location_;
+    int light_position_location_;
+    int light_color_location_;
+    int shadow_layer_location_;
+    int light_view_projection_location_;
+
+    gl::shader_program composite_program_;
+    int ambient_location_;
+
+    framebuffer_pool &pool_;
+    gl::framebuffer *gbuffer_ = nullptr;
+};
+
+} // namespace gl
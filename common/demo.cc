@@ -2,8 +2,15 @@
 
 #include "util.h"
 #include "window.h"
+#include "benchmark.h"
+#include "tiled_capture.h"
+#include "command_trace.h"
+#include "allocation_counter.h"
+#include "software_target.h"
+#include "panic.h"
 
 #include <unistd.h>
+#include <cstdio>
 #include <cstdlib>
 #include <GLFW/glfw3.h>
 
@@ -12,11 +19,21 @@ namespace gl {
 demo::demo(int argc, char *argv[])
 {
     parse_arguments(argc, argv);
-    window_.reset(new window(width_, height_, "demo"));
+    benchmark_frames_ = parameters_.get("benchmark", 0);
+    if (!capture_path_.empty()) {
+        capture_.reset(new gl::tiled_capture(capture_path_.c_str(), width_, height_,
+                                             parameters_.get("capture_columns", 0), parameters_.get("capture_rows", 0)));
+        width_ = capture_->tile_width();
+        height_ = capture_->tile_height();
+    }
+    window_.reset(new window(width_, height_, "demo", benchmark_frames_ == 0 && !capture_));
     glfwSetKeyCallback(*window_, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
             glfwSetWindowShouldClose(window, GL_TRUE);
     });
+    // before the demo creates its resources, so the trace has them
+    if (const auto trace_path = parameters_.get("trace", ""); !trace_path.empty())
+        trace_.reset(new gl::command_trace(trace_path.c_str(), width_, height_));
 }
 
 demo::~demo() = default;
@@ -24,11 +41,46 @@ demo::~demo() = default;
 void demo::run()
 {
     int frame_num = 0;
+    int frame_count = 0;
+
+    const auto antialiasing_settings =
+            gl::antialiasing::parse(antialiasing_mode_.empty() ? default_antialiasing_ : antialiasing_mode_);
+    antialiasing_.reset(new gl::antialiasing(antialiasing_settings, width_, height_));
+
+    if (capture_) {
+        capture();
+        return;
+    }
+
+    // -p software_check=N: golden frame diff of the cpu renderer against the
+    // GPU, fails if more than N percent of the pixels differ. run with -a none
+    // so edges are comparable
+    if (const auto tolerance = parameters_.get("software_check", 0.0f); tolerance > 0) {
+        const auto differing = gl::compare_software(width_, height_, [this](bool software) {
+            set_software(software);
+            framebuffer_pool_.begin_frame();
+            frame_arena_.reset();
+            antialiasing_->begin_frame();
+            render();
+            antialiasing_->end_frame();
+        });
+        if (differing > tolerance)
+            panic("%.2f%% of the pixels differ between the cpu and the GPU\n", differing);
+        return;
+    }
+
+    std::unique_ptr<gl::benchmark> benchmark;
+    if (benchmark_frames_ > 0)
+        benchmark.reset(new gl::benchmark(benchmark_frames_));
+
+    const int trace_frames = parameters_.get("trace_frames", cycle_duration_ * frames_per_second_);
+    const bool report_allocations = parameters_.get("allocations", 0) != 0;
+    const int allocation_check = parameters_.get("allocation_check", 0);
 
     double cur_time = glfwGetTime();
     while (!glfwWindowShouldClose(*window_)) {
         float elapsed;
-        if (!dump_frames_) {
+        if (!dump_frames_ && !benchmark && !trace_) {
             auto now = glfwGetTime();
             elapsed = now - cur_time;
             cur_time = now;
@@ -36,26 +88,109 @@ void demo::run()
             elapsed = 1.0f / frames_per_second_;
         }
 
+        if (benchmark)
+            benchmark->begin_frame();
+
+        framebuffer_pool_.begin_frame();
+        frame_arena_.reset();
+        const auto frame_allocations = gl::allocation_totals();
+
+        antialiasing_->begin_frame();
         render();
+        antialiasing_->end_frame();
         update(elapsed);
 
+        if (report_memory_) {
+            const auto &stats = framebuffer_pool_.frame_stats();
+            std::printf("frame %d: %d framebuffers, %.2f MiB allocated, %.2f MiB peak in use, %d acquired, %d created\n",
+                        frame_count, stats.framebuffer_count, stats.allocated_bytes / (1024.0 * 1024.0),
+                        stats.peak_bytes_in_use / (1024.0 * 1024.0), stats.acquired, stats.created);
+        }
+        ++frame_count;
+
         if (dump_frames_) {
             char path[80];
             std::sprintf(path, "%05d.ppm", frame_num);
-            dump_frame_to_file(path, window_->width(), window_->height());
+            dump_frame_to_file(path, window_->width(), window_->height(), frame_arena_.resource());
             if (++frame_num == cycle_duration_ * frames_per_second_)
                 break;
         }
 
         glfwSwapBuffers(*window_);
         glfwPollEvents();
+
+        if (report_allocations || allocation_check > 0) {
+            const auto allocations = gl::allocation_totals() - frame_allocations;
+            const int frame = frame_count - 1;
+            if (report_allocations)
+                std::printf("frame %d: %zu heap allocations, %zu bytes\n", frame, allocations.count, allocations.bytes);
+            if (allocation_check > 0 && frame >= allocation_check && !allocations_expected_ && allocations.count > 0)
+                panic("frame %d: %zu heap allocations, %zu bytes, after the warm-up\n", frame, allocations.count,
+                      allocations.bytes);
+        }
+        allocations_expected_ = false;
+
+        if (trace_) {
+            trace_->end_frame();
+            if (trace_->frame_count() > trace_frames) {
+                trace_.reset();
+                std::printf("traced %d frames\n", trace_frames);
+                break;
+            }
+        }
+
+        if (benchmark) {
+            benchmark->end_frame();
+            if (const auto *g = graph())
+                benchmark->add_pass_timings(g->timings());
+            benchmark->add_memory(framebuffer_pool_.frame_stats());
+            if (benchmark->done()) {
+                benchmark->report();
+                break;
+            }
+        }
+    }
+}
+
+void demo::capture()
+{
+    const int frame = parameters_.get("capture_frame", 0);
+    for (int i = 0; i < frame; ++i)
+        update(1.0f / frames_per_second_);
+
+    for (capture_tile_ = 0; capture_tile_ < capture_->tile_count(); ++capture_tile_) {
+        antialiasing_->reset();
+        for (int i = 0; i < antialiasing_->still_frames(); ++i) {
+            framebuffer_pool_.begin_frame();
+            frame_arena_.reset();
+            antialiasing_->begin_frame();
+            render();
+            antialiasing_->end_frame();
+        }
+        capture_->write_tile(capture_tile_);
     }
+
+    std::printf("captured %s: %dx%d tiles of %dx%d\n", capture_path_.c_str(), capture_->columns(), capture_->rows(),
+                width_, height_);
+}
+
+void demo::set_software(bool software)
+{
+    if (software)
+        panic("this demo has no software renderer\n");
+}
+
+glm::mat4 demo::camera_projection(const glm::mat4 &projection) const
+{
+    if (capture_)
+        return antialiasing_->jitter(capture_->tile_projection(capture_tile_, projection));
+    return antialiasing_->jitter(projection);
 }
 
 void demo::parse_arguments(int argc, char *argv[])
 {
     int opt;
-    while ((opt = getopt(argc, argv, "w:h:c:f:d")) != -1) {
+    while ((opt = getopt(argc, argv, "w:h:c:f:dmtszua:C:p:P:")) != -1) {
         switch (opt)
         {
         case 'w':
@@ -73,6 +208,33 @@ void demo::parse_arguments(int argc, char *argv[])
         case 'd':
             dump_frames_ = true;
             break;
+        case 'm':
+            report_memory_ = true;
+            break;
+        case 't':
+            report_timings_ = true;
+            break;
+        case 's':
+            report_stats_ = true;
+            break;
+        case 'z':
+            depth_prepass_ = true;
+            break;
+        case 'u':
+            frustum_culling_ = true;
+            break;
+        case 'a':
+            antialiasing_mode_ = optarg;
+            break;
+        case 'C':
+            capture_path_ = optarg;
+            break;
+        case 'p':
+            parameters_.set(optarg);
+            break;
+        case 'P':
+            parameters_.load(optarg);
+            break;
         }
     }
 }
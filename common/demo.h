@@ -1,10 +1,19 @@
 #pragma once
 
+#include "antialiasing.h"
+#include "framebuffer_pool.h"
+#include "frame_arena.h"
+#include "parameters.h"
+
 #include <memory>
+#include <string>
 
 namespace gl
 {
 class window;
+class frame_graph;
+class tiled_capture;
+class command_trace;
 
 class demo
 {
@@ -18,13 +27,60 @@ public:
 
 protected:
     void parse_arguments(int argc, char *argv[]);
+    void capture();
+
+    // the camera projection to render with: narrowed to the current tile in
+    // capture mode, jittered for taa
+    glm::mat4 camera_projection(const glm::mat4 &projection) const;
+
+    // frames that rebuild long lived state (meshes, trees) call this, so
+    // -p allocation_check doesn't fail on them
+    void expect_allocations() { allocations_expected_ = true; }
+
+    // demos built on a frame graph return it so benchmark runs can report
+    // per-pass timings
+    virtual const gl::frame_graph *graph() const { return nullptr; }
+
+    // demos with a cpu renderer (-p software=1) switch to it here, so
+    // -p software_check can compare it against the GPU
+    virtual void set_software(bool software);
 
     std::unique_ptr<gl::window> window_;
+    // created in run(). demos pass their camera projection through
+    // camera_projection() and report the view-projection with
+    // antialiasing_->set_view_projection()
+    std::unique_ptr<gl::antialiasing> antialiasing_;
+    gl::framebuffer_pool framebuffer_pool_;
+    // scratch memory for std::pmr containers, reset at the start of every
+    // frame
+    gl::frame_arena frame_arena_;
+    gl::parameters parameters_;
     int width_ = 800;
     int height_ = 800;
     bool dump_frames_ = false;
     int cycle_duration_ = 3; // seconds
     int frames_per_second_ = 40;
+    bool report_memory_ = false;
+    bool report_timings_ = false;
+    bool report_stats_ = false;
+    bool depth_prepass_ = false;
+    bool frustum_culling_ = false;
+    std::string antialiasing_mode_; // -a
+    // demos that don't want anti-aliasing set this in their constructor
+    const char *default_antialiasing_ = "taa";
+    int benchmark_frames_ = 0;
+    // -C path: width_ x height_ become the tile size, the capture has the
+    // size given with -w and -h
+    std::string capture_path_;
+    std::unique_ptr<gl::tiled_capture> capture_;
+    int capture_tile_ = 0;
+    // -p trace=path: records the GL commands of trace_frames frames, plus the
+    // first one which replays as setup, for trace-replay
+    std::unique_ptr<gl::command_trace> trace_;
+    // set by expect_allocations() for the current frame. -p allocations=1
+    // prints the heap allocations of every frame, -p allocation_check=N
+    // panics if a frame after the first N allocates
+    bool allocations_expected_ = false;
 };
 
 }
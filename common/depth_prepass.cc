@@ -0,0 +1,59 @@
+#include "depth_prepass.h"
+
+#include <algorithm>
+
+namespace gl {
+
+depth_prepass::depth_prepass()
+{
+    program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/depth_only.vert");
+    program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/depth_only.frag");
+    program_.link();
+
+    glGenQueries(1, &query_id_);
+}
+
+depth_prepass::~depth_prepass()
+{
+    glDeleteQueries(1, &query_id_);
+}
+
+void depth_prepass::begin_depth() const
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+void depth_prepass::begin_color() const
+{
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    if (enabled_) {
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_EQUAL);
+    }
+    glBeginQuery(GL_SAMPLES_PASSED, query_id_);
+}
+
+void depth_prepass::end() const
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+GLuint depth_prepass::shaded_samples() const
+{
+    GLuint samples;
+    glGetQueryObjectuiv(query_id_, GL_QUERY_RESULT, &samples);
+    return samples;
+}
+
+double depth_prepass::overdraw(int width, int height) const
+{
+    GLint samples;
+    glGetIntegerv(GL_SAMPLES, &samples);
+    return static_cast<double>(shaded_samples()) / (static_cast<double>(width) * height * std::max(samples, 1));
+}
+
+} // namespace gl
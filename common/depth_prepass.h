@@ -0,0 +1,55 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "shader_program.h"
+
+#include <GL/glew.h>
+
+namespace gl {
+
+// depth-only pre-pass: lays down depth first so the color pass, drawn with
+// GL_EQUAL and depth writes off, runs the fragment shader once per pixel.
+// both passes must produce bit-identical positions: compute gl_Position as
+// mvp * vec4(position, 1.0) and declare it invariant in both vertex shaders.
+//
+//     if (prepass.enabled()) {
+//         prepass.begin_depth();
+//         ... draw with a position-only program ...
+//     }
+//     prepass.begin_color();
+//     ... draw with the shading program ...
+//     prepass.end();
+//
+// begin_color()/end() also count the samples that passed the depth test,
+// with the pre-pass disabled that's the overdraw of the color pass.
+class depth_prepass : private noncopyable
+{
+public:
+    depth_prepass();
+    ~depth_prepass();
+
+    // position-only program (attribute 0, uniform "mvp") for geometry
+    // without discarded fragments
+    const shader_program &program() const { return program_; }
+
+    bool enabled() const { return enabled_; }
+    void set_enabled(bool enabled) { enabled_ = enabled; }
+
+    void begin_depth() const;
+    void begin_color() const;
+    void end() const;
+
+    // waits for the samples that passed the depth test in the last color pass
+    GLuint shaded_samples() const;
+
+    // shaded samples per sample of the bound width x height target
+    double overdraw(int width, int height) const;
+
+private:
+    bool enabled_ = false;
+    gl::shader_program program_;
+    GLuint query_id_;
+};
+
+} // namespace gl
@@ -0,0 +1,158 @@
+#include "draw_list.h"
+
+#include "shader_program.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace gl {
+
+namespace {
+
+std::uint64_t texture_hash(const std::array<draw_list::texture_binding, draw_list::MaxTextures> &textures)
+{
+    std::uint64_t hash = 0;
+    for (const auto &texture : textures)
+        hash = hash * 31 + texture.id;
+    return hash;
+}
+
+bool operator!=(const draw_list::texture_binding &a, const draw_list::texture_binding &b)
+{
+    return a.target != b.target || a.id != b.id;
+}
+
+}
+
+draw_list::draw_list()
+{
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniform_alignment_ = alignment;
+}
+
+draw_list::~draw_list() = default;
+
+std::size_t draw_list::push_uniforms(const void *data, std::size_t size)
+{
+    const auto offset = (uniform_data_.size() + uniform_alignment_ - 1) / uniform_alignment_ * uniform_alignment_;
+    uniform_data_.resize(offset + size);
+    std::memcpy(uniform_data_.data() + offset, data, size);
+    return offset;
+}
+
+void draw_list::add(const shader_program &program, GLuint vertex_array, const draw_args &args,
+                    std::size_t uniform_offset, std::size_t uniform_size,
+                    std::initializer_list<texture_binding> textures, int layer)
+{
+    packet p;
+    p.program = &program;
+    p.vertex_array = vertex_array;
+    p.textures = {};
+    std::copy_n(textures.begin(), std::min<std::size_t>(textures.size(), MaxTextures), p.textures.begin());
+    p.uniform_offset = uniform_offset;
+    p.uniform_size = uniform_size;
+    p.args = args;
+    p.order = packets_.size();
+
+    // layer:8 | program:16 | vertex array:16 | textures:24
+    p.key = (static_cast<std::uint64_t>(layer & 0xff) << 56) |
+            (static_cast<std::uint64_t>(program.handle() & 0xffff) << 40) |
+            (static_cast<std::uint64_t>(vertex_array & 0xffff) << 24) | (texture_hash(p.textures) & 0xffffff);
+
+    packets_.push_back(p);
+}
+
+void draw_list::sort()
+{
+    // stable, without the temporary buffer std::stable_sort allocates
+    std::sort(packets_.begin(), packets_.end(), [](const packet &a, const packet &b) {
+        return a.key < b.key || (a.key == b.key && a.order < b.order);
+    });
+}
+
+template<typename Visitor>
+draw_list::stats draw_list::walk(Visitor visitor) const
+{
+    stats s;
+
+    const packet *prev = nullptr;
+    for (const auto &p : packets_) {
+        const auto program_changed = !prev || p.program != prev->program;
+        const auto vertex_array_changed = !prev || p.vertex_array != prev->vertex_array;
+        std::array<bool, MaxTextures> texture_changed;
+        for (int i = 0; i < MaxTextures; ++i) {
+            texture_changed[i] = (!prev && p.textures[i].id) || (prev && p.textures[i] != prev->textures[i]);
+            s.texture_changes += texture_changed[i];
+        }
+        const auto uniforms_changed = p.uniform_size &&
+                                      (!prev || p.uniform_offset != prev->uniform_offset ||
+                                       p.uniform_size != prev->uniform_size);
+
+        s.program_changes += program_changed;
+        s.vertex_array_changes += vertex_array_changed;
+        s.uniform_changes += uniforms_changed;
+        ++s.draws;
+
+        visitor(p, program_changed, vertex_array_changed, texture_changed, uniforms_changed);
+        prev = &p;
+    }
+
+    return s;
+}
+
+draw_list::stats draw_list::simulate() const
+{
+    return walk([](const packet &, bool, bool, const std::array<bool, MaxTextures> &, bool) {});
+}
+
+draw_list::stats draw_list::submit()
+{
+    if (!uniform_data_.empty()) {
+        if (!uniform_buffer_ || uniform_buffer_size_ < uniform_data_.size()) {
+            uniform_buffer_size_ = uniform_data_.size();
+            uniform_buffer_.reset(new gl::buffer<char>(GL_UNIFORM_BUFFER, uniform_buffer_size_));
+        }
+        uniform_buffer_->set_sub_data(0, uniform_data_.data(), uniform_data_.size());
+    }
+
+    const auto s = walk([this](const packet &p, bool program_changed, bool vertex_array_changed,
+                               const std::array<bool, MaxTextures> &texture_changed, bool uniforms_changed) {
+        if (program_changed)
+            p.program->bind();
+        if (vertex_array_changed)
+            glBindVertexArray(p.vertex_array);
+        for (int i = 0; i < MaxTextures; ++i) {
+            if (texture_changed[i]) {
+                glActiveTexture(GL_TEXTURE0 + i);
+                glBindTexture(p.textures[i].target ? p.textures[i].target : GL_TEXTURE_2D, p.textures[i].id);
+            }
+        }
+        if (uniforms_changed)
+            glBindBufferRange(GL_UNIFORM_BUFFER, UniformBinding, uniform_buffer_->handle(), p.uniform_offset,
+                              p.uniform_size);
+
+        const auto &args = p.args;
+        if (args.index_type == GL_NONE) {
+            glDrawArraysInstanced(args.mode, args.first, args.count, args.instance_count);
+        } else {
+            const auto index_size = args.index_type == GL_UNSIGNED_INT ? 4 : args.index_type == GL_UNSIGNED_SHORT ? 2 : 1;
+            glDrawElementsInstanced(args.mode, args.count, args.index_type,
+                                    reinterpret_cast<const GLvoid *>(static_cast<std::size_t>(args.first) * index_size),
+                                    args.instance_count);
+        }
+    });
+
+    glActiveTexture(GL_TEXTURE0);
+
+    clear();
+    return s;
+}
+
+void draw_list::clear()
+{
+    packets_.clear();
+    uniform_data_.clear();
+}
+
+} // namespace gl
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "buffer.h"
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace gl {
+
+class shader_program;
+
+// records draws instead of issuing them, sorts them by a 64-bit state key
+// (layer, program, vertex array, textures) and submits them skipping
+// redundant binds. per-draw uniforms are pushed into a single uniform
+// buffer uploaded once per submit and bound with glBindBufferRange at
+// UniformBinding, shaders read them from a std140 uniform block.
+class draw_list : private noncopyable
+{
+public:
+    static constexpr auto MaxTextures = 4;
+    static constexpr GLuint UniformBinding = 0;
+
+    struct texture_binding
+    {
+        GLenum target;
+        GLuint id;
+    };
+
+    struct draw_args
+    {
+        GLenum mode;
+        GLsizei count;
+        GLsizei instance_count = 1;
+        GLenum index_type = GL_NONE; // GL_NONE for glDrawArrays*
+        GLint first = 0;
+    };
+
+    struct stats
+    {
+        int draws = 0;
+        int program_changes = 0;
+        int vertex_array_changes = 0;
+        int texture_changes = 0;
+        int uniform_changes = 0;
+    };
+
+    draw_list();
+    ~draw_list();
+
+    // copies data into the per-draw uniform storage, returns its offset
+    template<typename T>
+    std::size_t push_uniforms(const T &data)
+    {
+        return push_uniforms(&data, sizeof(T));
+    }
+    std::size_t push_uniforms(const void *data, std::size_t size);
+
+    // draws with higher layers are submitted later regardless of state, use
+    // it when order matters (e.g. blended geometry)
+    void add(const shader_program &program, GLuint vertex_array, const draw_args &args, std::size_t uniform_offset,
+             std::size_t uniform_size, std::initializer_list<texture_binding> textures = {}, int layer = 0);
+
+    template<typename T>
+    void add(const shader_program &program, GLuint vertex_array, const draw_args &args, const T &uniforms,
+             std::initializer_list<texture_binding> textures = {}, int layer = 0)
+    {
+        add(program, vertex_array, args, push_uniforms(uniforms), sizeof(T), textures, layer);
+    }
+
+    void sort();
+
+    // state changes needed to submit the list in its current order
+    stats simulate() const;
+
+    stats submit();
+    void clear();
+
+    std::size_t size() const { return packets_.size(); }
+
+private:
+    struct packet
+    {
+        std::uint64_t key;
+        std::size_t order; // position in the list when added, breaks key ties
+        const shader_program *program;
+        GLuint vertex_array;
+        std::array<texture_binding, MaxTextures> textures;
+        std::size_t uniform_offset;
+        std::size_t uniform_size;
+        draw_args args;
+    };
+
+    template<typename Visitor>
+    stats walk(Visitor visitor) const;
+
+    std::vector<packet> packets_;
+    std::vector<char> uniform_data_;
+    std::size_t uniform_alignment_;
+    std::size_t uniform_buffer_size_ = 0;
+    std::unique_ptr<gl::buffer<char>> uniform_buffer_;
+};
+
+} // namespace gl
@@ -0,0 +1,42 @@
+#include "frame_arena.h"
+
+namespace gl {
+
+frame_arena::frame_arena(std::size_t capacity)
+    : capacity_(capacity)
+    , buffer_(new std::byte[capacity])
+{
+    resource_.emplace(buffer_.get(), capacity_, &overflow_);
+}
+
+void frame_arena::reset()
+{
+    // gives the overflow blocks back
+    resource_.reset();
+
+    if (overflow_.bytes > 0) {
+        capacity_ += overflow_.bytes;
+        buffer_.reset(new std::byte[capacity_]);
+        overflow_.bytes = 0;
+    }
+
+    resource_.emplace(buffer_.get(), capacity_, &overflow_);
+}
+
+void *frame_arena::overflow_resource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    this->bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void frame_arena::overflow_resource::do_deallocate(void *p, std::size_t bytes, std::size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool frame_arena::overflow_resource::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+} // namespace gl
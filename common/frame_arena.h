@@ -0,0 +1,51 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace gl {
+
+// scratch memory for one frame: std::pmr containers built on resource()
+// allocate by bumping a pointer into a preallocated buffer, deallocation is a
+// no-op and reset() frees everything at once. gl::demo resets its arena at
+// the start of every frame, so nothing allocated from it may outlive the
+// frame.
+//
+// a frame that needs more than the buffer gets the rest from the heap, and
+// the next reset() grows the buffer to fit it, so after the first frames the
+// arena stops touching the heap.
+class frame_arena : private noncopyable
+{
+public:
+    explicit frame_arena(std::size_t capacity = 1 << 20);
+
+    std::pmr::memory_resource *resource() { return &*resource_; }
+
+    void reset();
+
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    // new_delete_resource, counting what the arena had to take from it
+    class overflow_resource : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t bytes = 0;
+
+    private:
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+    std::size_t capacity_;
+    std::unique_ptr<std::byte[]> buffer_;
+    overflow_resource overflow_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+};
+
+} // namespace gl
@@ -0,0 +1,306 @@
+#include "frame_graph.h"
+
+#include "panic.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace gl {
+
+namespace {
+
+GLbitfield barrier_bit(frame_graph::access a)
+{
+    switch (a) {
+    case frame_graph::access::render_target:
+        return GL_FRAMEBUFFER_BARRIER_BIT;
+    case frame_graph::access::sampled:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case frame_graph::access::image:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case frame_graph::access::storage_buffer:
+        return GL_SHADER_STORAGE_BARRIER_BIT;
+    case frame_graph::access::indirect:
+        return GL_COMMAND_BARRIER_BIT;
+    }
+    return 0;
+}
+
+// writes not automatically synchronized with later GL commands
+bool is_incoherent(frame_graph::access a)
+{
+    return a == frame_graph::access::image || a == frame_graph::access::storage_buffer;
+}
+
+}
+
+void frame_graph::builder::read(resource r, access a)
+{
+    graph_.passes_[pass_].reads.emplace_back(r, a);
+}
+
+void frame_graph::builder::write(resource r, access a)
+{
+    auto &pass = graph_.passes_[pass_];
+    if (a == access::render_target && pass.render_target == -1)
+        pass.render_target = r;
+    pass.writes.emplace_back(r, a);
+}
+
+void frame_graph::builder::side_effect()
+{
+    graph_.passes_[pass_].side_effect = true;
+}
+
+const gl::framebuffer &frame_graph::context::framebuffer(resource r) const
+{
+    const auto &node = graph_.resources_[r];
+    if (!node.fb)
+        panic("resource %s has no framebuffer\n", node.name.c_str());
+    return *node.fb;
+}
+
+GLuint frame_graph::context::texture(resource r) const
+{
+    const auto &node = graph_.resources_[r];
+    return node.imported ? node.handle : framebuffer(r).texture_handle();
+}
+
+GLuint frame_graph::context::buffer(resource r) const
+{
+    return graph_.resources_[r].handle;
+}
+
+frame_graph::frame_graph(framebuffer_pool &pool)
+    : pool_(pool)
+{
+}
+
+frame_graph::resource frame_graph::create_target(std::string_view name, int width, int height,
+                                                 const framebuffer_format &format)
+{
+    resources_.push_back({ std::string(name), false, false, width, height, format, {}, 0 });
+    compiled_ = false;
+    return resources_.size() - 1;
+}
+
+frame_graph::resource frame_graph::import_target(std::string_view name, int width, int height,
+                                                 std::function<void()> bind, GLuint texture)
+{
+    resources_.push_back({ std::string(name), true, false, width, height, {}, std::move(bind), texture });
+    compiled_ = false;
+    return resources_.size() - 1;
+}
+
+frame_graph::resource frame_graph::import_buffer(std::string_view name, GLuint buffer)
+{
+    resources_.push_back({ std::string(name), true, true, 0, 0, {}, {}, buffer });
+    compiled_ = false;
+    return resources_.size() - 1;
+}
+
+void frame_graph::add_pass(std::string_view name, const setup_function &setup, execute_function execute)
+{
+    passes_.emplace_back();
+    passes_.back().name = name;
+    passes_.back().execute = std::move(execute);
+
+    builder b(*this, passes_.size() - 1);
+    setup(b);
+
+    compiled_ = false;
+}
+
+void frame_graph::compile()
+{
+    // cull: walking backwards, keep passes with side effects, passes writing
+    // imported resources and passes writing something a kept pass reads
+
+    std::vector<bool> needed(resources_.size(), false);
+    for (auto it = passes_.rbegin(); it != passes_.rend(); ++it) {
+        auto &pass = *it;
+        pass.culled = !pass.side_effect && std::none_of(pass.writes.begin(), pass.writes.end(), [&](const auto &w) {
+            return resources_[w.first].imported || needed[w.first];
+        });
+        if (!pass.culled) {
+            for (const auto &r : pass.reads)
+                needed[r.first] = true;
+        }
+    }
+
+    // lifetimes and barriers
+
+    for (auto &node : resources_)
+        node.first_use = node.last_use = -1;
+
+    std::vector<bool> written(resources_.size(), false);
+    std::vector<bool> incoherent(resources_.size(), false);
+    std::vector<GLbitfield> synchronized(resources_.size(), 0);
+
+    for (int i = 0; i < static_cast<int>(passes_.size()); ++i) {
+        auto &pass = passes_[i];
+        pass.barriers = 0;
+        if (pass.culled)
+            continue;
+
+        const auto use = [&](resource r, access a) {
+            auto &node = resources_[r];
+            if (node.first_use == -1)
+                node.first_use = i;
+            node.last_use = i;
+
+            if (incoherent[r] && !(synchronized[r] & barrier_bit(a))) {
+                pass.barriers |= barrier_bit(a);
+                synchronized[r] |= barrier_bit(a);
+            }
+        };
+
+        for (const auto &[r, a] : pass.reads) {
+            if (!resources_[r].imported && !written[r])
+                panic("pass %s reads %s before it is written\n", pass.name.c_str(), resources_[r].name.c_str());
+            use(r, a);
+        }
+        for (const auto &[r, a] : pass.writes)
+            use(r, a);
+
+        for (const auto &[r, a] : pass.writes) {
+            written[r] = true;
+            incoherent[r] = is_incoherent(a);
+            synchronized[r] = 0;
+        }
+    }
+
+    // memory with and without sharing framebuffers, same policy as the pool
+
+    struct slot
+    {
+        int width, height;
+        framebuffer_format format;
+        bool busy;
+    };
+    std::vector<slot> slots;
+
+    transient_bytes_ = aliased_bytes_ = 0;
+    for (int i = 0; i < static_cast<int>(passes_.size()); ++i) {
+        for (const auto &node : resources_) {
+            if (node.imported || node.first_use != i)
+                continue;
+            transient_bytes_ += memory_size(node.width, node.height, node.format);
+            auto it = std::find_if(slots.begin(), slots.end(), [&node](const slot &s) {
+                return !s.busy && s.width == node.width && s.height == node.height && s.format == node.format;
+            });
+            if (it == slots.end()) {
+                slots.push_back({ node.width, node.height, node.format, false });
+                it = std::prev(slots.end());
+                aliased_bytes_ += memory_size(node.width, node.height, node.format);
+            }
+            it->busy = true;
+        }
+        for (const auto &node : resources_) {
+            if (node.imported || node.last_use != i)
+                continue;
+            auto it = std::find_if(slots.begin(), slots.end(), [&node](const slot &s) {
+                return s.busy && s.width == node.width && s.height == node.height && s.format == node.format;
+            });
+            it->busy = false;
+        }
+    }
+
+    // one entry per executed pass, filled in place so frames don't allocate
+
+    timings_.clear();
+    for (auto &pass : passes_) {
+        pass.timing = -1;
+        if (pass.culled)
+            continue;
+        pass.timing = timings_.size();
+        timings_.push_back({ pass.name, 0.0 });
+        if (timing_ && !pass.timers[0]) {
+            pass.timers[0] = std::make_unique<gpu_timer>();
+            pass.timers[1] = std::make_unique<gpu_timer>();
+        }
+    }
+
+    compiled_ = true;
+    timed_frames_ = 0;
+}
+
+void frame_graph::set_timing(bool timing)
+{
+    if (timing != timing_) {
+        timing_ = timing;
+        compiled_ = false;
+    }
+}
+
+void frame_graph::execute()
+{
+    if (!compiled_)
+        compile();
+
+    // the queries about to be reused were issued two frames ago
+
+    const int slot = timed_frames_ % 2;
+    if (timing_ && timed_frames_ >= 2) {
+        for (const auto &pass : passes_) {
+            if (!pass.culled && pass.timers[slot]->available())
+                timings_[pass.timing].gpu_ms = pass.timers[slot]->elapsed_ms();
+        }
+    }
+
+    const context ctx(*this);
+
+    for (int i = 0; i < static_cast<int>(passes_.size()); ++i) {
+        const auto &pass = passes_[i];
+        if (pass.culled)
+            continue;
+
+        for (auto &node : resources_) {
+            if (!node.imported && node.first_use == i)
+                node.fb = pool_.acquire(node.width, node.height, node.format);
+        }
+
+        if (pass.barriers)
+            glMemoryBarrier(pass.barriers);
+
+        if (pass.render_target != -1) {
+            const auto &target = resources_[pass.render_target];
+            if (target.imported)
+                target.bind();
+            else
+                target.fb->bind();
+            glViewport(0, 0, target.width, target.height);
+        }
+
+        if (timing_)
+            pass.timers[slot]->begin();
+        pass.execute(ctx);
+        if (timing_)
+            pass.timers[slot]->end();
+
+        for (auto &node : resources_) {
+            if (!node.imported && node.last_use == i) {
+                pool_.release(node.fb);
+                node.fb = nullptr;
+            }
+        }
+    }
+
+    if (timing_)
+        ++timed_frames_;
+}
+
+void frame_graph::print_timings() const
+{
+    double total = 0;
+    for (const auto &timing : timings_) {
+        std::printf("%-16s %8.3f ms\n", timing.name.c_str(), timing.gpu_ms);
+        total += timing.gpu_ms;
+    }
+    std::printf("%-16s %8.3f ms (%d passes culled, transient targets %.2f MiB, %.2f MiB shared)\n", "total", total,
+                static_cast<int>(std::count_if(passes_.begin(), passes_.end(),
+                                              [](const pass_node &pass) { return pass.culled; })),
+                transient_bytes_ / (1024.0 * 1024.0), aliased_bytes_ / (1024.0 * 1024.0));
+}
+
+} // namespace gl
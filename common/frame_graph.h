@@ -0,0 +1,162 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "framebuffer_pool.h"
+#include "gpu_timer.h"
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gl {
+
+// passes declare the resources they read and write, compile() drops passes
+// whose results are never used, works out when each transient target is
+// first and last used and which memory barriers are needed. execute() runs
+// the remaining passes in declaration order, acquiring transient targets
+// from the framebuffer pool right before their first use and releasing them
+// right after their last, so targets with disjoint lifetimes share memory.
+class frame_graph : private noncopyable
+{
+public:
+    using resource = int;
+
+    enum class access
+    {
+        render_target, // framebuffer attachment
+        sampled, // texture fetch
+        image, // image load/store
+        storage_buffer, // shader storage buffer
+        indirect, // indirect draw/dispatch arguments
+    };
+
+    class builder
+    {
+    public:
+        void read(resource r, access a = access::sampled);
+
+        // the first render target written is bound before the pass executes,
+        // passes rendering to more than one, e.g. effects ping-ponging
+        // between targets, bind the others themselves
+        void write(resource r, access a = access::render_target);
+
+        // never culled, e.g. passes writing to the screen
+        void side_effect();
+
+    private:
+        friend class frame_graph;
+        builder(frame_graph &graph, int pass)
+            : graph_(graph)
+            , pass_(pass)
+        {
+        }
+
+        frame_graph &graph_;
+        int pass_;
+    };
+
+    class context
+    {
+    public:
+        const gl::framebuffer &framebuffer(resource r) const;
+        GLuint texture(resource r) const;
+        GLuint buffer(resource r) const;
+
+    private:
+        friend class frame_graph;
+        explicit context(const frame_graph &graph)
+            : graph_(graph)
+        {
+        }
+
+        const frame_graph &graph_;
+    };
+
+    using setup_function = std::function<void(builder &)>;
+    using execute_function = std::function<void(const context &)>;
+
+    explicit frame_graph(framebuffer_pool &pool);
+
+    // render target owned by the graph
+    resource create_target(std::string_view name, int width, int height, const framebuffer_format &format = {});
+
+    // render target owned by someone else, e.g. a shadow buffer or the screen.
+    // bind is called before passes rendering to it, texture is returned for
+    // passes sampling it.
+    resource import_target(std::string_view name, int width, int height, std::function<void()> bind,
+                           GLuint texture = 0);
+
+    resource import_buffer(std::string_view name, GLuint buffer);
+
+    void add_pass(std::string_view name, const setup_function &setup, execute_function execute);
+
+    void compile();
+    void execute();
+
+    struct pass_timing
+    {
+        std::string name;
+        double gpu_ms;
+    };
+
+    // off by default: timing a pass costs two queries, only turn it on when
+    // the timings are reported
+    void set_timing(bool timing);
+
+    // GPU time of each pass that isn't culled, from two frames back: each
+    // pass alternates between two queries and results not ready by the time
+    // a query is reused keep the previous value instead of stalling
+    const std::vector<pass_timing> &timings() const { return timings_; }
+    void print_timings() const;
+
+    // memory of all transient targets if each one had its own framebuffer,
+    // and memory actually needed when sharing framebuffers between targets
+    // with disjoint lifetimes
+    std::size_t transient_bytes() const { return transient_bytes_; }
+    std::size_t aliased_bytes() const { return aliased_bytes_; }
+
+private:
+    struct resource_node
+    {
+        std::string name;
+        bool imported;
+        bool is_buffer;
+        int width, height;
+        framebuffer_format format;
+        std::function<void()> bind;
+        GLuint handle; // imported texture or buffer
+        gl::framebuffer *fb = nullptr; // transient target while alive
+        int first_use = -1, last_use = -1;
+    };
+
+    struct pass_node
+    {
+        std::string name;
+        execute_function execute;
+        std::vector<std::pair<resource, access>> reads;
+        std::vector<std::pair<resource, access>> writes;
+        bool side_effect = false;
+        bool culled = false;
+        resource render_target = -1;
+        GLbitfield barriers = 0;
+        std::unique_ptr<gpu_timer> timers[2];
+        int timing = -1; // index in timings_
+    };
+
+    framebuffer_pool &pool_;
+    std::vector<resource_node> resources_;
+    std::vector<pass_node> passes_;
+    bool compiled_ = false;
+    bool timing_ = false;
+    int timed_frames_ = 0; // since compile() or set_timing()
+    std::vector<pass_timing> timings_;
+    std::size_t transient_bytes_ = 0;
+    std::size_t aliased_bytes_ = 0;
+};
+
+} // namespace gl
@@ -1,64 +1,219 @@
 #include "framebuffer.h"
 
+#include "panic.h"
+
+#include <algorithm>
+#include <string>
+
 namespace gl {
 
-framebuffer::framebuffer(int width, int height)
+GLuint framebuffer::screen_fbo_id_ = 0;
+
+int framebuffer_format::color_attachment_count() const
+{
+    int count = 0;
+    while (count < MaxColorAttachments && color_formats[count] != GL_NONE)
+        ++count;
+    return count;
+}
+
+std::size_t bytes_per_pixel(GLenum internal_format)
+{
+    switch (internal_format) {
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_RGB10_A2:
+    case GL_R11F_G11F_B10F:
+    case GL_RG16:
+    case GL_RG16_SNORM:
+    case GL_RG16F:
+    case GL_R32F:
+    case GL_R32UI:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+        return 4;
+    case GL_RGBA16:
+    case GL_RGBA16F:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        panic("unknown internal format %04x\n", internal_format);
+        return 0;
+    }
+}
+
+GLenum color_format(std::string_view name)
+{
+    if (name == "rgba8")
+        return GL_RGBA8;
+    if (name == "r11f_g11f_b10f")
+        return GL_R11F_G11F_B10F;
+    if (name == "rgba16f")
+        return GL_RGBA16F;
+    panic("unknown color format %s\n", std::string(name).c_str());
+    return GL_NONE;
+}
+
+std::size_t memory_size(int width, int height, const framebuffer_format &format)
+{
+    std::size_t pixel_size = 0;
+    for (int i = 0, count = format.color_attachment_count(); i < count; ++i)
+        pixel_size += bytes_per_pixel(format.color_formats[i]);
+    if (format.depth_format != GL_NONE)
+        pixel_size += bytes_per_pixel(format.depth_format);
+    return pixel_size * width * height * std::max(format.samples, 1) * std::max(format.layers, 1);
+}
+
+namespace {
+
+GLenum depth_attachment(GLenum depth_format)
+{
+    switch (depth_format) {
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+        return GL_DEPTH_STENCIL_ATTACHMENT;
+    default:
+        return GL_DEPTH_ATTACHMENT;
+    }
+}
+
+}
+
+framebuffer::framebuffer(int width, int height, const framebuffer_format &format)
     : width_{ width }
     , height_{ height }
+    , format_{ format }
 {
-    glGenTextures(1, &texture_id_);
+    const auto color_count = format_.color_attachment_count();
+
     glGenFramebuffers(1, &fbo_id_);
-    glGenRenderbuffers(1, &rbo_id_);
+    glGenTextures(color_count, color_texture_ids_.data());
+    if (format_.depth_format != GL_NONE)
+        glGenTextures(1, &depth_texture_id_);
 
-    // initialize texture
+    // initialize textures
 
     // note to self: non-power of 2 textures are allowed on es >2.0 if
     // GL_MIN_FILTER is set to a function that doesn't require mipmaps
     // and texture wrap is set to GL_CLAMP_TO_EDGE
 
-    bind_texture();
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    unbind_texture();
+    for (int i = 0; i < color_count; ++i)
+        init_texture(color_texture_ids_[i], format_.color_formats[i], GL_LINEAR);
+    if (depth_texture_id_)
+        init_texture(depth_texture_id_, format_.depth_format, GL_NEAREST);
+
+    // initialize framebuffer
 
-    // initialize framebuffer/renderbuffer
+    std::array<GLenum, framebuffer_format::MaxColorAttachments> draw_buffers;
 
     bind();
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id_, 0);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo_id_);
+    for (int i = 0; i < color_count; ++i) {
+        attach_texture(GL_COLOR_ATTACHMENT0 + i, color_texture_ids_[i]);
+        draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    if (depth_texture_id_)
+        attach_texture(depth_attachment(format_.depth_format), depth_texture_id_);
+    if (color_count > 0) {
+        glDrawBuffers(color_count, draw_buffers.data());
+    } else {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        panic("incomplete framebuffer %dx%d\n", width_, height_);
     unbind();
 }
 
 framebuffer::~framebuffer()
 {
     glDeleteFramebuffers(1, &fbo_id_);
-    glDeleteRenderbuffers(1, &rbo_id_);
+    glDeleteTextures(format_.color_attachment_count(), color_texture_ids_.data());
+    if (depth_texture_id_)
+        glDeleteTextures(1, &depth_texture_id_);
+}
+
+GLenum framebuffer::texture_target() const
+{
+    if (format_.layers > 0)
+        return format_.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE_ARRAY : GL_TEXTURE_2D_ARRAY;
+    return format_.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+}
+
+void framebuffer::init_texture(GLuint texture_id, GLenum internal_format, GLint filter) const
+{
+    const auto target = texture_target();
+    glBindTexture(target, texture_id);
+    if (format_.samples > 0) {
+        if (format_.layers > 0)
+            glTexStorage3DMultisample(target, format_.samples, internal_format, width_, height_, format_.layers,
+                                      GL_TRUE);
+        else
+            glTexStorage2DMultisample(target, format_.samples, internal_format, width_, height_, GL_TRUE);
+    } else {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (format_.layers > 0)
+            glTexStorage3D(target, 1, internal_format, width_, height_, format_.layers);
+        else
+            glTexStorage2D(target, 1, internal_format, width_, height_);
+    }
+    glBindTexture(target, 0);
+}
+
+void framebuffer::attach_texture(GLenum attachment, GLuint texture_id) const
+{
+    // layered textures are attached whole
+    if (format_.layers > 0)
+        glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture_id, 0);
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, texture_target(), texture_id, 0);
 }
 
 void framebuffer::bind() const
 {
     glBindFramebuffer(GL_FRAMEBUFFER, fbo_id_);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo_id_);
 }
 
 void framebuffer::unbind()
 {
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, screen_fbo_id_);
+}
+
+void framebuffer::set_screen(GLuint fbo_id)
+{
+    screen_fbo_id_ = fbo_id;
+}
+
+void framebuffer::bind_texture(int index) const
+{
+    glBindTexture(texture_target(), color_texture_ids_[index]);
+}
+
+void framebuffer::unbind_texture() const
+{
+    glBindTexture(texture_target(), 0);
 }
 
-void framebuffer::bind_texture() const
+void framebuffer::bind_depth_texture() const
 {
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glBindTexture(texture_target(), depth_texture_id_);
 }
 
-void framebuffer::unbind_texture()
+std::size_t framebuffer::memory_size() const
 {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    return gl::memory_size(width_, height_, format_);
 }
 
 } // namespace gl
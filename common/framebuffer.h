@@ -4,30 +4,93 @@
 
 #include <GL/glew.h>
 
+#include <array>
+#include <cstddef>
+#include <string_view>
+
 namespace gl {
 
+struct framebuffer_format
+{
+    static constexpr auto MaxColorAttachments = 4;
+
+    // one sized internal format per color attachment (e.g. GL_RGBA8,
+    // GL_R11F_G11F_B10F, GL_RGBA16F), GL_NONE terminates the list
+    std::array<GLenum, MaxColorAttachments> color_formats = { GL_RGBA8 };
+
+    // GL_NONE for no depth attachment
+    GLenum depth_format = GL_DEPTH24_STENCIL8;
+
+    // 0 for a single sampled framebuffer
+    int samples = 0;
+
+    // > 0 for a layered framebuffer of array textures, geometry shaders pick
+    // the layer with gl_Layer
+    int layers = 0;
+
+    int color_attachment_count() const;
+
+    bool operator==(const framebuffer_format &other) const
+    {
+        return color_formats == other.color_formats && depth_format == other.depth_format && samples == other.samples &&
+               layers == other.layers;
+    }
+    bool operator!=(const framebuffer_format &other) const { return !(*this == other); }
+};
+
+std::size_t bytes_per_pixel(GLenum internal_format);
+
+// sized color format from its lowercase GL name without the GL_ prefix,
+// "rgba8", "r11f_g11f_b10f" or "rgba16f", for command line options
+GLenum color_format(std::string_view name);
+
+// GPU memory used by all attachments of a framebuffer
+std::size_t memory_size(int width, int height, const framebuffer_format &format);
+
 class framebuffer : private noncopyable
 {
 public:
-    framebuffer(int width, int height);
+    framebuffer(int width, int height, const framebuffer_format &format = {});
     ~framebuffer();
 
     void bind() const;
+    // binds the screen framebuffer
     static void unbind();
 
-    void bind_texture() const;
-    static void unbind_texture();
+    // framebuffer that unbind() binds, 0 (the default framebuffer) unless
+    // something like gl::antialiasing renders the frame offscreen
+    static void set_screen(GLuint fbo_id);
+    static GLuint screen() { return screen_fbo_id_; }
+
+    void bind_texture(int index = 0) const;
+    void unbind_texture() const;
+
+    void bind_depth_texture() const;
 
     int width() const { return width_; }
     int height() const { return height_; }
+    const framebuffer_format &format() const { return format_; }
+
+    GLuint handle() const { return fbo_id_; }
+    GLuint texture_handle(int index = 0) const { return color_texture_ids_[index]; }
+    GLuint depth_texture_handle() const { return depth_texture_id_; }
+
+    // GPU memory used by all attachments
+    std::size_t memory_size() const;
 
 private:
-    void init_texture();
+    GLenum texture_target() const;
+    void init_texture(GLuint texture_id, GLenum internal_format, GLint filter) const;
+    void attach_texture(GLenum attachment, GLuint texture_id) const;
 
     int width_;
     int height_;
-    GLuint texture_id_;
-    GLuint fbo_id_, rbo_id_;
+    framebuffer_format format_;
+    std::array<GLuint, framebuffer_format::MaxColorAttachments> color_texture_ids_ = {};
+    GLuint depth_texture_id_ = 0;
+    GLuint fbo_id_;
+
+    static GLuint screen_fbo_id_;
 };
 
 } // namespace gl
@@ -0,0 +1,67 @@
+#include "framebuffer_pool.h"
+
+#include "panic.h"
+
+#include <algorithm>
+
+namespace gl {
+
+framebuffer_pool::framebuffer_pool(int max_idle_frames)
+    : max_idle_frames_(max_idle_frames)
+{
+}
+
+framebuffer *framebuffer_pool::acquire(int width, int height, const framebuffer_format &format)
+{
+    ++stats_.acquired;
+
+    auto it = std::find_if(entries_.begin(), entries_.end(), [width, height, &format](const entry &e) {
+        return !e.in_use && e.fb->width() == width && e.fb->height() == height && e.fb->format() == format;
+    });
+    if (it == entries_.end()) {
+        entries_.push_back({ std::make_unique<framebuffer>(width, height, format), false, frame_ });
+        it = std::prev(entries_.end());
+
+        ++stats_.created;
+        ++stats_.framebuffer_count;
+        stats_.allocated_bytes += it->fb->memory_size();
+    }
+
+    it->in_use = true;
+    it->last_used_frame = frame_;
+
+    bytes_in_use_ += it->fb->memory_size();
+    stats_.peak_bytes_in_use = std::max(stats_.peak_bytes_in_use, bytes_in_use_);
+
+    return it->fb.get();
+}
+
+void framebuffer_pool::release(const framebuffer *fb)
+{
+    auto it = std::find_if(entries_.begin(), entries_.end(), [fb](const entry &e) { return e.fb.get() == fb; });
+    if (it == entries_.end() || !it->in_use)
+        panic("releasing a framebuffer not acquired from the pool\n");
+
+    it->in_use = false;
+    bytes_in_use_ -= it->fb->memory_size();
+}
+
+void framebuffer_pool::begin_frame()
+{
+    ++frame_;
+
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [this](const entry &e) {
+                                      return !e.in_use && frame_ - e.last_used_frame > max_idle_frames_;
+                                  }),
+                   entries_.end());
+
+    stats_ = {};
+    stats_.peak_bytes_in_use = bytes_in_use_;
+    for (const auto &e : entries_) {
+        ++stats_.framebuffer_count;
+        stats_.allocated_bytes += e.fb->memory_size();
+    }
+}
+
+} // namespace gl
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "framebuffer.h"
+
+#include <memory>
+#include <vector>
+
+namespace gl {
+
+// recycles transient render targets: acquire() returns a released
+// framebuffer with the same size and format if there is one, so passes
+// later in the frame and later frames reuse the same GPU memory.
+class framebuffer_pool : private noncopyable
+{
+public:
+    struct stats
+    {
+        int acquired = 0; // acquire() calls this frame
+        int created = 0; // framebuffers allocated this frame
+        int framebuffer_count = 0; // framebuffers held by the pool
+        std::size_t allocated_bytes = 0; // memory held by the pool
+        std::size_t peak_bytes_in_use = 0; // high water mark this frame
+    };
+
+    explicit framebuffer_pool(int max_idle_frames = 3);
+
+    framebuffer *acquire(int width, int height, const framebuffer_format &format = {});
+    void release(const framebuffer *fb);
+
+    // starts a new frame: framebuffers not acquired for max_idle_frames are
+    // deleted and the frame statistics are reset
+    void begin_frame();
+
+    const stats &frame_stats() const { return stats_; }
+
+private:
+    struct entry
+    {
+        std::unique_ptr<framebuffer> fb;
+        bool in_use;
+        int last_used_frame;
+    };
+    std::vector<entry> entries_;
+    int max_idle_frames_;
+    int frame_ = 0;
+    std::size_t bytes_in_use_ = 0;
+    stats stats_;
+};
+
+} // namespace gl
@@ -0,0 +1,87 @@
+#include "frustum_culler.h"
+
+#include "panic.h"
+
+#include <algorithm>
+
+namespace gl {
+
+namespace {
+
+int aligned_stride(int max_instances)
+{
+    GLint alignment;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const int alignment_in_indices = std::max(alignment / static_cast<int>(sizeof(GLuint)), 1);
+    return (max_instances + alignment_in_indices - 1) / alignment_in_indices * alignment_in_indices;
+}
+
+}
+
+frustum_culler::frustum_culler(int max_instances, int max_views)
+    : max_instances_(max_instances)
+    , max_views_(max_views)
+    , instance_stride_(aligned_stride(max_instances))
+    , bounds_(GL_SHADER_STORAGE_BUFFER, max_instances)
+    , view_projections_(GL_SHADER_STORAGE_BUFFER, max_views)
+    , visible_instances_(GL_SHADER_STORAGE_BUFFER, instance_stride_ * max_views)
+    , commands_(GL_DRAW_INDIRECT_BUFFER, max_views)
+    , initial_commands_(max_views)
+{
+    cull_program_.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/frustum_cull.comp");
+    cull_program_.link();
+}
+
+frustum_culler::~frustum_culler() = default;
+
+void frustum_culler::set_bounds(const std::vector<glm::vec4> &bounds)
+{
+    if (bounds.size() > static_cast<std::size_t>(max_instances_))
+        panic("frustum_culler: %d instances, max is %d\n", static_cast<int>(bounds.size()), max_instances_);
+    instance_count_ = bounds.size();
+    bounds_.set_sub_data(0, bounds.data(), bounds.size());
+}
+
+void frustum_culler::cull(std::initializer_list<glm::mat4> view_projections, GLuint vertex_count)
+{
+    if (view_projections.size() > static_cast<std::size_t>(max_views_))
+        panic("frustum_culler: %d views, max is %d\n", static_cast<int>(view_projections.size()), max_views_);
+    view_count_ = view_projections.size();
+
+    for (int i = 0; i < view_count_; ++i)
+        initial_commands_[i] = { vertex_count, 0, 0, 0 };
+    commands_.set_sub_data(0, initial_commands_.data(), view_count_);
+    view_projections_.set_sub_data(0, view_projections.begin(), view_count_);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bounds_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, view_projections_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visible_instances_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commands_.handle());
+
+    cull_program_.bind();
+    cull_program_.set_uniform("totalInstances", instance_count_);
+    cull_program_.set_uniform("instanceStride", instance_stride_);
+    glDispatchCompute((instance_count_ + 63) / 64, view_count_, 1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void frustum_culler::draw(int view, GLuint visible_instances_binding, GLenum mode) const
+{
+    if (view >= view_count_)
+        panic("frustum_culler: view %d was not culled\n", view);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, visible_instances_binding, visible_instances_.handle(),
+                      view * instance_stride_ * sizeof(GLuint), max_instances_ * sizeof(GLuint));
+    commands_.bind();
+    glDrawArraysIndirect(mode, reinterpret_cast<const void *>(view * sizeof(draw_command)));
+    commands_.unbind();
+}
+
+int frustum_culler::visible_count(int view) const
+{
+    draw_command command;
+    commands_.get_sub_data(view, &command, 1);
+    return command.instance_count;
+}
+
+} // namespace gl
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "buffer.h"
+#include "shader_program.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <initializer_list>
+#include <vector>
+
+namespace gl {
+
+// gpu frustum culling for instanced draws seen from several views, e.g. the
+// camera and each shadow-casting light. a single dispatch tests every
+// instance bounding sphere against the frustum planes of every view and
+// compacts the visible instance indices of each view into its own range,
+// counting them straight into that view's indirect draw command.
+//
+// the vertex shader fetches its instance as visibleInstances[gl_InstanceID]
+// from the buffer bound by draw().
+class frustum_culler : private noncopyable
+{
+public:
+    frustum_culler(int max_instances, int max_views);
+    ~frustum_culler();
+
+    // xyz: center, w: radius. a radius of zero culls the instance
+    void set_bounds(const std::vector<glm::vec4> &bounds);
+
+    // one view-projection matrix per view, mapping the bounds to clip space
+    void cull(std::initializer_list<glm::mat4> view_projections, GLuint vertex_count);
+
+    // binds the instances visible from the given view to the given shader
+    // storage binding and draws the bound vertex array
+    void draw(int view, GLuint visible_instances_binding, GLenum mode = GL_TRIANGLES) const;
+
+    // instances that passed the last cull() for the given view, stalls
+    int visible_count(int view) const;
+
+    int instance_count() const { return instance_count_; }
+
+private:
+    struct draw_command
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first;
+        GLuint base_instance;
+    };
+
+    int max_instances_;
+    int max_views_;
+    int view_count_ = 0;
+    int instance_count_ = 0;
+    int instance_stride_; // per view, padded to the storage buffer offset alignment
+    gl::buffer<glm::vec4> bounds_;
+    gl::buffer<glm::mat4> view_projections_;
+    gl::buffer<GLuint> visible_instances_;
+    gl::buffer<draw_command> commands_;
+    std::vector<draw_command> initial_commands_;
+    gl::shader_program cull_program_;
+};
+
+} // namespace gl
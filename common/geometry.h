@@ -138,6 +138,7 @@ public:
 
     void bind() const { glBindVertexArray(vao_); }
 
+    GLuint vertex_array_handle() const { return vao_; }
     GLuint array_buffer_handle() const { return vbo_[0]; }
     GLuint element_array_buffer_handle() const { return vbo_[1]; }
 
@@ -0,0 +1,39 @@
+#include "gpu_timer.h"
+
+namespace gl {
+
+gpu_timer::gpu_timer()
+{
+    glGenQueries(1, &query_id_);
+}
+
+gpu_timer::~gpu_timer()
+{
+    glDeleteQueries(1, &query_id_);
+}
+
+void gpu_timer::begin() const
+{
+    glBeginQuery(GL_TIME_ELAPSED, query_id_);
+}
+
+void gpu_timer::end() const
+{
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+bool gpu_timer::available() const
+{
+    GLuint available;
+    glGetQueryObjectuiv(query_id_, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+double gpu_timer::elapsed_ms() const
+{
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(query_id_, GL_QUERY_RESULT, &elapsed);
+    return elapsed * 1e-6;
+}
+
+} // namespace gl
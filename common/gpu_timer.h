@@ -0,0 +1,29 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <GL/glew.h>
+
+namespace gl {
+
+class gpu_timer : private noncopyable
+{
+public:
+    gpu_timer();
+    ~gpu_timer();
+
+    void begin() const;
+    void end() const;
+
+    // whether the result of the last begin()/end() pair is ready, so
+    // elapsed_ms() won't wait
+    bool available() const;
+
+    // waits for the result of the last begin()/end() pair
+    double elapsed_ms() const;
+
+private:
+    GLuint query_id_;
+};
+
+} // namespace gl
@@ -0,0 +1,100 @@
+#include "matrix.h"
+
+namespace gl {
+
+#if defined(__AVX__)
+
+namespace {
+
+// two result columns per register: the columns of a repeated in both halves,
+// times the elements of two columns of b broadcast within their half
+inline __m256 madd(__m256 a, __m256 b, __m256 c)
+{
+#ifdef __FMA__
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+inline void load_doubled_columns(const glm::mat4 &m, __m256 *columns)
+{
+    const float *p = &m[0][0];
+    for (int i = 0; i < 4; ++i) {
+        const __m128 column = _mm_loadu_ps(p + 4 * i);
+        columns[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(column), column, 1);
+    }
+}
+
+inline void multiply_columns(const __m256 *a, const glm::mat4 &b, glm::mat4 &out)
+{
+    for (int i = 0; i < 4; i += 2) {
+        const __m256 v = _mm256_loadu_ps(&b[i][0]);
+        __m256 r = _mm256_mul_ps(a[0], _mm256_permute_ps(v, 0x00));
+        r = madd(a[1], _mm256_permute_ps(v, 0x55), r);
+        r = madd(a[2], _mm256_permute_ps(v, 0xaa), r);
+        r = madd(a[3], _mm256_permute_ps(v, 0xff), r);
+        _mm256_storeu_ps(&out[i][0], r);
+    }
+}
+
+} // namespace
+
+void multiply_many(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, std::size_t count)
+{
+    __m256 columns[4];
+    load_doubled_columns(a, columns);
+    for (std::size_t i = 0; i < count; ++i)
+        multiply_columns(columns, b[i], out[i]);
+}
+
+void multiply_many(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        __m256 columns[4];
+        load_doubled_columns(a[i], columns);
+        multiply_columns(columns, b[i], out[i]);
+    }
+}
+
+#elif defined(__SSE__)
+
+void multiply_many(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, std::size_t count)
+{
+    __m128 columns[4];
+    detail::load_columns(a, columns);
+    for (std::size_t i = 0; i < count; ++i) {
+        // each column of the result only reads the same column of b, so out
+        // may alias b
+        for (int j = 0; j < 4; ++j)
+            _mm_storeu_ps(&out[i][j][0], detail::combine(columns, &b[i][j][0]));
+    }
+}
+
+void multiply_many(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        __m128 columns[4];
+        detail::load_columns(a[i], columns);
+        for (int j = 0; j < 4; ++j)
+            _mm_storeu_ps(&out[i][j][0], detail::combine(columns, &b[i][j][0]));
+    }
+}
+
+#else
+
+void multiply_many(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+        out[i] = a * b[i];
+}
+
+void multiply_many(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+        out[i] = a[i] * b[i];
+}
+
+#endif
+
+} // namespace gl
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#ifdef __SSE__
+#include <immintrin.h>
+#endif
+
+namespace gl {
+
+// 4x4 products for the per instance transforms the demos build on the cpu.
+// glm's default types are unaligned and its operator* is scalar; these load
+// the columns unaligned into SSE registers, so they work on plain glm::mat4,
+// std::vector and mapped buffers alike, and fall back to glm without SSE.
+//
+// multiply_affine() is for matrices whose last row is (0, 0, 0, 1), the
+// products of translations, rotations and scales: it skips the w terms of
+// the first three columns.
+
+#ifdef __SSE__
+
+namespace detail {
+
+inline __m128 combine(const __m128 *a, const float *b)
+{
+    const __m128 xy = _mm_add_ps(_mm_mul_ps(a[0], _mm_set1_ps(b[0])), _mm_mul_ps(a[1], _mm_set1_ps(b[1])));
+    const __m128 zw = _mm_add_ps(_mm_mul_ps(a[2], _mm_set1_ps(b[2])), _mm_mul_ps(a[3], _mm_set1_ps(b[3])));
+    return _mm_add_ps(xy, zw);
+}
+
+inline __m128 combine_affine(const __m128 *a, const float *b)
+{
+    const __m128 xy = _mm_add_ps(_mm_mul_ps(a[0], _mm_set1_ps(b[0])), _mm_mul_ps(a[1], _mm_set1_ps(b[1])));
+    return _mm_add_ps(xy, _mm_mul_ps(a[2], _mm_set1_ps(b[2])));
+}
+
+inline void load_columns(const glm::mat4 &m, __m128 *columns)
+{
+    const float *p = &m[0][0];
+    for (int i = 0; i < 4; ++i)
+        columns[i] = _mm_loadu_ps(p + 4 * i);
+}
+
+} // namespace detail
+
+inline glm::mat4 multiply(const glm::mat4 &a, const glm::mat4 &b)
+{
+    __m128 columns[4];
+    detail::load_columns(a, columns);
+    glm::mat4 result;
+    for (int i = 0; i < 4; ++i)
+        _mm_storeu_ps(&result[i][0], detail::combine(columns, &b[i][0]));
+    return result;
+}
+
+inline glm::mat4 multiply_affine(const glm::mat4 &a, const glm::mat4 &b)
+{
+    __m128 columns[4];
+    detail::load_columns(a, columns);
+    glm::mat4 result;
+    for (int i = 0; i < 3; ++i)
+        _mm_storeu_ps(&result[i][0], detail::combine_affine(columns, &b[i][0]));
+    _mm_storeu_ps(&result[3][0], _mm_add_ps(detail::combine_affine(columns, &b[3][0]), columns[3]));
+    return result;
+}
+
+#else
+
+inline glm::mat4 multiply(const glm::mat4 &a, const glm::mat4 &b)
+{
+    return a * b;
+}
+
+inline glm::mat4 multiply_affine(const glm::mat4 &a, const glm::mat4 &b)
+{
+    return a * b;
+}
+
+#endif
+
+// out[i] = a * b[i]. out may be b, or a mapped buffer
+void multiply_many(const glm::mat4 &a, const glm::mat4 *b, glm::mat4 *out, std::size_t count);
+
+// out[i] = a[i] * b[i]
+void multiply_many(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, std::size_t count);
+
+} // namespace gl
@@ -1,5 +1,7 @@
 #include "multi_shadow_buffer.h"
 
+#include "framebuffer.h"
+
 namespace gl {
 
 multi_shadow_buffer::multi_shadow_buffer(int width, int height, int layers)
@@ -45,7 +47,7 @@ void multi_shadow_buffer::bind(int layer) const
 
 void multi_shadow_buffer::unbind()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebuffer::unbind();
 }
 
 void multi_shadow_buffer::bind_texture() const
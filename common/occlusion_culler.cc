@@ -0,0 +1,153 @@
+#include "occlusion_culler.h"
+
+#include "panic.h"
+
+#include <algorithm>
+
+namespace gl {
+
+namespace {
+
+const framebuffer_format DepthFormat = { { GL_NONE }, GL_DEPTH24_STENCIL8 };
+
+int mip_levels(int width, int height)
+{
+    int levels = 1;
+    while ((std::max(width, height) >> levels) > 0)
+        ++levels;
+    return levels;
+}
+
+}
+
+occlusion_culler::occlusion_culler(int width, int height, int max_instances)
+    : width_(width)
+    , height_(height)
+    , max_instances_(max_instances)
+    , levels_(mip_levels(width, height))
+    , depth_framebuffer_(width, height, DepthFormat)
+    , bounds_(GL_SHADER_STORAGE_BUFFER, max_instances)
+    , visible_instances_(GL_SHADER_STORAGE_BUFFER, max_instances)
+    , command_(GL_DRAW_INDIRECT_BUFFER, 1)
+{
+    glGenTextures(1, &pyramid_texture_);
+    glBindTexture(GL_TEXTURE_2D, pyramid_texture_);
+    glTexStorage2D(GL_TEXTURE_2D, levels_, GL_R32F, width_, height_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    build_program_.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/hiz_build.comp");
+    build_program_.link();
+
+    cull_program_.add_shader(GL_COMPUTE_SHADER, COMMON_SHADER_DIR "/hiz_cull.comp");
+    cull_program_.link();
+}
+
+occlusion_culler::~occlusion_culler()
+{
+    glDeleteTextures(1, &pyramid_texture_);
+}
+
+void occlusion_culler::set_bounds(const std::vector<glm::vec4> &bounds)
+{
+    if (bounds.size() > static_cast<std::size_t>(max_instances_))
+        panic("occlusion_culler: %d instances, max is %d\n", static_cast<int>(bounds.size()), max_instances_);
+    instance_count_ = bounds.size();
+    bounds_.set_sub_data(0, bounds.data(), bounds.size());
+}
+
+void occlusion_culler::cull(const glm::mat4 &view_projection, GLuint vertex_count)
+{
+    const draw_command command = { vertex_count, 0, 0, 0 };
+    command_.set_sub_data(0, &command, 1);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bounds_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visible_instances_.handle());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_.handle());
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pyramid_texture_);
+
+    cull_program_.bind();
+    cull_program_.set_uniform("viewProjection", view_projection);
+    cull_program_.set_uniform("totalInstances", instance_count_);
+    cull_program_.set_uniform("hasPyramid", has_pyramid_ ? 1 : 0);
+    cull_program_.set_uniform("pyramidLevels", levels_);
+    glDispatchCompute((instance_count_ + 63) / 64, 1, 1);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void occlusion_culler::draw(GLuint visible_instances_binding, GLenum mode) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, visible_instances_binding, visible_instances_.handle());
+    command_.bind();
+    glDrawArraysIndirect(mode, nullptr);
+    command_.unbind();
+}
+
+void occlusion_culler::build_depth_pyramid()
+{
+    GLint source_framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &source_framebuffer);
+    GLint samples;
+    glGetIntegerv(GL_SAMPLES, &samples);
+
+    // blitting a multisampled depth buffer keeps one sample per pixel, which
+    // may be nearer than the others and isn't conservative, so level 0 is
+    // built from the samples themselves
+    GLint multisampled_depth = 0;
+    if (samples > 0) {
+        GLint type;
+        glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                              GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+        if (type != GL_TEXTURE)
+            panic("occlusion_culler: multisampled depth buffer isn't a texture\n");
+        glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                              GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &multisampled_depth);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source_framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth_framebuffer_.handle());
+        glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, source_framebuffer);
+    }
+
+    build_program_.bind();
+    build_program_.set_uniform("depthSamples", samples);
+
+    glActiveTexture(GL_TEXTURE0);
+    depth_framebuffer_.bind_depth_texture();
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, multisampled_depth);
+
+    for (int level = 0; level < levels_; ++level) {
+        const auto width = std::max(width_ >> level, 1);
+        const auto height = std::max(height_ >> level, 1);
+        if (level > 0)
+            glBindImageTexture(0, pyramid_texture_, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, pyramid_texture_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        build_program_.set_uniform("copyDepth", level == 0 ? 1 : 0);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    glActiveTexture(GL_TEXTURE0);
+    depth_framebuffer_.unbind_texture();
+
+    has_pyramid_ = true;
+}
+
+int occlusion_culler::visible_count() const
+{
+    draw_command command;
+    command_.get_sub_data(0, &command, 1);
+    return command.instance_count;
+}
+
+} // namespace gl
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "buffer.h"
+#include "framebuffer.h"
+#include "shader_program.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gl {
+
+// gpu occlusion culling for instanced draws. instance bounding spheres are
+// tested in a compute shader against the frustum and a hierarchical depth
+// pyramid built from the previous frame's depth; the visible instance
+// indices are compacted into a buffer and counted straight into an
+// indirect draw command, so nothing is read back.
+//
+// the vertex shader fetches its instance as visibleInstances[gl_InstanceID]
+// from the buffer bound by draw(). occluders that move or disappear show
+// what was behind them one frame late.
+class occlusion_culler : private noncopyable
+{
+public:
+    occlusion_culler(int width, int height, int max_instances);
+    ~occlusion_culler();
+
+    // xyz: center, w: radius. a radius of zero culls the instance
+    void set_bounds(const std::vector<glm::vec4> &bounds);
+
+    // view_projection maps the bounds to clip space
+    void cull(const glm::mat4 &view_projection, GLuint vertex_count);
+
+    // binds the visible instance indices to the given shader storage binding
+    // and draws the bound vertex array
+    void draw(GLuint visible_instances_binding, GLenum mode = GL_TRIANGLES) const;
+
+    // copies the depth of the currently bound framebuffer (depth format
+    // must be DEPTH24_STENCIL8) and builds the pyramid for the next cull().
+    // a multisampled framebuffer must have a depth texture, level 0 takes the
+    // farthest of its samples
+    void build_depth_pyramid();
+
+    // instances that passed the last cull(), stalls
+    int visible_count() const;
+
+    int instance_count() const { return instance_count_; }
+
+private:
+    struct draw_command
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first;
+        GLuint base_instance;
+    };
+
+    int width_;
+    int height_;
+    int max_instances_;
+    int instance_count_ = 0;
+    int levels_;
+    bool has_pyramid_ = false;
+    gl::framebuffer depth_framebuffer_;
+    GLuint pyramid_texture_;
+    gl::buffer<glm::vec4> bounds_;
+    gl::buffer<GLuint> visible_instances_;
+    gl::buffer<draw_command> command_;
+    gl::shader_program build_program_;
+    gl::shader_program cull_program_;
+};
+
+} // namespace gl
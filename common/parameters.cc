@@ -0,0 +1,87 @@
+#include "parameters.h"
+
+#include "panic.h"
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace gl {
+
+void parameters::parse_arguments(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "p:P:")) != -1) {
+        switch (opt)
+        {
+        case 'p':
+            set(optarg);
+            break;
+        case 'P':
+            load(optarg);
+            break;
+        }
+    }
+}
+
+void parameters::set(std::string_view assignment)
+{
+    const auto equals = assignment.find('=');
+    if (equals == std::string_view::npos || equals == 0)
+        panic("parameters: expected name=value, got \"%s\"\n", std::string(assignment).c_str());
+    values_[std::string(assignment.substr(0, equals))] = std::string(assignment.substr(equals + 1));
+}
+
+void parameters::load(const char *path)
+{
+    std::ifstream file(path);
+    if (!file)
+        panic("parameters: failed to open %s\n", path);
+
+    std::string line;
+    while (std::getline(file, line)) {
+        const auto start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+        set(std::string_view(line).substr(start));
+    }
+}
+
+int parameters::get(std::string_view name, int default_value) const
+{
+    const auto *value = find(name);
+    if (!value)
+        return default_value;
+    char *end;
+    const auto result = std::strtol(value->c_str(), &end, 10);
+    if (end == value->c_str() || *end != '\0')
+        panic("parameters: %s=%s is not an integer\n", std::string(name).c_str(), value->c_str());
+    return result;
+}
+
+float parameters::get(std::string_view name, float default_value) const
+{
+    const auto *value = find(name);
+    if (!value)
+        return default_value;
+    char *end;
+    const auto result = std::strtof(value->c_str(), &end);
+    if (end == value->c_str() || *end != '\0')
+        panic("parameters: %s=%s is not a number\n", std::string(name).c_str(), value->c_str());
+    return result;
+}
+
+std::string parameters::get(std::string_view name, const char *default_value) const
+{
+    const auto *value = find(name);
+    return value ? *value : default_value;
+}
+
+const std::string *parameters::find(std::string_view name) const
+{
+    const auto it = values_.find(std::string(name));
+    return it != values_.end() ? &it->second : nullptr;
+}
+
+} // namespace gl
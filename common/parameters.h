@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace gl {
+
+// named runtime parameters for scaling the demos, given on the command line
+// as -p name=value (repeatable) or as a config file of name=value lines
+// with -P path. lines starting with # are comments. later values override
+// earlier ones; names nobody asks for are ignored.
+class parameters
+{
+public:
+    // for demos with their own main loop: handles -p and -P only
+    void parse_arguments(int argc, char *argv[]);
+
+    void set(std::string_view assignment);
+    void load(const char *path);
+
+    int get(std::string_view name, int default_value) const;
+    float get(std::string_view name, float default_value) const;
+    std::string get(std::string_view name, const char *default_value) const;
+
+private:
+    const std::string *find(std::string_view name) const;
+
+    std::unordered_map<std::string, std::string> values_;
+};
+
+} // namespace gl
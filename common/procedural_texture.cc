@@ -0,0 +1,91 @@
+#include "procedural_texture.h"
+
+#include "geometry.h"
+#include "shader_program.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gl {
+
+procedural_texture_cache::~procedural_texture_cache()
+{
+    for (const auto &entry : textures_)
+        glDeleteTextures(1, &entry.second);
+}
+
+GLuint procedural_texture_cache::get(const char *fragment_shader, int size, GLenum internal_format)
+{
+    const auto key = std::make_tuple(std::string(fragment_shader), size, internal_format);
+    auto it = textures_.find(key);
+    if (it == textures_.end())
+        it = textures_.emplace(key, bake(fragment_shader, size, internal_format)).first;
+    return it->second;
+}
+
+GLuint procedural_texture_cache::bake(const char *fragment_shader, int size, GLenum internal_format) const
+{
+    int levels = 1;
+    while ((size >> levels) > 0)
+        ++levels;
+
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, size, size);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad;
+    quad.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    gl::shader_program program;
+    program.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    program.add_shader(GL_FRAGMENT_SHADER, fragment_shader);
+    program.link();
+
+    // may be baked in the middle of a frame, keep the caller's state
+
+    GLint target_framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    const GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+
+    GLuint fbo_id;
+    glGenFramebuffers(1, &fbo_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id, 0);
+    glViewport(0, 0, size, size);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+
+    program.bind();
+    quad.bind();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+    glDeleteFramebuffers(1, &fbo_id);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (depth_test)
+        glEnable(GL_DEPTH_TEST);
+    if (blend)
+        glEnable(GL_BLEND);
+    if (cull_face)
+        glEnable(GL_CULL_FACE);
+
+    return texture_id;
+}
+
+} // namespace gl
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+
+namespace gl {
+
+// procedural patterns baked into tiled (GL_REPEAT), mipmapped textures, so a
+// shader samples the pattern once instead of evaluating it per fragment.
+//
+// the fragment shader is run once over a quad covering [0, 1)^2 (tex_coords
+// from quad.vert) and writes frag_color; it must tile across the edges.
+// textures are baked on first use and cached by shader, size and format.
+class procedural_texture_cache : private noncopyable
+{
+public:
+    ~procedural_texture_cache();
+
+    // size x size texture with the full mip chain
+    GLuint get(const char *fragment_shader, int size, GLenum internal_format = GL_R8);
+
+private:
+    GLuint bake(const char *fragment_shader, int size, GLenum internal_format) const;
+
+    std::map<std::tuple<std::string, int, GLenum>, GLuint> textures_;
+};
+
+} // namespace gl
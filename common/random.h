@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gl {
+
+// counter-based random numbers: every value is a pure function of a key and
+// an index, so values can be drawn in any order or from any number of
+// threads and are the same on every run. the i-th value of a stream is the
+// i-th output of a splitmix64 generator seeded with the stream's key, which
+// mixes the seed and the stream (and substream) ids.
+//
+// give every independent thing its own stream or substream (a tile, a
+// strip, a tree node) and index its values, instead of drawing them from a
+// shared sequence in whatever order the code happens to run.
+class random_stream
+{
+public:
+    explicit constexpr random_stream(std::uint64_t seed, std::uint64_t stream = 0)
+        : key_(mix(mix(seed) + (stream + 1) * Gamma))
+    {
+    }
+
+    constexpr random_stream substream(std::uint64_t id) const { return random_stream(key_, id); }
+
+    constexpr std::uint64_t bits(std::uint64_t index) const { return mix(key_ + (index + 1) * Gamma); }
+
+    // in [0, 1)
+    constexpr float uniform(std::uint64_t index) const { return (bits(index) >> 40) * 0x1.0p-24f; }
+
+    // in [lo, hi)
+    constexpr float uniform(std::uint64_t index, float lo, float hi) const
+    {
+        return lo + (hi - lo) * uniform(index);
+    }
+
+    // in [0, n)
+    constexpr int below(std::uint64_t index, int n) const
+    {
+        return static_cast<int>(((bits(index) >> 32) * static_cast<std::uint64_t>(n)) >> 32);
+    }
+
+private:
+    static constexpr std::uint64_t Gamma = 0x9e3779b97f4a7c15ull;
+
+    static constexpr std::uint64_t mix(std::uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t key_;
+};
+
+} // namespace gl
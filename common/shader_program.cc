@@ -3,6 +3,7 @@
 #include "panic.h"
 
 #include <array>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
@@ -40,12 +41,25 @@ shader_program::shader_program()
 }
 
 void shader_program::add_shader(GLenum type, const char *path)
+{
+    add_shader(type, path, "");
+}
+
+void shader_program::add_shader(GLenum type, const char *path, std::string_view defines)
 {
     const auto shader_id = glCreateShader(type);
 
     const auto source = load_file(path);
-    const auto source_ptr = source.data();
-    glShaderSource(shader_id, 1, &source_ptr, nullptr);
+
+    // #version has to stay the first line
+    const char *version_end = std::strchr(source.data(), '\n');
+    version_end = version_end ? version_end + 1 : source.data() + source.size() - 1;
+
+    // #line keeps compile errors pointing at lines of the file
+    const std::array<const GLchar *, 4> sources = { source.data(), defines.data(), "#line 2\n", version_end };
+    const std::array<GLint, 4> lengths = { static_cast<GLint>(version_end - source.data()),
+                                           static_cast<GLint>(defines.size()), -1, -1 };
+    glShaderSource(shader_id, sources.size(), sources.data(), lengths.data());
     glCompileShader(shader_id);
 
     int status;
@@ -77,7 +91,15 @@ void shader_program::bind() const
 
 int shader_program::uniform_location(std::string_view name) const
 {
-    return glGetUniformLocation(id_, name.data());
+    // glGetUniformLocation wants a terminated string, and views don't have to
+    // be. names are short, terminate a copy on the stack rather than
+    // building a std::string every lookup
+    char terminated[128];
+    if (name.size() >= sizeof(terminated))
+        panic("uniform name too long: %.*s\n", static_cast<int>(name.size()), name.data());
+    name.copy(terminated, name.size());
+    terminated[name.size()] = '\0';
+    return glGetUniformLocation(id_, terminated);
 }
 
 void shader_program::set_uniform(int location, int value) const
@@ -105,6 +127,11 @@ void shader_program::set_uniform(int location, const glm::vec4 &value) const
     glUniform4fv(location, 1, glm::value_ptr(value));
 }
 
+void shader_program::set_uniform(int location, const glm::ivec2 &value) const
+{
+    glUniform2iv(location, 1, glm::value_ptr(value));
+}
+
 void shader_program::set_uniform(int location, const std::vector<float> &value) const
 {
     glUniform1fv(location, value.size(), value.data());
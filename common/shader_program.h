@@ -18,6 +18,10 @@ public:
     shader_program();
 
     void add_shader(GLenum type, const char *path);
+
+    // defines, e.g. "#define N 16\n", go right after the #version line so
+    // constants shared with C++ are only written in one place
+    void add_shader(GLenum type, const char *path, std::string_view defines);
     void link();
 
     void bind() const;
@@ -29,6 +33,7 @@ public:
     void set_uniform(int location, const glm::vec2 &v) const;
     void set_uniform(int location, const glm::vec3 &v) const;
     void set_uniform(int location, const glm::vec4 &v) const;
+    void set_uniform(int location, const glm::ivec2 &v) const;
 
     void set_uniform(int location, const std::vector<float> &v) const;
     void set_uniform(int location, const std::vector<glm::vec2> &v) const;
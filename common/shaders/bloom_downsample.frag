@@ -0,0 +1,34 @@
+#version 450 core
+
+// dual filter downsample (bjorge, "bandwidth-efficient rendering", siggraph 2015):
+// 5 bilinear fetches on a half resolution target
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+uniform float threshold;
+
+vec3 prefilter(vec3 c)
+{
+    float brightness = max(c.r, max(c.g, c.b));
+    return c * max(brightness - threshold, 0.0) / max(brightness, 1e-4);
+}
+
+void main()
+{
+    vec2 half_pixel = 0.5 / textureSize(image, 0);
+
+    vec3 sum = texture(image, tex_coords).rgb * 4.0;
+    sum += texture(image, tex_coords - half_pixel).rgb;
+    sum += texture(image, tex_coords + half_pixel).rgb;
+    sum += texture(image, tex_coords + vec2(half_pixel.x, -half_pixel.y)).rgb;
+    sum += texture(image, tex_coords - vec2(half_pixel.x, -half_pixel.y)).rgb;
+    sum /= 8.0;
+
+    if (threshold > 0.0)
+        sum = prefilter(sum);
+
+    frag_color = vec4(sum, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 450 core
+
+// dual filter upsample: 8 bilinear fetches forming a tent filter
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+uniform float intensity;
+uniform float exposure; // > 0 tone maps the last upsample to the screen
+
+void main()
+{
+    vec2 half_pixel = 0.5 / textureSize(image, 0);
+
+    vec3 sum = texture(image, tex_coords + vec2(-2.0 * half_pixel.x, 0.0)).rgb;
+    sum += texture(image, tex_coords + vec2(-half_pixel.x, half_pixel.y)).rgb * 2.0;
+    sum += texture(image, tex_coords + vec2(0.0, 2.0 * half_pixel.y)).rgb;
+    sum += texture(image, tex_coords + vec2(half_pixel.x, half_pixel.y)).rgb * 2.0;
+    sum += texture(image, tex_coords + vec2(2.0 * half_pixel.x, 0.0)).rgb;
+    sum += texture(image, tex_coords + vec2(half_pixel.x, -half_pixel.y)).rgb * 2.0;
+    sum += texture(image, tex_coords + vec2(0.0, -2.0 * half_pixel.y)).rgb;
+    sum += texture(image, tex_coords + vec2(-half_pixel.x, -half_pixel.y)).rgb * 2.0;
+    sum /= 12.0;
+
+    sum *= intensity;
+    if (exposure > 0.0)
+        sum = 1.0 - exp(-exposure * sum);
+    frag_color = vec4(sum, 1.0);
+}
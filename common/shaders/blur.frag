@@ -0,0 +1,34 @@
+#version 450 core
+
+// separable gaussian using the linear sampling trick: each tap after the
+// center one sits between two texels so that a single bilinear fetch
+// returns their weighted sum (9 texels in 5 fetches for radius 4)
+
+#define MAX_TAPS 17
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+
+uniform vec2 direction; // (1, 0) or (0, 1)
+uniform int tapCount;
+uniform float weights[MAX_TAPS];
+uniform float offsets[MAX_TAPS];
+uniform float exposure; // > 0 tone maps the last pass to the screen
+
+void main()
+{
+    vec2 tex_offset = direction / textureSize(image, 0);
+    vec3 result = texture(image, tex_coords).rgb * weights[0];
+    for (int i = 1; i < tapCount; ++i)
+    {
+        vec2 offset = tex_offset * offsets[i];
+        result += texture(image, tex_coords + offset).rgb * weights[i];
+        result += texture(image, tex_coords - offset).rgb * weights[i];
+    }
+    if (exposure > 0.0)
+        result = 1.0 - exp(-exposure * result);
+    frag_color = vec4(result, 1.0);
+}
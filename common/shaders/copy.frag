@@ -0,0 +1,16 @@
+#version 450 core
+
+out vec4 frag_color;
+
+in vec2 tex_coords;
+
+uniform sampler2D image;
+uniform float exposure; // > 0 tone maps the result
+
+void main()
+{
+    vec3 color = texture(image, tex_coords).rgb;
+    if (exposure > 0.0)
+        color = 1.0 - exp(-exposure * color);
+    frag_color = vec4(color, 1.0);
+}
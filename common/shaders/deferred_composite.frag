@@ -0,0 +1,16 @@
+#version 450 core
+
+layout(binding=0) uniform sampler2D lightTexture;
+layout(binding=1) uniform sampler2D albedoTexture;
+
+uniform vec3 ambient;
+
+in vec2 tex_coords;
+
+out vec4 frag_color;
+
+void main()
+{
+    vec4 albedo = texture(albedoTexture, tex_coords);
+    frag_color = vec4(texture(lightTexture, tex_coords).rgb + ambient * albedo.rgb, albedo.a);
+}
@@ -0,0 +1,53 @@
+#version 450 core
+
+vec3 decodeNormal(vec2 e);
+
+layout(binding=0) uniform sampler2D normalTexture;
+layout(binding=1) uniform sampler2D albedoTexture;
+layout(binding=2) uniform sampler2D depthTexture;
+layout(binding=3) uniform sampler2DArrayShadow shadowMapTexture;
+
+uniform mat4 inverseViewProjection;
+uniform vec4 lightPosition; // w: radius
+uniform vec3 lightColor;
+uniform int shadowLayer; // negative if unshadowed
+uniform mat4 lightViewProjection;
+
+in vec2 tex_coords;
+
+out vec4 frag_color;
+
+float attenuation(float lightDistance, float radius)
+{
+    float x = lightDistance / radius;
+    float w = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return w * w;
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    float depth = texelFetch(depthTexture, texel, 0).r;
+    if (depth == 1.0)
+        discard;
+
+    vec4 p = inverseViewProjection * vec4(2.0 * tex_coords - 1.0, 2.0 * depth - 1.0, 1.0);
+    vec3 position = p.xyz / p.w;
+    vec3 normal = decodeNormal(texelFetch(normalTexture, texel, 0).xy);
+
+    vec3 toLight = lightPosition.xyz - position;
+    float lightDistance = length(toLight);
+    float intensity = attenuation(lightDistance, lightPosition.w) * max(dot(normal, toLight / lightDistance), 0.0);
+    if (intensity <= 0.0)
+        discard;
+
+    if (shadowLayer >= 0)
+    {
+        vec4 positionInLightSpace = lightViewProjection * vec4(position, 1.0);
+        vec3 projCoords = 0.5 * positionInLightSpace.xyz / positionInLightSpace.w + 0.5;
+        intensity *= texture(shadowMapTexture, vec4(projCoords.xy, float(shadowLayer), projCoords.z));
+    }
+
+    frag_color = vec4(intensity * lightColor * texelFetch(albedoTexture, texel, 0).rgb, 1.0);
+}
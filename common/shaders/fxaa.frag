@@ -0,0 +1,45 @@
+#version 450 core
+
+layout(binding=0) uniform sampler2D sceneTexture;
+
+in vec2 tex_coords;
+
+out vec4 frag_color;
+
+const float ReduceMin = 1.0 / 128.0;
+const float ReduceMul = 1.0 / 8.0;
+const float SpanMax = 8.0;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(sceneTexture, 0));
+
+    vec4 colorM = texture(sceneTexture, tex_coords);
+    float lumaNW = luma(texture(sceneTexture, tex_coords + vec2(-1.0, -1.0) * texelSize).rgb);
+    float lumaNE = luma(texture(sceneTexture, tex_coords + vec2(1.0, -1.0) * texelSize).rgb);
+    float lumaSW = luma(texture(sceneTexture, tex_coords + vec2(-1.0, 1.0) * texelSize).rgb);
+    float lumaSE = luma(texture(sceneTexture, tex_coords + vec2(1.0, 1.0) * texelSize).rgb);
+    float lumaM = luma(colorM.rgb);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // blur along the edge, perpendicular to the luma gradient
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * ReduceMul, ReduceMin);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SpanMax), vec2(SpanMax)) * texelSize;
+
+    vec3 colorA = 0.5 * (texture(sceneTexture, tex_coords + dir * (1.0 / 3.0 - 0.5)).rgb +
+                         texture(sceneTexture, tex_coords + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 colorB = 0.5 * colorA + 0.25 * (texture(sceneTexture, tex_coords - 0.5 * dir).rgb +
+                                         texture(sceneTexture, tex_coords + 0.5 * dir).rgb);
+    float lumaB = luma(colorB);
+
+    frag_color = vec4((lumaB < lumaMin || lumaB > lumaMax) ? colorA : colorB, colorM.a);
+}
@@ -0,0 +1,15 @@
+#version 450 core
+
+// weighted blended order-independent transparency (McGuire & Bavoil 2013),
+// writes a translucent fragment into the accumulation and revealage targets
+
+layout(location=0) out vec4 accumulation;
+layout(location=1) out float revealage;
+
+void writeColor(vec4 color)
+{
+    float a = color.a;
+    float w = clamp(pow(min(1.0, a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    accumulation = vec4(color.rgb * a, a) * w;
+    revealage = a;
+}
@@ -0,0 +1,19 @@
+#version 450 core
+
+layout(binding=0) uniform sampler2D accumulationTexture;
+layout(binding=1) uniform sampler2D revealageTexture;
+
+out vec4 frag_color;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    float revealage = texelFetch(revealageTexture, texel, 0).r;
+    if (revealage >= 1.0)
+        discard;
+
+    vec4 accumulation = texelFetch(accumulationTexture, texel, 0);
+    vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+    frag_color = vec4(average, 1.0 - revealage);
+}
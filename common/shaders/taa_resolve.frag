@@ -0,0 +1,47 @@
+#version 450 core
+
+layout(binding=0) uniform sampler2D sceneTexture;
+layout(binding=1) uniform sampler2D depthTexture;
+layout(binding=2) uniform sampler2D historyTexture;
+
+uniform mat4 reprojection;
+uniform vec2 unjitter;
+uniform bool historyValid;
+uniform float historyWeight;
+
+in vec2 tex_coords;
+
+out vec4 frag_color;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 maxTexel = textureSize(sceneTexture, 0) - ivec2(1);
+
+    vec4 color = texelFetch(sceneTexture, texel, 0);
+    if (!historyValid) {
+        frag_color = color;
+        return;
+    }
+
+    vec4 minColor = color;
+    vec4 maxColor = color;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec4 neighbor = texelFetch(sceneTexture, clamp(texel + ivec2(x, y), ivec2(0), maxTexel), 0);
+            minColor = min(minColor, neighbor);
+            maxColor = max(maxColor, neighbor);
+        }
+    }
+
+    float depth = texelFetch(depthTexture, texel, 0).r;
+    vec4 position = reprojection * vec4(2.0 * tex_coords - 1.0 + unjitter, 2.0 * depth - 1.0, 1.0);
+    vec2 historyCoords = 0.5 * position.xy / position.w + 0.5;
+    if (any(lessThan(historyCoords, vec2(0.0))) || any(greaterThan(historyCoords, vec2(1.0)))) {
+        frag_color = color;
+        return;
+    }
+
+    vec4 history = clamp(texture(historyTexture, historyCoords), minColor, maxColor);
+    frag_color = mix(color, history, historyWeight);
+}
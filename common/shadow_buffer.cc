@@ -1,5 +1,7 @@
 #include "shadow_buffer.h"
 
+#include "framebuffer.h"
+
 namespace gl {
 
 shadow_buffer::shadow_buffer(int width, int height)
@@ -48,7 +50,7 @@ void shadow_buffer::bind() const
 
 void shadow_buffer::unbind() const
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebuffer::unbind();
 }
 
 void shadow_buffer::bind_texture() const
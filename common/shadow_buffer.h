@@ -21,6 +21,8 @@ public:
     int width() const { return width_; }
     int height() const { return height_; }
 
+    GLuint texture_handle() const { return texture_id_; }
+
 private:
     int width_;
     int height_;
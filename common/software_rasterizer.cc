@@ -0,0 +1,445 @@
+#include "software_rasterizer.h"
+
+#include "matrix.h"
+#include "panic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace gl {
+
+namespace {
+
+template<typename T>
+T lerp(const T &a, const T &b, float t)
+{
+    return a + t * (b - a);
+}
+
+unsigned char to_unorm8(float value)
+{
+    return static_cast<unsigned char>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+} // namespace
+
+// threads started once and woken for each job, so finish() doesn't pay for
+// creating them every frame
+class software_rasterizer::worker_pool : private noncopyable
+{
+public:
+    explicit worker_pool(int threads)
+    {
+        for (int i = 0; i < threads; ++i)
+            threads_.emplace_back([this] { work(); });
+    }
+
+    ~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &thread : threads_)
+            thread.join();
+    }
+
+    // runs job on every worker and on the calling thread, returns when all
+    // of them are done
+    void run(const std::function<void()> &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            busy_ = threads_.size();
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        job();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return busy_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    void work()
+    {
+        std::uint64_t generation = 0;
+        for (;;) {
+            const std::function<void()> *job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this, generation] { return stop_ || generation_ != generation; });
+                if (stop_)
+                    return;
+                generation = generation_;
+                job = job_;
+            }
+
+            (*job)();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void()> *job_ = nullptr;
+    std::uint64_t generation_ = 0;
+    std::size_t busy_ = 0;
+    bool stop_ = false;
+    std::vector<std::thread> threads_;
+};
+
+software_rasterizer::software_rasterizer(int width, int height, bool depth_only, int threads)
+    : width_(width)
+    , height_(height)
+    , depth_only_(depth_only)
+    , tile_columns_((width + TileSize - 1) / TileSize)
+    , tile_rows_((height + TileSize - 1) / TileSize)
+    , uniforms_(1)
+    , color_(depth_only ? 0 : width * height * 4)
+    , depth_(width * height)
+    , bins_(tile_columns_ * tile_rows_)
+{
+    if (width <= 0 || height <= 0)
+        panic("invalid software rasterizer size %dx%d\n", width, height);
+
+    // the thread calling finish() is one of them
+    const int thread_count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers_.reset(new worker_pool(thread_count - 1));
+}
+
+software_rasterizer::~software_rasterizer() = default;
+
+void software_rasterizer::clear(const glm::vec4 &color)
+{
+    // color_ is empty for depth_only rasterizers
+    const unsigned char rgba[] = { to_unorm8(color.x), to_unorm8(color.y), to_unorm8(color.z), to_unorm8(color.w) };
+    for (std::size_t i = 0; i < color_.size(); i += 4)
+        std::copy(std::begin(rgba), std::end(rgba), &color_[i]);
+    std::fill(depth_.begin(), depth_.end(), 1.0f);
+
+    triangles_.clear();
+    for (auto &bin : bins_)
+        bin.clear();
+    uniforms_.front() = uniforms_.back();
+    uniforms_.resize(1);
+}
+
+void software_rasterizer::set_lighting(const lighting &lighting)
+{
+    next_uniforms().light = lighting;
+}
+
+void software_rasterizer::set_shadow(const shadow &shadow)
+{
+    next_uniforms().shadowing = shadow;
+}
+
+software_rasterizer::uniforms &software_rasterizer::next_uniforms()
+{
+    if (!triangles_.empty() && triangles_.back().uniforms == static_cast<int>(uniforms_.size()) - 1)
+        uniforms_.push_back(uniforms_.back());
+    return uniforms_.back();
+}
+
+void software_rasterizer::draw(const std::vector<vertex> &verts, int first, int count, const transform &transform)
+{
+    for (int i = first; i + 2 < first + count; i += 3) {
+        add_triangle(transform_vertex(verts[i], transform), transform_vertex(verts[i + 1], transform),
+                     transform_vertex(verts[i + 2], transform));
+    }
+}
+
+void software_rasterizer::draw_instanced(const std::vector<vertex> &verts, int first, int count,
+                                         const transform &transform, const std::vector<instance> &instances)
+{
+    for (const auto &instance : instances) {
+        const software_rasterizer::transform instance_transform = {
+            multiply(transform.mvp, instance.transform), multiply(transform.model_view, instance.transform),
+            transform.normal * glm::mat3(instance.transform), multiply(transform.light_mvp, instance.transform)
+        };
+        for (int i = first; i + 2 < first + count; i += 3) {
+            add_triangle(transform_vertex(verts[i], instance_transform, instance.color),
+                         transform_vertex(verts[i + 1], instance_transform, instance.color),
+                         transform_vertex(verts[i + 2], instance_transform, instance.color));
+        }
+    }
+}
+
+void software_rasterizer::draw(const std::vector<vertex> &verts, const std::vector<unsigned> &indices,
+                               const transform &transform)
+{
+    std::vector<clip_vertex> clip_verts(verts.size());
+    std::transform(verts.begin(), verts.end(), clip_verts.begin(),
+                   [&transform](const vertex &v) { return transform_vertex(v, transform); });
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        add_triangle(clip_verts[indices[i]], clip_verts[indices[i + 1]], clip_verts[indices[i + 2]]);
+}
+
+software_rasterizer::clip_vertex software_rasterizer::transform_vertex(const vertex &v, const transform &transform,
+                                                                     const glm::vec4 &color)
+{
+    const auto position = glm::vec4(v.position, 1.0f);
+    return { transform.mvp * position, glm::vec3(transform.model_view * position), transform.normal * v.normal,
+             glm::vec4(v.color, 1.0f) * color, transform.light_mvp * position };
+}
+
+void software_rasterizer::add_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2)
+{
+    // clip against the near plane (z > -w), which also keeps w positive.
+    // far, left, right, top and bottom are left to the bounding box and the
+    // depth test
+    const clip_vertex in[] = { v0, v1, v2 };
+    clip_vertex out[4];
+    int out_count = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        const auto &a = in[i];
+        const auto &b = in[(i + 1) % 3];
+        const float da = a.position.z + a.position.w;
+        const float db = b.position.z + b.position.w;
+
+        if (da >= 0)
+            out[out_count++] = a;
+        if ((da >= 0) != (db >= 0)) {
+            const float t = da / (da - db);
+            out[out_count++] = { a.position + t * (b.position - a.position),
+                                 lerp(a.lighting_position, b.lighting_position, t), lerp(a.normal, b.normal, t),
+                                 lerp(a.color, b.color, t), lerp(a.light_position, b.light_position, t) };
+        }
+    }
+
+    for (int i = 1; i + 1 < out_count; ++i)
+        setup_triangle(out[0], out[i], out[i + 1]);
+}
+
+void software_rasterizer::setup_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2)
+{
+    const clip_vertex *verts[] = { &v0, &v1, &v2 };
+
+    glm::vec2 window[3];
+    triangle t;
+    t.draw_state = state_;
+    t.uniforms = uniforms_.size() - 1;
+    for (int i = 0; i < 3; ++i) {
+        const auto &v = *verts[i];
+        const float inv_w = 1.0f / v.position.w;
+        const auto ndc = glm::vec3(v.position) * inv_w;
+        window[i] = glm::vec2((ndc.x * 0.5f + 0.5f) * width_, (ndc.y * 0.5f + 0.5f) * height_);
+        t.depth[i] = ndc.z * 0.5f + 0.5f;
+        t.inv_w[i] = inv_w;
+        t.lighting_position[i] = v.lighting_position * inv_w;
+        t.normal[i] = v.normal * inv_w;
+        t.color[i] = v.color * inv_w;
+        t.light_position[i] = v.light_position * inv_w;
+    }
+
+    float area = (window[1].x - window[0].x) * (window[2].y - window[0].y) -
+                 (window[1].y - window[0].y) * (window[2].x - window[0].x);
+    // window y points up, so counter-clockwise triangles have a positive area
+    if (area == 0.0f || (state_.cull_back_faces && area < 0))
+        return;
+
+    const float sign = area > 0 ? 1.0f : -1.0f;
+    area *= sign;
+
+    // weight of vertex i is the edge function of the opposite edge, normalized.
+    // the functions increase towards the inside, so a left edge has ex > 0
+    // and a top edge (y points up) ex == 0 and ey < 0
+    t.top_left = 0;
+    for (int i = 0; i < 3; ++i) {
+        const auto &a = window[(i + 1) % 3];
+        const auto &b = window[(i + 2) % 3];
+        const float ex = -(b.y - a.y) * sign / area;
+        const float ey = (b.x - a.x) * sign / area;
+        t.edges[i] = glm::vec3(ex, ey, -(ex * a.x + ey * a.y));
+        if (ex > 0 || (ex == 0 && ey < 0))
+            t.top_left |= 1 << i;
+    }
+
+    const auto lo = glm::min(window[0], glm::min(window[1], window[2]));
+    const auto hi = glm::max(window[0], glm::max(window[1], window[2]));
+    t.min_x = std::max(0, static_cast<int>(std::floor(lo.x)));
+    t.min_y = std::max(0, static_cast<int>(std::floor(lo.y)));
+    t.max_x = std::min(width_ - 1, static_cast<int>(std::ceil(hi.x)));
+    t.max_y = std::min(height_ - 1, static_cast<int>(std::ceil(hi.y)));
+    if (t.min_x > t.max_x || t.min_y > t.max_y)
+        return;
+
+    const unsigned index = triangles_.size();
+    triangles_.push_back(t);
+
+    for (int row = t.min_y / TileSize; row <= t.max_y / TileSize; ++row) {
+        for (int column = t.min_x / TileSize; column <= t.max_x / TileSize; ++column)
+            bins_[row * tile_columns_ + column].push_back(index);
+    }
+}
+
+void software_rasterizer::finish()
+{
+    std::atomic<int> next_tile = 0;
+    workers_->run([this, &next_tile] {
+        for (int tile; (tile = next_tile++) < static_cast<int>(bins_.size());)
+            rasterize_tile(tile);
+    });
+}
+
+int software_rasterizer::cover(const triangle &t, int x, float py, int last_x, float *l0, float *l1, float *l2,
+                               float *z)
+{
+#if defined(__AVX2__) && defined(__FMA__)
+    static_assert(Lanes == 8, "one AVX register of lanes");
+    const auto lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const auto px = _mm256_add_ps(_mm256_set1_ps(x + 0.5f), lane);
+    const auto edge = [&px, py](const glm::vec3 &e) {
+        return _mm256_fmadd_ps(_mm256_set1_ps(e.x), px, _mm256_set1_ps(e.y * py + e.z));
+    };
+    const auto e0 = edge(t.edges[0]);
+    const auto e1 = edge(t.edges[1]);
+    const auto e2 = edge(t.edges[2]);
+    const auto depth = _mm256_fmadd_ps(
+            e0, _mm256_set1_ps(t.depth[0]),
+            _mm256_fmadd_ps(e1, _mm256_set1_ps(t.depth[1]), _mm256_mul_ps(e2, _mm256_set1_ps(t.depth[2]))));
+    _mm256_storeu_ps(l0, e0);
+    _mm256_storeu_ps(l1, e1);
+    _mm256_storeu_ps(l2, e2);
+    _mm256_storeu_ps(z, depth);
+
+    const auto zero = _mm256_setzero_ps();
+    const auto all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    const auto inside_edge = [&t, &zero, &all](__m256 e, int i) {
+        const auto on_edge = _mm256_and_ps(_mm256_cmp_ps(e, zero, _CMP_EQ_OQ), t.top_left & (1 << i) ? all : zero);
+        return _mm256_or_ps(_mm256_cmp_ps(e, zero, _CMP_GT_OQ), on_edge);
+    };
+    auto inside = _mm256_and_ps(inside_edge(e0, 0), inside_edge(e1, 1));
+    inside = _mm256_and_ps(inside, inside_edge(e2, 2));
+    inside = _mm256_and_ps(inside, _mm256_cmp_ps(lane, _mm256_set1_ps(last_x - x), _CMP_LE_OQ));
+    return _mm256_movemask_ps(inside);
+#else
+    const auto inside_edge = [&t](float e, int i) { return e > 0 || (e == 0 && (t.top_left & (1 << i))); };
+    int mask = 0;
+    for (int lane = 0; lane < Lanes; ++lane) {
+        const float px = x + lane + 0.5f;
+        l0[lane] = t.edges[0].x * px + (t.edges[0].y * py + t.edges[0].z);
+        l1[lane] = t.edges[1].x * px + (t.edges[1].y * py + t.edges[1].z);
+        l2[lane] = t.edges[2].x * px + (t.edges[2].y * py + t.edges[2].z);
+        z[lane] = l0[lane] * t.depth[0] + l1[lane] * t.depth[1] + l2[lane] * t.depth[2];
+        if (inside_edge(l0[lane], 0) && inside_edge(l1[lane], 1) && inside_edge(l2[lane], 2) && x + lane <= last_x)
+            mask |= 1 << lane;
+    }
+    return mask;
+#endif
+}
+
+void software_rasterizer::rasterize_tile(int tile)
+{
+    const int tile_x = (tile % tile_columns_) * TileSize;
+    const int tile_y = (tile / tile_columns_) * TileSize;
+
+    for (const auto index : bins_[tile]) {
+        const auto &t = triangles_[index];
+
+        const int x0 = std::max(t.min_x, tile_x);
+        const int x1 = std::min(t.max_x, tile_x + TileSize - 1);
+        const int y0 = std::max(t.min_y, tile_y);
+        const int y1 = std::min(t.max_y, tile_y + TileSize - 1);
+
+        for (int y = y0; y <= y1; ++y) {
+            const float py = y + 0.5f;
+            for (int x = x0; x <= x1; x += Lanes) {
+                float l0[Lanes], l1[Lanes], l2[Lanes], z[Lanes];
+                const int inside = cover(t, x, py, x1, l0, l1, l2, z);
+                if (!inside)
+                    continue;
+
+                for (int lane = 0; lane < Lanes; ++lane) {
+                    const int pixel = y * width_ + x + lane;
+                    if (!(inside & (1 << lane)) || !(z[lane] < depth_[pixel]))
+                        continue;
+                    if (t.draw_state.depth_write)
+                        depth_[pixel] = z[lane];
+                    if (depth_only_)
+                        continue;
+
+                    const auto color = shade(t, l0[lane], l1[lane], l2[lane]);
+                    auto *p = &color_[pixel * 4];
+                    if (t.draw_state.blend) {
+                        const float a = std::clamp(color.w, 0.0f, 1.0f);
+                        for (int i = 0; i < 4; ++i)
+                            p[i] = to_unorm8(color[i] * a + p[i] / 255.0f * (1.0f - a));
+                    } else {
+                        for (int i = 0; i < 4; ++i)
+                            p[i] = to_unorm8(color[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+glm::vec4 software_rasterizer::shade(const triangle &t, float l0, float l1, float l2) const
+{
+    const float w = 1.0f / (l0 * t.inv_w[0] + l1 * t.inv_w[1] + l2 * t.inv_w[2]);
+    const auto interpolate = [l0, l1, l2, w](const auto *v) { return (l0 * v[0] + l1 * v[1] + l2 * v[2]) * w; };
+
+    const auto position = interpolate(t.lighting_position);
+    const auto normal = glm::normalize(interpolate(t.normal));
+    const auto color = interpolate(t.color);
+    const auto rgb = glm::vec3(color);
+
+    const auto &[lighting, shadow] = uniforms_[t.uniforms];
+    const auto to_light = glm::normalize(lighting.light_position - position);
+    const float lambert = std::max(glm::dot(normal, to_light), 0.0f);
+    auto result = (lighting.tint_ambient ? lighting.ambient * rgb : glm::vec3(lighting.ambient)) +
+                  lighting.diffuse * lambert * rgb;
+    if (lighting.specular > 0 && lambert > 0) {
+        const auto half = glm::normalize(to_light + glm::normalize(lighting.eye_position - position));
+        result += glm::vec3(lighting.specular * std::pow(std::max(glm::dot(normal, half), 0.0f), lighting.shininess));
+    }
+    if (shadow.map)
+        result *= shadow_factor(shadow, interpolate(t.light_position));
+    return glm::vec4(result, color.w);
+}
+
+float software_rasterizer::shadow_factor(const shadow &shadow, const glm::vec4 &light_position)
+{
+    const auto &map = *shadow.map;
+    const auto p = glm::vec3(light_position) / light_position.w * 0.5f + 0.5f;
+
+    // outside of the map is lit, like a GL_CLAMP_TO_BORDER map with a border
+    // depth of 1
+    int lit = 0;
+    for (int i = 0; i < shadow.taps; ++i) {
+        for (int j = 0; j < shadow.taps; ++j) {
+            const auto offset = shadow.taps > 1
+                                        ? (glm::vec2(i, j) / (shadow.taps - 1.0f) * 2.0f - 1.0f) * shadow.radius
+                                        : glm::vec2(0);
+            const int x = static_cast<int>(std::floor(p.x * map.width_ + offset.x));
+            const int y = static_cast<int>(std::floor(p.y * map.height_ + offset.y));
+            if (x < 0 || x >= map.width_ || y < 0 || y >= map.height_ ||
+                p.z <= map.depth_[y * map.width_ + x] + shadow.bias)
+                ++lit;
+        }
+    }
+    return std::min(static_cast<float>(lit) / (shadow.taps * shadow.taps) + shadow.light, 1.0f);
+}
+
+} // namespace gl
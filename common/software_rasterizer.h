@@ -0,0 +1,182 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace gl {
+
+// cpu renderer for the lit triangle meshes of the demos, for machines
+// without a GPU. draw() transforms, clips against the near plane and bins the
+// triangles into square screen tiles, finish() rasterizes the tiles on a
+// pool of worker threads that sleep between frames. inside a tile a row is
+// covered Lanes pixels at a time, with AVX2 intrinsics when built with
+// -DENABLE_AVX2=ON and with fixed width loops otherwise.
+//
+// the color buffer is RGBA8, bottom row first like glReadPixels, and depth is
+// tested with GL_LESS. tiles keep the triangles in draw order, so blending
+// composites like GL does. a depth_only rasterizer has no color buffer and
+// doesn't shade, it renders shadow maps for set_shadow().
+class software_rasterizer : private noncopyable
+{
+public:
+    struct vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 color;
+    };
+
+    // the uniforms of the demos' vertex shaders
+    struct transform
+    {
+        glm::mat4 mvp;
+        glm::mat4 model_view; // for the lighting position
+        glm::mat3 normal;
+        glm::mat4 light_mvp = glm::mat4(1); // to the clip space of the shadow map
+    };
+
+    // what the demos keep per instance in a shader storage buffer: a model
+    // matrix applied before the draw's transform, and a color multiplying the
+    // vertex colors, with the alpha used for blending
+    struct instance
+    {
+        glm::mat4 transform;
+        glm::vec4 color;
+    };
+
+    // ambient plus lambert against a point light, in the lighting space, plus
+    // an optional blinn-phong highlight. slices' shader tints the ambient
+    // with the color, the others add it gray
+    struct lighting
+    {
+        glm::vec3 light_position = glm::vec3(0);
+        float ambient = 0.15f;
+        bool tint_ambient = true;
+        float diffuse = 1.0f;
+        float specular = 0.0f;
+        float shininess = 8.0f;
+        glm::vec3 eye_position = glm::vec3(0);
+    };
+
+    // lookups into a depth_only rasterizer rendered with the light_mvp of
+    // the transforms. taps x taps samples spread over radius texels, a fully
+    // shadowed pixel keeps light of its color: min(lit + light, 1) like the
+    // demos' shaders
+    struct shadow
+    {
+        const software_rasterizer *map = nullptr;
+        float bias = 0.005f;
+        float radius = 5.0f;
+        int taps = 3;
+        float light = 0.5f;
+    };
+
+    // fixed function state of the following draws
+    struct state
+    {
+        bool depth_write = true;
+        bool blend = false; // SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+        bool cull_back_faces = false; // counter-clockwise is front, like GL
+    };
+
+    // 0 threads uses all the cores
+    software_rasterizer(int width, int height, bool depth_only = false, int threads = 0);
+    ~software_rasterizer();
+
+    static constexpr auto TileSize = 64;
+    static constexpr auto Lanes = 8;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // like GL uniforms and state, these apply to the triangles drawn after
+    // them until they are set again
+    void set_lighting(const lighting &lighting);
+    void set_shadow(const shadow &shadow);
+    void set_state(const state &state) { state_ = state; }
+
+    // depth_only rasterizers only clear depth
+    void clear(const glm::vec4 &color = glm::vec4(0));
+
+    // count vertices from first, three per triangle
+    void draw(const std::vector<vertex> &verts, int first, int count, const transform &transform);
+    void draw(const std::vector<vertex> &verts, const std::vector<unsigned> &indices, const transform &transform);
+    void draw_instanced(const std::vector<vertex> &verts, int first, int count, const transform &transform,
+                        const std::vector<instance> &instances);
+
+    // rasterizes everything drawn since clear(). a shadow map must be
+    // finished before the rasterizers sampling it
+    void finish();
+
+    const unsigned char *pixels() const { return color_.data(); }
+
+private:
+    class worker_pool;
+
+    struct clip_vertex
+    {
+        glm::vec4 position;
+        glm::vec3 lighting_position;
+        glm::vec3 normal;
+        glm::vec4 color;
+        glm::vec4 light_position;
+    };
+
+    // the lighting and shadow of a run of draws
+    struct uniforms
+    {
+        lighting light;
+        shadow shadowing;
+    };
+
+    struct triangle
+    {
+        // barycentric weight i is edges[i].x * x + edges[i].y * y + edges[i].z
+        glm::vec3 edges[3];
+        // bit i when pixels exactly on edge i are inside: the top and left
+        // edges, so a pixel on an edge shared by two triangles is drawn once
+        int top_left;
+        glm::vec3 depth; // window z per vertex
+        glm::vec3 inv_w;
+        // divided by w, for perspective correct interpolation
+        glm::vec3 lighting_position[3];
+        glm::vec3 normal[3];
+        glm::vec4 color[3];
+        glm::vec4 light_position[3];
+        int min_x, min_y, max_x, max_y;
+        state draw_state; // set_state() when it was drawn
+        int uniforms; // index in uniforms_
+    };
+
+    static clip_vertex transform_vertex(const vertex &v, const transform &transform,
+                                        const glm::vec4 &color = glm::vec4(1));
+    void add_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2);
+    void setup_triangle(const clip_vertex &v0, const clip_vertex &v1, const clip_vertex &v2);
+    void rasterize_tile(int tile);
+    // edge functions and depth of the Lanes pixels from x, returns a bit per
+    // lane inside the triangle and not past last_x
+    static int cover(const triangle &t, int x, float py, int last_x, float *l0, float *l1, float *l2, float *z);
+    glm::vec4 shade(const triangle &t, float l0, float l1, float l2) const;
+    static float shadow_factor(const shadow &shadow, const glm::vec4 &light_position);
+    // the uniforms the next triangles get, copied first if drawn ones use them
+    uniforms &next_uniforms();
+
+    int width_;
+    int height_;
+    bool depth_only_;
+    int tile_columns_;
+    int tile_rows_;
+    std::vector<uniforms> uniforms_; // since clear(), the last one is current
+    state state_;
+    std::vector<unsigned char> color_;
+    std::vector<float> depth_;
+    std::vector<triangle> triangles_;
+    std::vector<std::vector<unsigned>> bins_; // triangle indexes per tile, in draw order
+    std::unique_ptr<worker_pool> workers_;
+};
+
+} // namespace gl
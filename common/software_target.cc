@@ -0,0 +1,87 @@
+#include "software_target.h"
+
+#include "panic.h"
+#include "software_rasterizer.h"
+#include "util.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace gl {
+
+software_target::software_target(int width, int height)
+    : texture_(width, height, { { GL_RGBA8 }, GL_NONE })
+{
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/copy.frag");
+    program_.link();
+    exposure_location_ = program_.uniform_location("exposure");
+}
+
+void software_target::draw(const software_rasterizer &rasterizer)
+{
+    const int width = texture_.width();
+    const int height = texture_.height();
+    if (rasterizer.width() != width || rasterizer.height() != height)
+        panic("software rasterizer is %dx%d, target %dx%d\n", rasterizer.width(), rasterizer.height(), width, height);
+
+    glActiveTexture(GL_TEXTURE0);
+    texture_.bind_texture();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rasterizer.pixels());
+
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    glViewport(0, 0, width, height);
+    program_.bind();
+    program_.set_uniform(exposure_location_, 0.0f);
+    quad_.bind();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (blend)
+        glEnable(GL_BLEND);
+    if (depth_test)
+        glEnable(GL_DEPTH_TEST);
+}
+
+float compare_software(int width, int height, const std::function<void(bool software)> &render)
+{
+    std::array<std::vector<unsigned char>, 2> frames;
+    for (int i = 0; i < 2; ++i) {
+        render(i == 1);
+        dump_frame_to_file(i == 1 ? "software.ppm" : "hardware.ppm", width, height);
+        frames[i].resize(width * height * 3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, frames[i].data());
+    }
+
+    constexpr auto Threshold = 2;
+    int max_difference = 0;
+    int differing_pixels = 0;
+    for (std::size_t i = 0; i < frames[0].size(); i += 3) {
+        int difference = 0;
+        for (int j = 0; j < 3; ++j)
+            difference = std::max(difference, std::abs(frames[0][i + j] - frames[1][i + j]));
+        max_difference = std::max(max_difference, difference);
+        if (difference > Threshold)
+            ++differing_pixels;
+    }
+    const float percentage = 100.0f * differing_pixels / (width * height);
+    std::printf("software parity: max difference %d, %.2f%% of pixels differ by more than %d\n", max_difference,
+                percentage, Threshold);
+    return percentage;
+}
+
+} // namespace gl
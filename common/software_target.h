@@ -0,0 +1,42 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "framebuffer.h"
+#include "geometry.h"
+#include "shader_program.h"
+
+#include <functional>
+
+namespace gl {
+
+class software_rasterizer;
+
+// shows the color buffer of a software_rasterizer: uploads it to a texture
+// and draws it with a full screen quad over the bound framebuffer. unlike a
+// blit this also works when the frame is multisampled (gl::antialiasing).
+class software_target : private noncopyable
+{
+public:
+    software_target(int width, int height);
+
+    // the sizes must match. leaves blending and the depth test as it found
+    // them
+    void draw(const software_rasterizer &rasterizer);
+
+private:
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    framebuffer texture_;
+    gl::geometry quad_;
+    gl::shader_program program_;
+    int exposure_location_;
+};
+
+// golden frame diff for -p software_check: renders a frame with
+// render(false) on the GPU and one with render(true) on the cpu, writes them
+// as hardware.ppm and software.ppm and returns the percentage of pixels
+// where a channel differs by more than 2. edges differ where the GPU frame
+// is multisampled
+float compare_software(int width, int height, const std::function<void(bool software)> &render);
+
+} // namespace gl
@@ -0,0 +1,81 @@
+#include "tiled_capture.h"
+
+#include "panic.h"
+
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+namespace gl {
+
+namespace {
+
+// all tiles but the last have this size, the last one is cropped to the image
+int tile_size(int size, int divisions)
+{
+    if (divisions <= 0)
+        divisions = (size + tiled_capture::MaxTileSize - 1) / tiled_capture::MaxTileSize;
+    const auto tile = (size + divisions - 1) / divisions;
+    if ((divisions - 1) * tile >= size)
+        panic("capture size %d can't be split into %d tiles, the last would be empty\n", size, divisions);
+    return tile;
+}
+
+} // namespace
+
+tiled_capture::tiled_capture(const char *path, int width, int height, int columns, int rows)
+    : width_(width)
+    , height_(height)
+    , tile_width_(tile_size(width, columns))
+    , tile_height_(tile_size(height, rows))
+    , columns_((width + tile_width_ - 1) / tile_width_)
+    , rows_((height + tile_height_ - 1) / tile_height_)
+    , out_(std::fopen(path, "wb"))
+{
+    if (!out_)
+        panic("failed to open %s\n", path);
+    header_size_ = std::fprintf(out_, "P6\n%d %d\n255\n", width_, height_);
+    pixels_.resize(tile_width() * tile_height() * 3);
+}
+
+tiled_capture::~tiled_capture()
+{
+    std::fclose(out_);
+}
+
+glm::mat4 tiled_capture::tile_projection(int tile, const glm::mat4 &projection) const
+{
+    const auto column = static_cast<float>(tile % columns_);
+    const auto row = static_cast<float>(tile / columns_);
+    // tiles per image side, fractional when the last tile is cropped
+    const auto n = static_cast<float>(width_) / tile_width_;
+    const auto m = static_cast<float>(height_) / tile_height_;
+    // the projection was made for the tile's aspect ratio, scaling x by m/n
+    // gives the one of the full image. the tile's NDC rectangle is then
+    // scaled up to [-1, 1]; the part of a cropped tile past the image edge is
+    // rendered but not written
+    return glm::translate(glm::mat4(1), glm::vec3(n - 1 - 2 * column, m - 1 - 2 * row, 0)) *
+           glm::scale(glm::mat4(1), glm::vec3(m, m, 1)) * projection;
+}
+
+void tiled_capture::write_tile(int tile)
+{
+    const int x = (tile % columns_) * tile_width_;
+    const int y = (tile / columns_) * tile_height_;
+    const int w = std::min(tile_width_, width_ - x);
+    const int h = std::min(tile_height_, height_ - y);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels_.data());
+
+    // GL rows go up, PPM rows go down
+    for (int i = 0; i < h; ++i) {
+        const long offset = header_size_ + (static_cast<long>(height_ - 1 - (y + i)) * width_ + x) * 3;
+        std::fseek(out_, offset, SEEK_SET);
+        std::fwrite(&pixels_[i * w * 3], 1, w * 3, out_);
+    }
+}
+
+} // namespace gl
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdio>
+#include <vector>
+
+namespace gl {
+
+// renders a still larger than the GPU can hold in one framebuffer as a grid
+// of tiles. every tile is rendered with the demo's projection narrowed to the
+// tile's off-axis sub-frustum, read back and written straight to its place in
+// a binary PPM, so memory is bounded by the tile size.
+//
+// screen-space effects (blur, bloom) are evaluated per tile and may show at
+// the tile seams.
+class tiled_capture : private noncopyable
+{
+public:
+    // 0 columns or rows picks the smallest grid with tiles no larger than
+    // MaxTileSize. sizes that don't divide evenly get a narrower last column
+    // or row
+    tiled_capture(const char *path, int width, int height, int columns = 0, int rows = 0);
+    ~tiled_capture();
+
+    static constexpr auto MaxTileSize = 1024;
+
+    int columns() const { return columns_; }
+    int rows() const { return rows_; }
+    int tile_count() const { return columns_ * rows_; }
+    int tile_width() const { return tile_width_; }
+    int tile_height() const { return tile_height_; }
+
+    // maps a projection made for the tile's aspect ratio to the tile's part
+    // of the full image
+    glm::mat4 tile_projection(int tile, const glm::mat4 &projection) const;
+
+    // reads the tile back from the default framebuffer
+    void write_tile(int tile);
+
+private:
+    int width_;
+    int height_;
+    int tile_width_;
+    int tile_height_;
+    int columns_;
+    int rows_;
+    std::FILE *out_;
+    long header_size_;
+    std::vector<unsigned char> pixels_;
+};
+
+} // namespace gl
@@ -5,13 +5,13 @@
 #include <vector>
 #include <cstdio>
 
-void dump_frame_to_file(const char *path, int width, int height)
+void dump_frame_to_file(const char *path, int width, int height, std::pmr::memory_resource *memory)
 {
     auto *out = std::fopen(path, "wb");
     if (!out)
         return;
 
-    std::vector<char> frame_data(width * height * 4);
+    std::pmr::vector<char> frame_data(width * height * 4, memory);
     glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame_data.data());
 
     std::fprintf(out, "P6\n%d %d\n255\n", width, height);
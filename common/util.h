@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory_resource>
 #include <string_view>
 
-void dump_frame_to_file(const char *file_name, int width, int height);
+// the pixels are read back into memory from the given resource, demos
+// dumping every frame pass their frame_arena so it stays off the heap
+void dump_frame_to_file(const char *file_name, int width, int height,
+                        std::pmr::memory_resource *memory = std::pmr::get_default_resource());
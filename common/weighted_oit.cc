@@ -0,0 +1,102 @@
+#include "weighted_oit.h"
+
+#include "panic.h"
+
+#include <GL/glew.h>
+
+namespace gl {
+
+namespace {
+
+const framebuffer_format TargetFormat = { { GL_RGBA16F, GL_R16F }, GL_DEPTH24_STENCIL8 };
+
+}
+
+weighted_oit::weighted_oit(framebuffer_pool &pool, int width, int height)
+    : width_(width)
+    , height_(height)
+    , pool_(pool)
+{
+    quad_.set_data(std::vector<vertex>{
+            { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+    composite_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+    composite_program_.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/oit_composite.frag");
+    composite_program_.link();
+}
+
+void weighted_oit::attach_output(shader_program &program)
+{
+    program.add_shader(GL_FRAGMENT_SHADER, COMMON_SHADER_DIR "/oit.glsl");
+}
+
+void weighted_oit::bind()
+{
+    if (framebuffer_)
+        panic("weighted_oit::bind() called twice\n");
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer_);
+    saved_state_.blend = glIsEnabled(GL_BLEND);
+    saved_state_.depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &saved_state_.src_rgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &saved_state_.dst_rgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &saved_state_.src_alpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &saved_state_.dst_alpha);
+    framebuffer_ = pool_.acquire(width_, height_, TargetFormat);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target_framebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_->handle());
+    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    framebuffer_->bind();
+    glViewport(0, 0, width_, height_);
+
+    const GLfloat zero[] = { 0, 0, 0, 0 };
+    const GLfloat one[] = { 1, 1, 1, 1 };
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, one);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void weighted_oit::render()
+{
+    if (!framebuffer_)
+        panic("weighted_oit::render() without bind()\n");
+
+    glDepthMask(GL_TRUE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer_);
+    glViewport(0, 0, width_, height_);
+
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glActiveTexture(GL_TEXTURE0);
+    framebuffer_->bind_texture(0);
+    glActiveTexture(GL_TEXTURE1);
+    framebuffer_->bind_texture(1);
+
+    composite_program_.bind();
+    quad_.bind();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBlendFuncSeparate(saved_state_.src_rgb, saved_state_.dst_rgb, saved_state_.src_alpha, saved_state_.dst_alpha);
+    if (!saved_state_.blend)
+        glDisable(GL_BLEND);
+    if (saved_state_.depth_test)
+        glEnable(GL_DEPTH_TEST);
+
+    pool_.release(framebuffer_);
+    framebuffer_ = nullptr;
+}
+
+} // namespace gl
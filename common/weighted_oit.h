@@ -0,0 +1,55 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include "shader_program.h"
+#include "framebuffer_pool.h"
+#include "geometry.h"
+
+namespace gl {
+
+// weighted blended order-independent transparency: translucent geometry is
+// drawn once, in any order, into an RGBA16F accumulation target (weighted
+// premultiplied color) and an R16F revealage target (product of 1 - alpha),
+// then a single composite pass blends the weighted average over the target.
+//
+// fragment shaders declare `void writeColor(vec4 color);` and call it with
+// the straight alpha color, attach_output() links in the implementation.
+class weighted_oit : private noncopyable
+{
+public:
+    weighted_oit(framebuffer_pool &pool, int width, int height);
+
+    static void attach_output(shader_program &program);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // acquires the targets and copies the depth of the currently bound
+    // framebuffer into them (the depth formats must match), so translucent
+    // geometry is depth-tested against opaque geometry drawn before. depth
+    // writes are off until render()
+    void bind();
+
+    // composites over the framebuffer that was bound in bind(), releases
+    // the targets. blending, the blend functions and the depth test are left
+    // as bind() found them, depth writes are on
+    void render();
+
+private:
+    int width_;
+    int height_;
+    using vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad_;
+    gl::shader_program composite_program_;
+    framebuffer_pool &pool_;
+    gl::framebuffer *framebuffer_ = nullptr;
+    GLint target_framebuffer_ = 0;
+    struct
+    {
+        GLboolean blend, depth_test;
+        GLint src_rgb, dst_rgb, src_alpha, dst_alpha;
+    } saved_state_ = {};
+};
+
+} // namespace gl
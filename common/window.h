@@ -9,7 +9,9 @@ namespace gl {
 class window : private noncopyable
 {
 public:
-    window(int width, int height, const char *title);
+    // hidden windows don't wait for vsync, for benchmark runs. the default
+    // framebuffer is single sampled, see gl::antialiasing for msaa
+    window(int width, int height, const char *title, bool visible = true);
     ~window();
 
     int width() const { return width_; }
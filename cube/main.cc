@@ -4,6 +4,8 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
+#include "antialiasing.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -174,8 +176,11 @@ private:
     std::unique_ptr<sphere_geometry> sphere_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 512;
     constexpr auto window_height = 512;
 
@@ -193,6 +198,8 @@ int main()
 
     {
         demo d(window_width, window_height);
+        gl::antialiasing antialiasing(gl::antialiasing::multisample(parameters.get("samples", 4)), window_width,
+                                      window_height);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -205,7 +212,9 @@ int main()
 #else
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
+            antialiasing.begin_frame();
             d.render_and_step(dt);
+            antialiasing.end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
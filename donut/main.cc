@@ -4,6 +4,7 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -176,21 +177,22 @@ private:
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    Demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
     {
         initialize_shader();
 
-        static const std::array<glm::vec3, NumStrips> colors =
+        static const std::array<glm::vec3, 3> colors =
             // {glm::vec3(1, 0, 1), glm::vec3(1, 0, 1), glm::vec3(1, 0.5, 1)};
             {glm::vec3(0x45, 0x3f, 0x78), glm::vec3(0x75, 0x9a, 0xab), glm::vec3(0xfa, 0xf2, 0xa1)};
 
-        for (int i = 0; i < NumStrips; ++i)
+        const auto num_strips = parameters.get("strips", 3);
+        for (int i = 0; i < num_strips; ++i)
         {
             std::unique_ptr<Strip> strip(new Strip);
 
-            const float a = static_cast<float>(i) * 2.0f * M_PI / NumStrips;
+            const float a = static_cast<float>(i) * 2.0f * M_PI / num_strips;
             const auto coil_radius = 0.2f;
             strip->geometry.reset(new StripGeometry(a, coil_radius));
 
@@ -198,7 +200,7 @@ public:
             strip->speed = static_cast<float>(1) / CycleDuration / CircleVerts;
             strip->length = 0.75f;
             strip->color = // colors[i];
-                (1.f / 255) * colors[i]; // glm::vec3(frand(), frand(), frand()) * 0.5f + glm::vec3(0.5f);
+                (1.f / 255) * colors[i % colors.size()]; // glm::vec3(frand(), frand(), frand()) * 0.5f + glm::vec3(0.5f);
 
             strips_.push_back(std::move(strip));
         }
@@ -278,8 +280,6 @@ private:
         }
     }
 
-    static constexpr auto NumStrips = 3;
-
     static constexpr auto ShadowWidth = 2048;
     static constexpr auto ShadowHeight = ShadowWidth;
 
@@ -298,8 +298,11 @@ private:
     std::vector<std::unique_ptr<Strip>> strips_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
@@ -316,7 +319,7 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, parameters);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -0,0 +1,124 @@
+#include "matrix.h"
+#include "random.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+
+// times the 4x4 products of common/matrix.h against glm's operator* over
+// arrays of random affine matrices the size of the demos' instance counts,
+// and checks they agree. the ns column is per product, the best of the runs.
+
+namespace {
+
+std::vector<glm::mat4> random_affine(const gl::random_stream &random, std::size_t count)
+{
+    std::vector<glm::mat4> matrices(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto values = random.substream(i);
+        glm::mat4 m(1.0f);
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 3; ++row)
+                m[column][row] = values.uniform(column * 3 + row, -1.0f, 1.0f);
+        }
+        matrices[i] = m;
+    }
+    return matrices;
+}
+
+float max_difference(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b)
+{
+    float difference = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row)
+                difference = std::max(difference, std::abs(a[i][column][row] - b[i][column][row]));
+        }
+    }
+    return difference;
+}
+
+template<typename Multiply>
+double time_products(std::size_t count, int runs, Multiply multiply)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 0;
+    for (int i = 0; i < runs; ++i) {
+        const auto start = clock::now();
+        multiply();
+        const std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+        if (i == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best / count;
+}
+
+void bench_count(std::size_t count, int runs)
+{
+    const gl::random_stream random(0);
+    const auto a = random_affine(random.substream(0), count);
+    const auto b = random_affine(random.substream(1), count);
+    const auto model = a[0];
+
+    std::vector<glm::mat4> expected(count);
+    std::vector<glm::mat4> result(count);
+
+    const auto glm_ns = time_products(count, runs, [&] {
+        for (std::size_t i = 0; i < count; ++i)
+            expected[i] = a[i] * b[i];
+    });
+    const auto multiply_ns = time_products(count, runs, [&] {
+        for (std::size_t i = 0; i < count; ++i)
+            result[i] = gl::multiply(a[i], b[i]);
+    });
+    const auto multiply_error = max_difference(expected, result);
+    const auto affine_ns = time_products(count, runs, [&] {
+        for (std::size_t i = 0; i < count; ++i)
+            result[i] = gl::multiply_affine(a[i], b[i]);
+    });
+    const auto affine_error = max_difference(expected, result);
+    const auto many_ns = time_products(count, runs, [&] { gl::multiply_many(a.data(), b.data(), result.data(), count); });
+    const auto many_error = max_difference(expected, result);
+
+    const auto glm_shared_ns = time_products(count, runs, [&] {
+        for (std::size_t i = 0; i < count; ++i)
+            expected[i] = model * b[i];
+    });
+    const auto many_shared_ns = time_products(count, runs, [&] { gl::multiply_many(model, b.data(), result.data(), count); });
+    const auto many_shared_error = max_difference(expected, result);
+
+    std::printf("%8zu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %12g\n", count, glm_ns, multiply_ns, affine_ns,
+                many_ns, glm_shared_ns, many_shared_ns,
+                std::max({ multiply_error, affine_error, many_error, many_shared_error }));
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt)
+        {
+        case 'n':
+            runs = std::atoi(optarg);
+            break;
+        }
+    }
+
+    // "shared" multiplies one matrix by every matrix of the array, like a
+    // model matrix applied to the instances
+    std::printf("%8s %10s %10s %10s %10s %10s %10s %12s\n", "count", "glm ns", "multiply", "affine", "many",
+                "glm shared", "many shared", "max error");
+
+    for (std::size_t count : { 64, 625, 4096, 65536 })
+        bench_count(count, runs);
+}
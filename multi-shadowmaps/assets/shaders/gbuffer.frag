@@ -0,0 +1,16 @@
+#version 450 core
+
+vec2 encodeNormal(vec3 n);
+
+in vec3 vs_normal;
+in vec3 vs_position;
+in vec4 vs_color;
+
+layout(location=0) out vec2 gbuffer_normal;
+layout(location=1) out vec4 gbuffer_albedo;
+
+void main(void)
+{
+    gbuffer_normal = encodeNormal(normalize(vs_normal));
+    gbuffer_albedo = vs_color;
+}
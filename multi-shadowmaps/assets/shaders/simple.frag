@@ -1,12 +1,18 @@
 #version 450 core
 
+// CLUSTER_X, CLUSTER_Y, CLUSTER_Z and MAX_LIGHTS_PER_CLUSTER are defined by main.cc
+
 uniform sampler2DArrayShadow shadowMapTexture;
 uniform vec3 eyePosition;
-uniform int lightCount;
+uniform mat4 viewMatrix;
+uniform vec2 tileSize;
+uniform float zNear;
+uniform float zFar;
 
 struct Light
 {
-    vec4 position;
+    vec4 position; // w: radius
+    vec4 color; // w: shadow map layer, negative if unshadowed
     mat4 viewProjection;
 };
 
@@ -15,6 +21,11 @@ layout (std430, binding=0) buffer Lights
     Light lights[];
 };
 
+layout (std430, binding=1) buffer Clusters
+{
+    uint clusterData[];
+};
+
 in vec3 vs_normal;
 in vec3 vs_position;
 in vec4 vs_color;
@@ -23,6 +34,21 @@ const vec3 ambient = vec3(0.05);
 
 out vec4 frag_color;
 
+uint clusterIndex()
+{
+    float viewZ = -(viewMatrix * vec4(vs_position, 1.0)).z;
+    int slice = clamp(int(log(viewZ / zNear) / log(zFar / zNear) * CLUSTER_Z), 0, CLUSTER_Z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / tileSize), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    return uint(tile.x + CLUSTER_X * (tile.y + CLUSTER_Y * slice));
+}
+
+float attenuation(float lightDistance, float radius)
+{
+    float x = lightDistance / radius;
+    float w = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return w * w;
+}
+
 vec3 lightModel()
 {
     const mat4 shadowMatrix = mat4(0.5, 0.0, 0.0, 0.0,
@@ -30,21 +56,33 @@ vec3 lightModel()
                                    0.0, 0.0, 0.5, 0.0,
                                    0.5, 0.5, 0.5, 1.0);
 
-    float lightIntensity = 0.0;
+    vec3 lightColor = vec3(0.0);
+
+    uint base = clusterIndex() * (MAX_LIGHTS_PER_CLUSTER + 1);
+    uint count = clusterData[base];
 
-    for (int i = 0; i < lightCount; ++i)
+    for (uint i = 0; i < count; ++i)
     {
-        float intensity = (1.0 / float(lightCount)) * max(dot(vs_normal, normalize(lights[i].position.xyz - vs_position)), 0.0);
+        Light light = lights[clusterData[base + 1 + i]];
+
+        vec3 toLight = light.position.xyz - vs_position;
+        float lightDistance = length(toLight);
+        float intensity = attenuation(lightDistance, light.position.w) * max(dot(vs_normal, toLight / lightDistance), 0.0);
+        if (intensity <= 0.0)
+            continue;
 
         // shadow
-        vec4 positionInLightSpace = shadowMatrix * lights[i].viewProjection * vec4(vs_position, 1.0);
-        vec3 projCoords = positionInLightSpace.xyz / positionInLightSpace.w;
-        vec4 textureIndex = vec4(projCoords.xy, float(i), projCoords.z);
-        float shadowFactor = texture(shadowMapTexture, textureIndex);
+        if (light.color.w >= 0.0)
+        {
+            vec4 positionInLightSpace = shadowMatrix * light.viewProjection * vec4(vs_position, 1.0);
+            vec3 projCoords = positionInLightSpace.xyz / positionInLightSpace.w;
+            vec4 textureIndex = vec4(projCoords.xy, light.color.w, projCoords.z);
+            intensity *= texture(shadowMapTexture, textureIndex);
+        }
 
-        lightIntensity += shadowFactor * intensity;
+        lightColor += intensity * light.color.rgb;
     }
-    return ambient + lightIntensity * vs_color.xyz;
+    return ambient + lightColor * vs_color.xyz;
 }
 
 void main(void)
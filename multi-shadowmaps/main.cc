@@ -4,9 +4,14 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
 #include "buffer.h"
 #include "multi_shadow_buffer.h"
 #include "tween.h"
+#include "gpu_timer.h"
+#include "deferred_shading.h"
+#include "benchmark.h"
+#include "random.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -23,8 +28,9 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
-#include <random>
 #include <fstream>
+#include <cstdint>
+#include <cstdio>
 
 // #define DUMP_FRAMES
 
@@ -147,37 +153,128 @@ private:
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    Demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
         , mesh_(new Mesh("assets/meshes/monkey.obj"))
         , plane_(new Plane(glm::vec3(0, 0, -2), glm::vec3(3, 0, 0), glm::vec3(0, 4, 0)))
     {
-        initialize_lights();
+        // -p lights=256 -p timings=1 compares the clustered forward path
+        // against -p deferred=1 over light counts, -p width and -p height
+        // over resolutions
+        initialize_lights(parameters.get("lights", 0), parameters.get("seed", 0));
+        if (parameters.get("deferred", 0) != 0)
+            deferred_.reset(new gl::deferred_shading(framebuffer_pool_, window_width_, window_height_));
+        report_timings_ = parameters.get("timings", 0) != 0;
         initialize_shader();
     }
 
     void render_and_step(float dt)
     {
+        framebuffer_pool_.begin_frame();
+        update_lights();
         render();
         cur_time_ += dt;
+        if (report_timings_)
+            report_timings();
     }
 
+    // GPU time of the passes of the frame just rendered, waits for it
+    std::vector<gl::frame_graph::pass_timing> timings() const
+    {
+        if (deferred_)
+            return { { "deferred shading", shading_timer_.elapsed_ms() } };
+        return { { "clustering", cluster_timer_.elapsed_ms() }, { "shading", shading_timer_.elapsed_ms() } };
+    }
+
+    const gl::framebuffer_pool::stats &framebuffer_stats() const { return framebuffer_pool_.frame_stats(); }
+
 private:
-    void initialize_lights()
+    void initialize_lights(int point_light_count, int seed)
     {
+        // shadowed lights, their radius covers the whole scene
         lights_.emplace_back(glm::vec3(-4, 4, 7));
         lights_.emplace_back(glm::vec3(5, -5, 9));
         lights_.emplace_back(glm::vec3(3, 3, 6));
         lights_.emplace_back(glm::vec3(-3, -2, 8));
 
         shadow_buffer_.reset(new gl::multi_shadow_buffer(ShadowWidth, ShadowHeight, lights_.size()));
+
+        // unshadowed point lights hovering over the plane, a substream each
+        const gl::random_stream random(seed);
+        for (int i = 0; i < point_light_count; ++i) {
+            const auto light_random = random.substream(i);
+            PointLight light;
+            light.center = glm::vec3(light_random.uniform(0, -3.0f, 3.0f), light_random.uniform(1, -4.0f, 4.0f),
+                                     light_random.uniform(2, -1.8f, 1.2f));
+            light.color = 0.5f * glm::vec3(light_random.uniform(3), light_random.uniform(4), light_random.uniform(5));
+            light.phase = light_random.uniform(6, 0.0f, 2.0f * M_PI);
+            point_lights_.push_back(light);
+        }
+
+        const auto light_count = lights_.size() + point_lights_.size();
+        light_buffer_.reset(new gl::buffer<BufferLight>(GL_SHADER_STORAGE_BUFFER, light_count));
+        cluster_buffer_.reset(
+                new gl::buffer<GLuint>(GL_SHADER_STORAGE_BUFFER, ClusterCount * (MaxLightsPerCluster + 1) + 1));
+    }
+
+    void update_lights()
+    {
         std::vector<BufferLight> buffer;
-        buffer.reserve(lights_.size());
-        std::transform(lights_.begin(), lights_.end(), std::back_inserter(buffer), [](const Light &light) {
-            return BufferLight{ glm::vec4(light.position, 1.0), light.projection * light.view };
-        });
-        light_buffer_.reset(new gl::buffer<BufferLight>(GL_SHADER_STORAGE_BUFFER, buffer.data(), buffer.size()));
+        buffer.reserve(lights_.size() + point_lights_.size());
+        for (size_t i = 0; i < lights_.size(); ++i) {
+            const auto &light = lights_[i];
+            buffer.push_back(BufferLight{ glm::vec4(light.position, ShadowLightRadius),
+                                          glm::vec4(glm::vec3(1.0f / lights_.size()), static_cast<float>(i)),
+                                          light.projection * light.view });
+        }
+        for (const auto &light : point_lights_) {
+            const auto angle = 2.0f * cur_time_ + light.phase;
+            const auto position = light.center + 0.5f * glm::vec3(cosf(angle), sinf(angle), 0);
+            buffer.push_back(BufferLight{ glm::vec4(position, PointLightRadius), glm::vec4(light.color, -1),
+                                          glm::mat4(1.0) });
+        }
+        light_buffer_->set_sub_data(0, buffer.data(), buffer.size());
+
+        if (deferred_) {
+            deferred_lights_.clear();
+            for (const auto &light : buffer) {
+                const auto shadow_layer = static_cast<int>(light.color.w);
+                deferred_lights_.push_back({ glm::vec3(light.position), light.position.w, glm::vec3(light.color),
+                                             shadow_layer, light.viewProjection });
+            }
+        }
+    }
+
+    void report_timings()
+    {
+        // timings() already waited for the frame, so this doesn't stall
+        if (!deferred_) {
+            GLuint dropped;
+            cluster_buffer_->get_sub_data(DroppedLightsIndex, &dropped, 1);
+            dropped_lights_ += dropped;
+        }
+
+        for (const auto &timing : timings()) {
+            auto it = std::find_if(timing_totals_.begin(), timing_totals_.end(),
+                                   [&timing](const auto &total) { return total.name == timing.name; });
+            if (it == timing_totals_.end())
+                it = timing_totals_.insert(timing_totals_.end(), { timing.name, 0.0 });
+            it->gpu_ms += timing.gpu_ms;
+        }
+        if (++timed_frames_ == FramesPerSecond) {
+            std::printf("%d lights, %dx%d:", static_cast<int>(lights_.size() + point_lights_.size()), window_width_,
+                        window_height_);
+            for (const auto &total : timing_totals_)
+                std::printf(" %s %.3f ms", total.name.c_str(), total.gpu_ms / timed_frames_);
+            if (dropped_lights_ > 0)
+                std::printf(" (%.1f light/cluster pairs dropped per frame, clusters hold %d lights)",
+                            static_cast<double>(dropped_lights_) / timed_frames_, MaxLightsPerCluster);
+            std::printf("\n");
+            timing_totals_.clear();
+            timed_frames_ = 0;
+            dropped_lights_ = 0;
+        }
     }
 
     void initialize_shader()
@@ -186,15 +283,29 @@ private:
         shadow_program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/shadow.frag");
         shadow_program_.link();
 
+        char defines[128];
+        std::snprintf(defines, sizeof(defines),
+                      "#define CLUSTER_X %d\n#define CLUSTER_Y %d\n#define CLUSTER_Z %d\n"
+                      "#define MAX_LIGHTS_PER_CLUSTER %d\n",
+                      ClusterX, ClusterY, ClusterZ, MaxLightsPerCluster);
+
         program_.add_shader(GL_VERTEX_SHADER, "assets/shaders/simple.vert");
-        program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/simple.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/simple.frag", defines);
         program_.link();
+
+        cluster_program_.add_shader(GL_COMPUTE_SHADER, "assets/shaders/cluster.comp", defines);
+        cluster_program_.link();
+
+        if (deferred_) {
+            gbuffer_program_.add_shader(GL_VERTEX_SHADER, "assets/shaders/simple.vert");
+            gbuffer_program_.add_shader(GL_FRAGMENT_SHADER, "assets/shaders/gbuffer.frag");
+            gl::deferred_shading::attach_normal_encoding(gbuffer_program_);
+            gbuffer_program_.link();
+        }
     }
 
     void render() const
     {
-        const auto light_position = glm::vec3(-4, 4, 5); // glm::vec3(-2 * cosf(cur_time_), -2 * sinf(cur_time_), 5);
-
         const auto model = glm::mat4(1.0);
         const auto monkey_model = glm::rotate(glm::mat4(1.0), cur_time_, glm::vec3(0, 1, 0));
 
@@ -240,11 +351,57 @@ private:
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, ZNear, ZFar);
         // const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
         const auto view_pos = glm::vec3(2, 2, 7);
         const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
+        if (deferred_) {
+            shading_timer_.begin();
+
+            deferred_->bind_gbuffer();
+
+            gbuffer_program_.bind();
+            gbuffer_program_.set_uniform("viewMatrix", view);
+            gbuffer_program_.set_uniform("projectionMatrix", projection);
+
+            gbuffer_program_.set_uniform("modelMatrix", model);
+            plane_->render();
+
+            gbuffer_program_.set_uniform("modelMatrix", model * monkey_model);
+            mesh_->render();
+
+            gl::framebuffer::unbind();
+            deferred_->render(deferred_lights_, projection * view, shadow_buffer_->texture_handle());
+
+            shading_timer_.end();
+            return;
+        }
+
+        const auto light_count = static_cast<int>(lights_.size() + point_lights_.size());
+
+        // assign lights to clusters
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_buffer_->handle());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cluster_buffer_->handle());
+
+        const GLuint no_lights_dropped = 0;
+        cluster_buffer_->set_sub_data(DroppedLightsIndex, &no_lights_dropped, 1);
+
+        cluster_timer_.begin();
+        cluster_program_.bind();
+        cluster_program_.set_uniform("viewMatrix", view);
+        cluster_program_.set_uniform("inverseProjection", glm::inverse(projection));
+        cluster_program_.set_uniform("zNear", ZNear);
+        cluster_program_.set_uniform("zFar", ZFar);
+        cluster_program_.set_uniform("lightCount", light_count);
+        glDispatchCompute(1, 1, ClusterZ);
+        cluster_timer_.end();
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        shading_timer_.begin();
+
         shadow_buffer_->bind_texture();
 
         program_.bind();
@@ -252,25 +409,44 @@ private:
         program_.set_uniform("viewMatrix", view);
         program_.set_uniform("projectionMatrix", projection);
         program_.set_uniform("eyePosition", view_pos);
-        program_.set_uniform("lightPosition", light_position);
-        program_.set_uniform("lightCount", static_cast<int>(lights_.size()));
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_buffer_->handle());
+        program_.set_uniform("tileSize", glm::vec2(static_cast<float>(window_width_) / ClusterX,
+                                                    static_cast<float>(window_height_) / ClusterY));
+        program_.set_uniform("zNear", ZNear);
+        program_.set_uniform("zFar", ZFar);
 
         program_.set_uniform("modelMatrix", model);
         plane_->render();
 
         program_.set_uniform("modelMatrix", model * monkey_model);
         mesh_->render();
+
+        shading_timer_.end();
     }
 
     static constexpr auto ShadowWidth = 2048;
     static constexpr auto ShadowHeight = ShadowWidth;
 
+    static constexpr auto ZNear = 0.1f;
+    static constexpr auto ZFar = 100.0f;
+
+    // froxel grid, passed to the shaders as defines. lights past
+    // MaxLightsPerCluster are dropped, -p timings=1 reports how many
+    static constexpr auto ClusterX = 16;
+    static constexpr auto ClusterY = 16;
+    static constexpr auto ClusterZ = 24;
+    static constexpr auto ClusterCount = ClusterX * ClusterY * ClusterZ;
+    static constexpr auto MaxLightsPerCluster = 128;
+    static constexpr auto DroppedLightsIndex = ClusterCount * (MaxLightsPerCluster + 1);
+
+    static constexpr auto ShadowLightRadius = 50.0f;
+    static constexpr auto PointLightRadius = 1.0f;
+
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
+    gl::shader_program cluster_program_;
     std::unique_ptr<Mesh> mesh_;
     std::unique_ptr<Plane> plane_;
     std::unique_ptr<gl::multi_shadow_buffer> shadow_buffer_;
@@ -287,20 +463,45 @@ private:
         }
     };
     std::vector<Light> lights_;
+    struct PointLight
+    {
+        glm::vec3 center;
+        glm::vec3 color;
+        float phase;
+    };
+    std::vector<PointLight> point_lights_;
     struct BufferLight
     {
-        glm::vec4 position;
+        glm::vec4 position; // w: radius
+        glm::vec4 color; // w: shadow map layer, negative if unshadowed
         glm::mat4 viewProjection;
     };
     std::unique_ptr<gl::buffer<BufferLight>> light_buffer_;
+    std::unique_ptr<gl::buffer<GLuint>> cluster_buffer_;
+    gl::framebuffer_pool framebuffer_pool_;
+    gl::shader_program gbuffer_program_;
+    std::unique_ptr<gl::deferred_shading> deferred_; // null for clustered forward shading
+    std::vector<gl::deferred_shading::light> deferred_lights_;
+    gl::gpu_timer cluster_timer_;
+    gl::gpu_timer shading_timer_;
+    bool report_timings_ = false;
+    std::vector<gl::frame_graph::pass_timing> timing_totals_;
+    int timed_frames_ = 0;
+    std::uint64_t dropped_lights_ = 0;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
-    constexpr auto window_width = 800;
-    constexpr auto window_height = 800;
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
 
-    gl::window w(window_width, window_height, "demo");
+    const int window_width = parameters.get("width", 800);
+    const int window_height = parameters.get("height", 800);
+
+    // -p benchmark=N renders N frames headless for bench-sweep
+    const int benchmark_frames = parameters.get("benchmark", 0);
+
+    gl::window w(window_width, window_height, "demo", benchmark_frames == 0);
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -313,7 +514,11 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, parameters);
+
+        std::unique_ptr<gl::benchmark> benchmark;
+        if (benchmark_frames > 0)
+            benchmark.reset(new gl::benchmark(benchmark_frames));
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -321,11 +526,14 @@ int main()
         while (!glfwWindowShouldClose(w)) {
 #ifndef DUMP_FRAMES
             auto now = glfwGetTime();
-            const auto dt = now - curTime;
+            const auto dt = benchmark ? 1.0f / FramesPerSecond : now - curTime;
             curTime = now;
 #else
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
+            if (benchmark)
+                benchmark->begin_frame();
+
             d.render_and_step(dt);
 
 #ifdef DUMP_FRAMES
@@ -339,6 +547,16 @@ int main()
 
             glfwSwapBuffers(w);
             glfwPollEvents();
+
+            if (benchmark) {
+                benchmark->end_frame();
+                benchmark->add_pass_timings(d.timings());
+                benchmark->add_memory(d.framebuffer_stats());
+                if (benchmark->done()) {
+                    benchmark->report();
+                    break;
+                }
+            }
         }
     }
 }
@@ -15,9 +15,15 @@ layout(std430, binding=0) buffer Transforms
     State states[];
 };
 
+layout(std430, binding=1) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+};
+
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform bool culledInstances; // instances come from visibleInstances
 
 out vec3 vs_position;
 out vec3 vs_normal;
@@ -25,9 +31,11 @@ out vec4 vs_color;
 
 void main(void)
 {
-    mat4 instanceModelMatrix = modelMatrix * states[gl_InstanceID].transform;
+    uint instance = culledInstances ? visibleInstances[gl_InstanceID] : uint(gl_InstanceID);
+
+    mat4 instanceModelMatrix = modelMatrix * states[instance].transform;
     vs_position = vec3(instanceModelMatrix * vec4(position, 1.0));
     vs_normal = normalize(mat3(instanceModelMatrix) * normal); // not quite correct
-    vs_color = states[gl_InstanceID].color;
+    vs_color = states[instance].color;
     gl_Position = projectionMatrix * viewMatrix * instanceModelMatrix * vec4(position, 1.0);
 }
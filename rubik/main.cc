@@ -4,9 +4,16 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
+#include "antialiasing.h"
+#include "benchmark.h"
 #include "buffer.h"
+#include "occlusion_culler.h"
+#include "frustum_culler.h"
 
 #include "tween.h"
+#include "random.h"
+#include "matrix.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -23,7 +30,6 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
-#include <random>
 #include <fstream>
 
 // #define DUMP_FRAMES
@@ -50,6 +56,9 @@ public:
         glDrawArraysInstanced(GL_TRIANGLES, 0, verts_.size(), instance_count);
     }
 
+    void bind() const { geometry_.bind(); }
+    int vertex_count() const { return verts_.size(); }
+
 private:
     void initialize_geometry(const char *file)
     {
@@ -113,37 +122,78 @@ private:
 class demo
 {
 public:
-    demo(int window_width, int window_height)
+    demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
-        , states_(GL_SHADER_STORAGE_BUFFER, GridSize * GridSize * GridSize)
+        , grid_size_(parameters.get("grid", 3))
+        , cell_size_(1.f / grid_size_)
+        , random_(parameters.get("seed", 0))
+        , states_(GL_SHADER_STORAGE_BUFFER, grid_size_ * grid_size_ * grid_size_)
         , cube_(new mesh("assets/meshes/beveled-cube.obj"))
     {
         initialize_shader();
 
-        std::random_device device;
-        std::mt19937 generator(device());
-        std::uniform_real_distribution<float> distribution(0.5, 1.5);
-
-        collapse_start_.resize(GridSize * GridSize * GridSize);
-        std::generate(collapse_start_.begin(), collapse_start_.end(), [&distribution, &generator] {
-            return distribution(generator);
-        });
+        collapse_start_.resize(grid_size_ * grid_size_ * grid_size_);
+        for (std::size_t i = 0; i < collapse_start_.size(); ++i)
+            collapse_start_[i] = random_.uniform(i, 0.5f, 1.5f);
+
+        // -p culling=frustum culls the instances against the view frustum,
+        // -p culling=hiz against the previous frame's depth pyramid too.
+        // both print how many are visible every second
+        const auto culling = parameters.get("culling", "none");
+        if (culling == "frustum")
+            frustum_culler_.reset(new gl::frustum_culler(grid_size_ * grid_size_ * grid_size_, 1));
+        else if (culling == "hiz")
+            occlusion_culler_.reset(
+                    new gl::occlusion_culler(window_width_, window_height_, grid_size_ * grid_size_ * grid_size_));
+        else if (culling != "none")
+            panic("unknown culling %s, expected none, frustum or hiz\n", culling.c_str());
+        if (occlusion_culler_ || frustum_culler_)
+            bounds_.resize(grid_size_ * grid_size_ * grid_size_);
     }
 
     void render_and_step(float dt)
     {
         render(program_);
+        if (++frame_count_ % FramesPerSecond == 0) {
+            if (occlusion_culler_)
+                std::printf("%d of %d instances visible\n", occlusion_culler_->visible_count(),
+                            occlusion_culler_->instance_count());
+            else if (frustum_culler_)
+                std::printf("%d of %d instances visible\n", frustum_culler_->visible_count(0),
+                            frustum_culler_->instance_count());
+        }
         cur_time_ += dt;
         if (cur_time_ >= MotionDuration) {
             flip_ = !flip_;
-            moving_ = rand() % ((1 << GridSize) - 1);
-            moving_direction_ = rand() % ((1 << GridSize) - 1);
+            moving_ = random_slices(random_.substream(2 * move_ + 1));
+            moving_direction_ = random_slices(random_.substream(2 * move_ + 2));
+            ++move_;
             cur_time_ -= MotionDuration;
         }
     }
 
 private:
+    // random subset of the slices, never all of them
+    std::vector<bool> first_slice() const
+    {
+        std::vector<bool> slices(grid_size_);
+        slices[0] = true;
+        return slices;
+    }
+
+    std::vector<bool> random_slices(const gl::random_stream &random) const
+    {
+        std::vector<bool> slices(grid_size_);
+        int attempt = 0;
+        do {
+            for (int i = 0; i < grid_size_; ++i)
+                slices[i] = random.below(attempt * grid_size_ + i, 2);
+            ++attempt;
+        } while (std::all_of(slices.begin(), slices.end(), [](bool slice) { return slice; }));
+        return slices;
+    }
+
     void initialize_shader()
     {
         program_.add_shader(GL_VERTEX_SHADER, "assets/shaders/sphere.vert");
@@ -151,7 +201,7 @@ private:
         program_.link();
     }
 
-    void render(const gl::shader_program &program) const
+    void render(const gl::shader_program &program)
     {
         update_grid_state();
 
@@ -177,6 +227,14 @@ private:
 
         const auto model = flip_ ? glm::rotate(glm::mat4(1.0f), static_cast<float>(0.5 * M_PI), glm::vec3(0, 1, 0)) : glm::mat4(1.0);
 
+        if (occlusion_culler_) {
+            occlusion_culler_->set_bounds(bounds_);
+            occlusion_culler_->cull(projection * view * model, cube_->vertex_count());
+        } else if (frustum_culler_) {
+            frustum_culler_->set_bounds(bounds_);
+            frustum_culler_->cull({ projection * view * model }, cube_->vertex_count());
+        }
+
         program.bind();
         program.set_uniform(program.uniform_location("modelMatrix"), model);
         program.set_uniform(program.uniform_location("viewMatrix"), view);
@@ -185,44 +243,61 @@ private:
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, states_.handle());
 
         glCullFace(GL_BACK);
-        cube_->render(GridSize * GridSize * GridSize);
+        if (occlusion_culler_) {
+            program.set_uniform(program.uniform_location("culledInstances"), 1);
+            cube_->bind();
+            occlusion_culler_->draw(1);
+
+            occlusion_culler_->build_depth_pyramid();
+        } else if (frustum_culler_) {
+            program.set_uniform(program.uniform_location("culledInstances"), 1);
+            cube_->bind();
+            frustum_culler_->draw(0, 1);
+        } else {
+            program.set_uniform(program.uniform_location("culledInstances"), 0);
+            cube_->render(grid_size_ * grid_size_ * grid_size_);
+        }
     }
 
-    void update_grid_state() const
+    void update_grid_state()
     {
         const auto motion_time = fmod(cur_time_, MotionDuration) / MotionDuration;
 
-        constexpr const auto CenterEntity = (GridSize / 2) * GridSize * GridSize + (GridSize / 2) * GridSize + (GridSize / 2);
+        const auto center_entity = (grid_size_ / 2) * grid_size_ * grid_size_ + (grid_size_ / 2) * grid_size_ + (grid_size_ / 2);
 
         auto *state = states_.map();
 
-        for (int i = 0; i < GridSize; ++i) {
+        for (int i = 0; i < grid_size_; ++i) {
             float slice_rotation;
-            if ((moving_ & (1 << i)) == 0) {
+            if (!moving_[i]) {
                 slice_rotation = 0;
             } else {
                 slice_rotation = in_quadratic(motion_time) * 0.5f * M_PI;
-                if (moving_direction_ & (1 << i))
+                if (moving_direction_[i])
                     slice_rotation = -slice_rotation;
             }
-            const auto v = (glm::vec3(i, 0, 0) - 0.5f * glm::vec3(GridSize - 1, 0, 0)) * CellSize;
+            const auto v = (glm::vec3(i, 0, 0) - 0.5f * glm::vec3(grid_size_ - 1, 0, 0)) * cell_size_;
             const auto slice_translate_matrix = glm::translate(glm::mat4(1.0), v);
             const auto slice_rotation_matrix = glm::rotate(glm::mat4(1.0), slice_rotation, glm::vec3(1, 0, 0));
-            const auto slice_transform = slice_translate_matrix * slice_rotation_matrix;
+            const auto slice_transform = gl::multiply_affine(slice_translate_matrix, slice_rotation_matrix);
 
-            for (int j = 0; j < GridSize; ++j) {
-                for (int k = 0; k < GridSize; ++k) {
-                    const auto index = i * GridSize * GridSize + j * GridSize + k;
+            for (int j = 0; j < grid_size_; ++j) {
+                for (int k = 0; k < grid_size_; ++k) {
+                    const auto index = i * grid_size_ * grid_size_ + j * grid_size_ + k;
 
-                    const auto v = (glm::vec3(0, j, k) - 0.5f * glm::vec3(0, GridSize - 1, GridSize - 1)) * CellSize;
+                    const auto v = (glm::vec3(0, j, k) - 0.5f * glm::vec3(0, grid_size_ - 1, grid_size_ - 1)) * cell_size_;
                     const auto translate_matrix = glm::translate(glm::mat4(1.0), v);
-                    const auto scale_matrix = glm::scale(glm::mat4(1.0), glm::vec3(0.95 * 0.5 * CellSize));
+                    const auto scale_matrix = glm::scale(glm::mat4(1.0), glm::vec3(0.95 * 0.5 * cell_size_));
 
                     const auto diffuse_color = glm::vec3(1.0, 1.0, 1.0);
 
-                    state->transform = slice_transform * translate_matrix * scale_matrix;
+                    state->transform =
+                            gl::multiply_affine(slice_transform, gl::multiply_affine(translate_matrix, scale_matrix));
                     state->color = glm::vec4(diffuse_color, 1.0);
                     ++state;
+                    if (!bounds_.empty())
+                        bounds_[index] = glm::vec4(glm::vec3(slice_transform * glm::vec4(v, 1.0f)),
+                                                   std::sqrt(3.0f) * 0.95f * 0.5f * cell_size_);
                 }
             }
         }
@@ -230,8 +305,6 @@ private:
         states_.unmap();
     }
 
-    static constexpr auto GridSize = 3;
-    static constexpr auto CellSize = 1.f / GridSize;
     static constexpr auto MotionDuration = 0.25f;
 
     struct entity_state {
@@ -240,23 +313,35 @@ private:
     };
     int window_width_;
     int window_height_;
+    int grid_size_;
+    float cell_size_;
+    gl::random_stream random_; // the collapse times, and two substreams per move
+    int move_ = 0;
     float cur_time_ = 0;
     gl::shader_program program_;
     static_assert(sizeof(glm::mat4) == 16 * sizeof(float));
     gl::buffer<entity_state> states_;
     std::unique_ptr<mesh> cube_;
     std::vector<float> collapse_start_;
-    unsigned moving_ = 1;
-    unsigned moving_direction_ = 1;
+    std::vector<bool> moving_ = first_slice();
+    std::vector<bool> moving_direction_ = first_slice();
     bool flip_ = false;
+    std::unique_ptr<gl::occlusion_culler> occlusion_culler_;
+    std::unique_ptr<gl::frustum_culler> frustum_culler_;
+    std::vector<glm::vec4> bounds_; // empty without culling
+    int frame_count_ = 0;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
-    gl::window w(window_width, window_height, "demo");
+    const auto benchmark_frames = parameters.get("benchmark", 0);
+    gl::window w(window_width, window_height, "demo", benchmark_frames == 0);
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -269,7 +354,13 @@ int main()
 #endif
 
     {
-        demo d(window_width, window_height);
+        demo d(window_width, window_height, parameters);
+        gl::antialiasing antialiasing(gl::antialiasing::multisample(parameters.get("samples", 4)), window_width,
+                                      window_height);
+
+        std::unique_ptr<gl::benchmark> benchmark;
+        if (benchmark_frames > 0)
+            benchmark.reset(new gl::benchmark(benchmark_frames));
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -277,12 +368,17 @@ int main()
         while (!glfwWindowShouldClose(w)) {
 #ifndef DUMP_FRAMES
             auto now = glfwGetTime();
-            const auto dt = now - curTime;
+            const auto dt = benchmark ? 1.0 / FramesPerSecond : now - curTime;
             curTime = now;
 #else
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
+            if (benchmark)
+                benchmark->begin_frame();
+
+            antialiasing.begin_frame();
             d.render_and_step(dt);
+            antialiasing.end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -295,6 +391,14 @@ int main()
 
             glfwSwapBuffers(w);
             glfwPollEvents();
+
+            if (benchmark) {
+                benchmark->end_frame();
+                if (benchmark->done()) {
+                    benchmark->report();
+                    break;
+                }
+            }
         }
     }
 }
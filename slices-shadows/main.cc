@@ -1,11 +1,15 @@
 #include "panic.h"
 
-#include "window.h"
+#include "demo.h"
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "random.h"
 #include "tween.h"
 #include "shadow_buffer.h"
+#include "draw_list.h"
+#include "software_rasterizer.h"
+#include "software_target.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -16,38 +20,36 @@
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <memory>
-
-// #define DUMP_FRAMES
+#include <memory_resource>
 
 constexpr const auto CycleDuration = 3.f;
 
 constexpr const auto ExplodeDuration = 0.25f;
 constexpr const auto ImplodeDuration = 0.125f;
 
-#ifdef DUMP_FRAMES
-constexpr const auto FramesPerSecond = 40;
-#else
-constexpr const auto FramesPerSecond = 60;
-#endif
-
+// meshes only live while a tree is built, in the frame arena. verts keep
+// the resource they were created with: move them, or copy them with an
+// explicit resource, a plain copy goes to the heap
 struct Polygon {
     glm::vec3 normal;
     glm::vec3 color;
-    std::vector<glm::vec3> verts;
+    std::pmr::vector<glm::vec3> verts;
 };
 
-using Mesh = std::vector<Polygon>;
+using Mesh = std::pmr::vector<Polygon>;
 
 struct Plane {
     glm::vec3 point;
     glm::vec3 normal;
 };
 
-auto split(const std::vector<glm::vec3> &verts, const Plane &plane)
+auto split(const std::pmr::vector<glm::vec3> &verts, const Plane &plane)
 {
-    std::vector<glm::vec3> front_verts, back_verts;
+    auto *memory = verts.get_allocator().resource();
+    std::pmr::vector<glm::vec3> front_verts(memory), back_verts(memory);
 
     for (int i = 0; i < verts.size(); ++i) {
         const auto is_behind = [&plane](const glm::vec3 &v) {
@@ -73,20 +75,21 @@ auto split(const std::vector<glm::vec3> &verts, const Plane &plane)
         }
     }
 
-    return std::make_tuple(front_verts, back_verts);
+    return std::make_tuple(std::move(front_verts), std::move(back_verts));
 }
 
 auto split(const Mesh &mesh, const Plane &plane)
 {
-    Mesh front_mesh, back_mesh;
+    auto *memory = mesh.get_allocator().resource();
+    Mesh front_mesh(memory), back_mesh(memory);
 
     for (const auto &poly : mesh) {
-        const auto [front_verts, back_verts] = split(poly.verts, plane);
+        auto [front_verts, back_verts] = split(poly.verts, plane);
         if (!front_verts.empty()) {
-            front_mesh.push_back({ poly.normal, poly.color, front_verts });
+            front_mesh.push_back({ poly.normal, poly.color, std::move(front_verts) });
         }
         if (!back_verts.empty()) {
-            back_mesh.push_back({ poly.normal, poly.color, back_verts });
+            back_mesh.push_back({ poly.normal, poly.color, std::move(back_verts) });
         }
     }
 
@@ -96,28 +99,40 @@ auto split(const Mesh &mesh, const Plane &plane)
         up = glm::cross(right, plane.normal);
 
         constexpr const auto PlaneSize = 10.0f;
-        std::vector<glm::vec3> plane_verts;
+        std::pmr::vector<glm::vec3> plane_verts(memory);
         plane_verts.push_back(plane.point + PlaneSize * (-up -right));
         plane_verts.push_back(plane.point + PlaneSize * (-up + right));
         plane_verts.push_back(plane.point + PlaneSize * (up + right));
         plane_verts.push_back(plane.point + PlaneSize * (up - right));
 
         for (const auto &poly : mesh) {
-            const auto [front_verts, back_verts] = split(plane_verts, Plane{poly.verts[0], poly.normal});
-            plane_verts = front_verts;
+            auto [front_verts, back_verts] = split(plane_verts, Plane{poly.verts[0], poly.normal});
+            plane_verts = std::move(front_verts);
             assert(!plane_verts.empty());
         }
 
         const auto InnerColor = glm::vec3(1, 1, 0);
-        front_mesh.push_back({ plane.normal, InnerColor, plane_verts });
-        back_mesh.push_back({ -plane.normal, InnerColor, plane_verts });
+        front_mesh.push_back({ plane.normal, InnerColor, std::pmr::vector<glm::vec3>(plane_verts, memory) });
+        back_mesh.push_back({ -plane.normal, InnerColor, std::move(plane_verts) });
     }
 
-    return std::make_tuple(front_mesh, back_mesh);
+    return std::make_tuple(std::move(front_mesh), std::move(back_mesh));
 }
 
 using Vertex = std::tuple<glm::vec3, glm::vec3, glm::vec3>; // position / normal / color
 
+using SoftwareVertex = gl::software_rasterizer::vertex;
+
+// the same vertices for -p software=1
+std::vector<SoftwareVertex> to_software_verts(const std::vector<Vertex> &verts)
+{
+    std::vector<SoftwareVertex> result;
+    result.reserve(verts.size());
+    for (const auto &[position, normal, color] : verts)
+        result.push_back({ position, normal, color });
+    return result;
+}
+
 class PlaneGeometry
 {
 public:
@@ -125,13 +140,12 @@ public:
     {
         initialize_geometry(center, up, side);
         geometry_.set_data(verts_);
+        software_verts_ = to_software_verts(verts_);
     }
 
-    void render() const
-    {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
-    }
+    GLuint vertex_array() const { return geometry_.vertex_array_handle(); }
+    int vertex_count() const { return verts_.size(); }
+    const std::vector<SoftwareVertex> &software_verts() const { return software_verts_; }
 
 private:
     void initialize_geometry(const glm::vec3 &center, const glm::vec3 &up, const glm::vec3 &side)
@@ -149,6 +163,7 @@ private:
     }
 
     std::vector<Vertex> verts_;
+    std::vector<SoftwareVertex> software_verts_;
     gl::geometry geometry_;
 };
 
@@ -159,13 +174,12 @@ public:
     {
         initialize_geometry(m);
         geometry_.set_data(verts_);
+        software_verts_ = to_software_verts(verts_);
     }
 
-    void render() const
-    {
-        geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, verts_.size());
-    }
+    GLuint vertex_array() const { return geometry_.vertex_array_handle(); }
+    int vertex_count() const { return verts_.size(); }
+    const std::vector<SoftwareVertex> &software_verts() const { return software_verts_; }
 
 private:
     void initialize_geometry(const Mesh &mesh)
@@ -184,16 +198,18 @@ private:
     }
 
     std::vector<Vertex> verts_;
+    std::vector<SoftwareVertex> software_verts_;
     gl::geometry geometry_;
 };
 
-static Mesh make_cube()
+static Mesh make_cube(std::pmr::memory_resource *memory)
 {
-    const auto make_face = [](const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, const glm::vec3 &v3) {
+    const auto make_face = [memory](const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2,
+                                    const glm::vec3 &v3) {
         const auto u = v1 - v0;
         const auto v = v3 - v0;
         const auto n = glm::normalize(glm::cross(u, v));
-        return Polygon{ n, glm::vec3(1.0), { v0, v1, v2, v3 } };
+        return Polygon{ n, glm::vec3(1.0), std::pmr::vector<glm::vec3>({ v0, v1, v2, v3 }, memory) };
     };
 
     const glm::vec3 v0(-1, -1, -1);
@@ -206,7 +222,7 @@ static Mesh make_cube()
     const glm::vec3 v6(1, 1, 1);
     const glm::vec3 v7(1, -1, 1);
 
-    Mesh m;
+    Mesh m(memory);
 
     m.push_back(make_face(v0, v1, v2, v3));
     m.push_back(make_face(v1, v5, v6, v2));
@@ -218,15 +234,23 @@ static Mesh make_cube()
     return m;
 }
 
+struct Instance
+{
+    GLuint vertex_array;
+    int vertex_count;
+    const std::vector<SoftwareVertex> *software_verts;
+    glm::mat4 model;
+};
+
 struct Node
 {
     virtual ~Node() = default;
-    virtual void render(const gl::shader_program &program, const glm::mat4 &m, float time) const = 0;
+    virtual void collect(const glm::mat4 &m, float time, std::vector<Instance> &instances) const = 0;
 };
 
 struct Split : Node
 {
-    void render(const gl::shader_program &program, const glm::mat4 &m, float time) const override
+    void collect(const glm::mat4 &m, float time, std::vector<Instance> &instances) const override
     {
         constexpr const auto MaxOffset = 0.5f;
 
@@ -246,8 +270,8 @@ struct Split : Node
             }
         }();
 
-        front->render(program, m * glm::translate(glm::mat4(1), -offset * normal), time);
-        back->render(program, m * glm::translate(glm::mat4(1), offset * normal), time);
+        front->collect(m * glm::translate(glm::mat4(1), -offset * normal), time, instances);
+        back->collect(m * glm::translate(glm::mat4(1), offset * normal), time, instances);
     }
 
     glm::vec3 normal;
@@ -258,32 +282,34 @@ struct Split : Node
 
 struct Leaf : Node
 {
-    void render(const gl::shader_program &program, const glm::mat4 &model, float) const override
+    void collect(const glm::mat4 &model, float, std::vector<Instance> &instances) const override
     {
-        program.set_uniform("modelMatrix", model);
-        mesh->render();
+        instances.push_back({ mesh->vertex_array(), mesh->vertex_count(), &mesh->software_verts(), model });
     }
 
     std::unique_ptr<MeshGeometry> mesh;
 };
 
-std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
+// node numbers the tree from 1 like a binary heap, so every split plane
+// has its own random values
+std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth, int max_depth, const gl::random_stream &random,
+                                 std::uint64_t node = 1)
 {
-    constexpr const auto MaxDepth = 7;
-    if (depth == MaxDepth) {
+    if (depth == max_depth) {
         auto leaf = new Leaf;
         leaf->mesh = std::make_unique<MeshGeometry>(mesh);
         return std::unique_ptr<Node>(leaf);
     }
 
-    const auto rand_vector = [] {
-        auto v = glm::vec3(static_cast<float>(rand()) / RAND_MAX, static_cast<float>(rand()) / RAND_MAX, static_cast<float>(rand()) / RAND_MAX);
+    const auto rand_vector = [&random, node](int index) {
+        const auto values = random.substream(node);
+        auto v = glm::vec3(values.uniform(3 * index), values.uniform(3 * index + 1), values.uniform(3 * index + 2));
         return 2.0f * v - glm::vec3(1.0f);
     };
 
     Plane plane;
-    plane.point = rand_vector();
-    plane.normal = glm::normalize(rand_vector());
+    plane.point = rand_vector(0);
+    plane.normal = glm::normalize(rand_vector(1));
 
     const auto [front_mesh, back_mesh] = split(mesh, plane);
 
@@ -298,52 +324,82 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 
     auto split = new Split;
     split->normal = plane.normal;
-    split->front = build_tree(front_mesh, depth + 1);
-    split->back = build_tree(back_mesh, depth + 1);
+    split->front = build_tree(front_mesh, depth + 1, max_depth, random, 2 * node);
+    split->back = build_tree(back_mesh, depth + 1, max_depth, random, 2 * node + 1);
     split->start_explode = StartExplode + 0.25 * depth;
     split->start_implode = StartImplode - 0.5 * 0.125 * depth;
     return std::unique_ptr<Node>(split);
 }
 
-class Demo
+class Demo : public gl::demo
 {
 public:
-    Demo(int window_width, int window_height)
-        : window_width_(window_width)
-        , window_height_(window_height)
+    Demo(int argc, char *argv[])
+        : gl::demo(argc, argv)
+        , shadow_size_(parameters_.get("shadow_size", 2048))
+        , max_depth_(parameters_.get("depth", 7))
         , plane_(glm::vec3(0, 0, -2.5), glm::vec3(10, 0, 0), glm::vec3(0, 10, 0))
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , shadow_buffer_(shadow_size_, shadow_size_)
+        , random_(parameters_.get("seed", 0))
+        , software_(parameters_.get("software", 0) != 0)
     {
         initialize_shader();
-        split_tree_ = build_tree(make_cube(), 0);
+        split_tree_ = build_tree(make_cube(frame_arena_.resource()), 0, max_depth_, random_.substream(cycle_));
     }
 
-    void render_and_step(float dt)
+    void set_software(bool software) override { software_ = software; }
+
+    void update(float dt) override
     {
-        render();
         cur_time_ += dt;
         if (cur_time_ >= CycleDuration) {
             cur_time_ -= CycleDuration;
-            split_tree_ = build_tree(make_cube(), 0);
+            // a new tree every cycle
+            split_tree_ = build_tree(make_cube(frame_arena_.resource()), 0, max_depth_, random_.substream(++cycle_));
+            expect_allocations();
+            new_tree_ = true;
         }
     }
 
-private:
-    void initialize_shader()
+    void render() override
     {
-        shadow_program_.add_shader(GL_VERTEX_SHADER, "shaders/shadow.vert");
-        shadow_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/shadow.frag");
-        shadow_program_.link();
-
-        program_.add_shader(GL_VERTEX_SHADER, "shaders/phong.vert");
-        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/phong.frag");
-        program_.link();
-    }
+        // a tree with more leaves than the previous ones grows the instance
+        // and draw lists the first time it's drawn
+        if (new_tree_) {
+            expect_allocations();
+            new_tree_ = false;
+        }
 
-    void render() const
-    {
         const auto light_position = glm::vec3(3, -3, 5);
 
+        const auto light_projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 12.5f);
+        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
+        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1)) *
+            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(1, 0, 0)) *
+            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(0, 1, 0));
+
+        instances_.clear();
+        instances_.push_back(
+                { plane_.vertex_array(), plane_.vertex_count(), &plane_.software_verts(), glm::mat4(1.0) });
+        split_tree_->collect(model, fmod(cur_time_, CycleDuration), instances_);
+
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
+        const auto view_pos = glm::vec3(0, 0, 7);
+        const auto view_up = glm::vec3(0, 1, 0);
+        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
+        antialiasing_->set_view_projection(projection * view);
+
+        if (software_) {
+            render_software(light_position, light_projection * light_view, projection * view);
+            return;
+        }
+
+        record(shadow_draws_, shadow_program_, {});
+        record(scene_draws_, program_, { GL_TEXTURE_2D, shadow_buffer_.texture_handle() });
+
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
 
@@ -351,19 +407,11 @@ private:
 
         // render shadow
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
+        glViewport(0, 0, shadow_size_, shadow_size_);
         shadow_buffer_.bind();
 
         glClear(GL_DEPTH_BUFFER_BIT);
 
-        const auto light_projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 12.5f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-
-        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
-        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1)) *
-            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(1, 0, 0)) *
-            glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25f * M_PI), glm::vec3(0, 1, 0));
-
         shadow_program_.bind();
         shadow_program_.set_uniform("viewMatrix", light_view);
         shadow_program_.set_uniform("projectionMatrix", light_projection);
@@ -371,9 +419,7 @@ private:
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
-        shadow_program_.set_uniform("modelMatrix", glm::mat4(1.0));
-        plane_.render();
-        split_tree_->render(shadow_program_, model, fmod(cur_time_, CycleDuration));
+        submit("shadow", shadow_draws_);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
 
@@ -381,19 +427,11 @@ private:
 
         // render scene
 
-        glViewport(0, 0, window_width_, window_height_);
+        glViewport(0, 0, width_, height_);
 
         glClearColor(0.75, 0.75, 0.75, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        const auto view_pos = glm::vec3(0, 0, 7);
-        const auto view_up = glm::vec3(0, 1, 0);
-        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
-
-        shadow_buffer_.bind_texture();
-
         program_.bind();
         program_.set_uniform("lightPosition", light_position);
         program_.set_uniform("eyePosition", view_pos);
@@ -402,70 +440,98 @@ private:
         program_.set_uniform("lightViewProjection", light_projection * light_view);
         program_.set_uniform("shadowMapTexture", 0);
 
-        program_.set_uniform("modelMatrix", glm::mat4(1.0));
-        plane_.render();
-        split_tree_->render(program_, model, fmod(cur_time_, CycleDuration));
+        submit("scene", scene_draws_);
     }
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+private:
+    void initialize_shader()
+    {
+        shadow_program_.add_shader(GL_VERTEX_SHADER, "shaders/shadow.vert");
+        shadow_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/shadow.frag");
+        shadow_program_.link();
 
-    int window_width_;
-    int window_height_;
+        program_.add_shader(GL_VERTEX_SHADER, "shaders/phong.vert");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/phong.frag");
+        program_.link();
+    }
+
+    // -p software=1: both passes on the cpu, the shadow map in a depth only
+    // rasterizer. the 11x11 taps of phong.frag become 3x3 over the same
+    // footprint
+    void render_software(const glm::vec3 &light_position, const glm::mat4 &light_view_projection,
+                         const glm::mat4 &view_projection)
+    {
+        if (!software_scene_) {
+            software_shadow_.reset(new gl::software_rasterizer(shadow_size_, shadow_size_, true));
+            software_scene_.reset(new gl::software_rasterizer(width_, height_));
+            software_target_.reset(new gl::software_target(width_, height_));
+        }
+
+        software_shadow_->clear();
+        for (const auto &instance : instances_) {
+            software_shadow_->draw(
+                    *instance.software_verts, 0, instance.vertex_count,
+                    { light_view_projection * instance.model, instance.model, glm::mat3(instance.model) });
+        }
+        software_shadow_->finish();
+
+        // phong.frag lights in world space with a gray ambient
+        software_scene_->set_lighting({ light_position, 0.15f, false });
+        software_scene_->set_shadow({ software_shadow_.get() });
+        software_scene_->clear(glm::vec4(0.75, 0.75, 0.75, 0));
+        for (const auto &instance : instances_) {
+            software_scene_->draw(*instance.software_verts, 0, instance.vertex_count,
+                                  { view_projection * instance.model, instance.model, glm::mat3(instance.model),
+                                    light_view_projection * instance.model });
+        }
+        software_scene_->finish();
+        software_target_->draw(*software_scene_);
+    }
+
+    void record(gl::draw_list &draws, const gl::shader_program &program, const gl::draw_list::texture_binding &shadow_map) const
+    {
+        for (const auto &instance : instances_) {
+            draws.add(program, instance.vertex_array, { GL_TRIANGLES, instance.vertex_count }, instance.model,
+                      { shadow_map });
+        }
+    }
+
+    void submit(const char *name, gl::draw_list &draws) const
+    {
+        const auto unsorted = draws.simulate();
+        draws.sort();
+        const auto sorted = draws.submit();
+        if (report_stats_) {
+            std::printf("%s: %d draws, program/vao/texture/uniform changes %d/%d/%d/%d unsorted, %d/%d/%d/%d sorted\n",
+                        name, sorted.draws, unsorted.program_changes, unsorted.vertex_array_changes,
+                        unsorted.texture_changes, unsorted.uniform_changes, sorted.program_changes,
+                        sorted.vertex_array_changes, sorted.texture_changes, sorted.uniform_changes);
+        }
+    }
+
+    int shadow_size_;
+
+    int max_depth_;
     float cur_time_ = 0;
     std::unique_ptr<Node> split_tree_;
     PlaneGeometry plane_;
     gl::shadow_buffer shadow_buffer_;
+    gl::random_stream random_;
+    int cycle_ = 0;
+    bool new_tree_ = false;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
+    std::vector<Instance> instances_;
+    gl::draw_list shadow_draws_;
+    gl::draw_list scene_draws_;
+    bool software_;
+    std::unique_ptr<gl::software_rasterizer> software_shadow_;
+    std::unique_ptr<gl::software_rasterizer> software_scene_;
+    std::unique_ptr<gl::software_target> software_target_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
-    constexpr auto window_width = 800;
-    constexpr auto window_height = 800;
-
-    srand(time(nullptr));
-
-    gl::window w(window_width, window_height, "Demo");
-
-    glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
-        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-            glfwSetWindowShouldClose(window, GL_TRUE);
-    });
-
-#ifdef DUMP_FRAMES
-    constexpr auto total_frames = 5 * CycleDuration * FramesPerSecond;
-    auto frame_num = 0;
-#endif
-
-    {
-        Demo d(window_width, window_height);
-
-#ifndef DUMP_FRAMES
-        double curTime = glfwGetTime();
-#endif
-        while (!glfwWindowShouldClose(w)) {
-#ifndef DUMP_FRAMES
-            auto now = glfwGetTime();
-            const auto dt = now - curTime;
-            curTime = now;
-#else
-            constexpr auto dt = 1.0f / FramesPerSecond;
-#endif
-            d.render_and_step(dt);
-
-#ifdef DUMP_FRAMES
-            char path[80];
-            std::sprintf(path, "%05d.ppm", frame_num);
-            dump_frame_to_file(path, window_width, window_height);
-
-            if (++frame_num == total_frames)
-                break;
-#endif
-
-            glfwSwapBuffers(w);
-            glfwPollEvents();
-        }
-    }
+    Demo d(argc, argv);
+    d.run();
 }
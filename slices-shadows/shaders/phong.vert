@@ -4,7 +4,11 @@ layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec3 color;
 
-uniform mat4 modelMatrix;
+layout(std140, binding=0) uniform Draw
+{
+    mat4 modelMatrix;
+};
+
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 uniform mat4 lightViewProjection;
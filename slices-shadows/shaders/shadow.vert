@@ -2,7 +2,11 @@
 
 layout(location=0) in vec3 position;
 
-uniform mat4 modelMatrix;
+layout(std140, binding=0) uniform Draw
+{
+    mat4 modelMatrix;
+};
+
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
@@ -2,8 +2,14 @@
 
 #include "window.h"
 #include "geometry.h"
+#include "software_rasterizer.h"
+#include "software_target.h"
 #include "shader_program.h"
 #include "util.h"
+#include "random.h"
+#include "matrix.h"
+#include "parameters.h"
+#include "antialiasing.h"
 #include "tween.h"
 
 #include <GL/glew.h>
@@ -121,6 +127,10 @@ public:
     {
         initialize_geometry(m);
         geometry_.set_data(verts_);
+
+        software_verts_.reserve(verts_.size());
+        for (const auto &[position, normal, color] : verts_)
+            software_verts_.push_back({ position, normal, color });
     }
 
     void render() const
@@ -129,6 +139,11 @@ public:
         glDrawArrays(GL_TRIANGLES, 0, verts_.size());
     }
 
+    void render(gl::software_rasterizer &rasterizer, const gl::software_rasterizer::transform &transform) const
+    {
+        rasterizer.draw(software_verts_, 0, software_verts_.size(), transform);
+    }
+
 private:
     void initialize_geometry(const Mesh &mesh)
     {
@@ -147,6 +162,7 @@ private:
 
     using vertex = std::tuple<glm::vec3, glm::vec3, glm::vec3>;
     std::vector<vertex> verts_;
+    std::vector<gl::software_rasterizer::vertex> software_verts_;
     gl::geometry geometry_;
 };
 
@@ -189,32 +205,42 @@ struct Node
 {
     virtual ~Node() = default;
     virtual void render(const glm::mat4 &m, float time) const = 0;
+    virtual void render(gl::software_rasterizer &rasterizer, const glm::mat4 &m, float time) const = 0;
 };
 
 struct Split : Node
 {
     void render(const glm::mat4 &m, float time) const override
     {
-        constexpr const auto MaxOffset = 0.3f;
+        const auto offset = this->offset(time);
+        front->render(gl::multiply_affine(m, glm::translate(glm::mat4(1), -offset * normal)), time);
+        back->render(gl::multiply_affine(m, glm::translate(glm::mat4(1), offset * normal)), time);
+    }
 
-        const auto offset = [this, time]() -> float {
-            if (time < start_explode) {
-                return 0;
-            } else if (time < start_explode + ExplodeDuration) {
-                float t = (time - start_explode) / ExplodeDuration;
-                return in_quadratic(t) * MaxOffset;
-            } else if (time < start_implode) {
-                return MaxOffset;
-            } else if (time < start_implode + ImplodeDuration) {
-                float t = (time - start_implode) / ImplodeDuration;
-                return out_quadratic(1 - t) * MaxOffset;
-            } else {
-                return 0;
-            }
-        }();
+    void render(gl::software_rasterizer &rasterizer, const glm::mat4 &m, float time) const override
+    {
+        const auto offset = this->offset(time);
+        front->render(rasterizer, gl::multiply_affine(m, glm::translate(glm::mat4(1), -offset * normal)), time);
+        back->render(rasterizer, gl::multiply_affine(m, glm::translate(glm::mat4(1), offset * normal)), time);
+    }
+
+    float offset(float time) const
+    {
+        constexpr const auto MaxOffset = 0.3f;
 
-        front->render(m * glm::translate(glm::mat4(1), -offset * normal), time);
-        back->render(m * glm::translate(glm::mat4(1), offset * normal), time);
+        if (time < start_explode) {
+            return 0;
+        } else if (time < start_explode + ExplodeDuration) {
+            float t = (time - start_explode) / ExplodeDuration;
+            return in_quadratic(t) * MaxOffset;
+        } else if (time < start_implode) {
+            return MaxOffset;
+        } else if (time < start_implode + ImplodeDuration) {
+            float t = (time - start_implode) / ImplodeDuration;
+            return out_quadratic(1 - t) * MaxOffset;
+        } else {
+            return 0;
+        }
     }
 
     glm::vec3 normal;
@@ -229,37 +255,47 @@ struct Leaf : Node
     {
         const auto mvp = projection * view * model;
         program_->set_uniform(program_->uniform_location("mvp"), mvp);
-
-        glm::mat3 model_normal = model;
-        model_normal = glm::inverse(model_normal);
-        model_normal = glm::transpose(model_normal);
-
-        program_->set_uniform(program_->uniform_location("normalMatrix"), model_normal);
+        program_->set_uniform(program_->uniform_location("normalMatrix"), normal_matrix(model));
         program_->set_uniform(program_->uniform_location("modelMatrix"), view * model);
 
         mesh->render();
     }
 
+    void render(gl::software_rasterizer &rasterizer, const glm::mat4 &model, float) const override
+    {
+        mesh->render(rasterizer, { projection * view * model, view * model, normal_matrix(model) });
+    }
+
+    static glm::mat3 normal_matrix(const glm::mat4 &model)
+    {
+        glm::mat3 model_normal = model;
+        model_normal = glm::inverse(model_normal);
+        return glm::transpose(model_normal);
+    }
+
     std::unique_ptr<mesh_geometry> mesh;
 };
 
-std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
+// node numbers the tree from 1 like a binary heap, so every split plane
+// has its own random values
+std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth, int max_depth, const gl::random_stream &random,
+                                 std::uint64_t node = 1)
 {
-    constexpr const auto MaxDepth = 7;
-    if (depth == MaxDepth) {
+    if (depth == max_depth) {
         auto leaf = new Leaf;
         leaf->mesh = std::make_unique<mesh_geometry>(mesh);
         return std::unique_ptr<Node>(leaf);
     }
 
-    const auto rand_vector = [] {
-        auto v = glm::vec3(static_cast<float>(rand()) / RAND_MAX, static_cast<float>(rand()) / RAND_MAX, static_cast<float>(rand()) / RAND_MAX);
+    const auto rand_vector = [&random, node](int index) {
+        const auto values = random.substream(node);
+        auto v = glm::vec3(values.uniform(3 * index), values.uniform(3 * index + 1), values.uniform(3 * index + 2));
         return 2.0f * v - glm::vec3(1.0f);
     };
 
     Plane plane;
-    plane.point = rand_vector();
-    plane.normal = glm::normalize(rand_vector());
+    plane.point = rand_vector(0);
+    plane.normal = glm::normalize(rand_vector(1));
 
     const auto [front_mesh, back_mesh] = split(mesh, plane);
 
@@ -274,8 +310,8 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 
     auto split = new Split;
     split->normal = plane.normal;
-    split->front = build_tree(front_mesh, depth + 1);
-    split->back = build_tree(back_mesh, depth + 1);
+    split->front = build_tree(front_mesh, depth + 1, max_depth, random, 2 * node);
+    split->back = build_tree(back_mesh, depth + 1, max_depth, random, 2 * node + 1);
     split->start_explode = StartExplode + 0.25 * depth;
     split->start_implode = StartImplode - 0.5 * 0.125 * depth;
     return std::unique_ptr<Node>(split);
@@ -284,12 +320,29 @@ std::unique_ptr<Node> build_tree(const Mesh &mesh, int depth)
 class demo
 {
 public:
-    demo(int window_width, int window_height)
+    demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
+        , max_depth_(parameters.get("depth", 7))
     {
         initialize_shader();
-        split_tree_ = build_tree(make_cube(), 0);
+        split_tree_ = build_tree(make_cube(), 0, max_depth_, gl::random_stream(parameters.get("seed", 0)));
+
+        // -p software=1: rasterize on the cpu and only draw the result
+        if (parameters.get("software", 0) != 0)
+            set_software(true);
+    }
+
+    void set_software(bool software)
+    {
+        if (!software) {
+            software_.reset();
+            return;
+        }
+        if (!software_) {
+            software_.reset(new gl::software_rasterizer(window_width_, window_height_));
+            software_target_.reset(new gl::software_target(window_width_, window_height_));
+        }
     }
 
     void render_and_step(float dt)
@@ -298,6 +351,17 @@ public:
         cur_time_ += dt;
     }
 
+    // the current frame on the GPU and on the CPU, see gl::compare_software
+    float compare_software(gl::antialiasing &antialiasing)
+    {
+        return gl::compare_software(window_width_, window_height_, [this, &antialiasing](bool software) {
+            set_software(software);
+            antialiasing.begin_frame();
+            render();
+            antialiasing.end_frame();
+        });
+    }
+
 private:
     void initialize_shader()
     {
@@ -308,6 +372,23 @@ private:
     }
 
     void render() const
+    {
+        projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+        const auto view_pos = glm::vec3(3.5, -3.5, 3.5);
+        const auto view_up = glm::vec3(0, 1, 0);
+        view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
+
+        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
+        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 2, 1));
+
+        if (software_)
+            render_software(model);
+        else
+            render_hardware(model);
+    }
+
+    void render_hardware(const glm::mat4 &model) const
     {
         glViewport(0, 0, window_width_, window_height_);
 
@@ -324,34 +405,38 @@ private:
 
         glDisable(GL_CULL_FACE);
 
-        projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        const auto view_pos = glm::vec3(3.5, -3.5, 3.5);
-        const auto view_up = glm::vec3(0, 1, 0);
-        view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
-
-        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
-        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 2, 1));
-
         program_->bind();
         program_->set_uniform(program_->uniform_location("global_light"), glm::vec3(5, -5, 5));
 
         split_tree_->render(model, fmod(cur_time_, CycleDuration));
     }
 
+    void render_software(const glm::mat4 &model) const
+    {
+        software_->set_lighting({ glm::vec3(5, -5, 5), 0.15f });
+        software_->clear(glm::vec4(0.75, 0.75, 0.75, 0));
+        split_tree_->render(*software_, model, fmod(cur_time_, CycleDuration));
+        software_->finish();
+        software_target_->draw(*software_);
+    }
+
     int window_width_;
     int window_height_;
+    int max_depth_;
     float cur_time_ = 0;
     std::unique_ptr<Node> split_tree_;
+    std::unique_ptr<gl::software_rasterizer> software_;
+    std::unique_ptr<gl::software_target> software_target_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
-    srand(time(nullptr));
-
     gl::window w(window_width, window_height, "demo");
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
@@ -365,7 +450,15 @@ int main()
 #endif
 
     {
-        demo d(window_width, window_height);
+        demo d(window_width, window_height, parameters);
+        gl::antialiasing antialiasing(gl::antialiasing::multisample(parameters.get("samples", 4)), window_width,
+                                      window_height);
+
+        // -p software_check=N: golden frame diff of the cpu renderer against
+        // the GPU, fails if more than N percent of the pixels differ. run
+        // with -p samples=0 so edges are comparable
+        if (const auto tolerance = parameters.get("software_check", 0.0f); tolerance > 0)
+            return d.compare_software(antialiasing) > tolerance ? 1 : 0;
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -378,7 +471,9 @@ int main()
 #else
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
+            antialiasing.begin_frame();
             d.render_and_step(dt);
+            antialiasing.end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -4,6 +4,11 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
+#include "antialiasing.h"
+#include "framebuffer_pool.h"
+#include "weighted_oit.h"
+#include "procedural_texture.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -14,6 +19,9 @@
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 
@@ -29,9 +37,9 @@ constexpr const auto FramesPerSecond = 60;
 class sphere_geometry
 {
 public:
-    sphere_geometry()
+    sphere_geometry(int rings, int slices)
     {
-        initialize_geometry();
+        initialize_geometry(rings, slices);
         geometry_.set_data(verts_, indices_);
     }
 
@@ -42,36 +50,36 @@ public:
     }
 
 private:
-    void initialize_geometry()
+    void initialize_geometry(int rings, int slices)
     {
-        constexpr auto Rings = 450;
-        constexpr auto Slices = 20;
         constexpr auto Turns = 3.0;
 
-        for (int i = 0; i < Rings; ++i) {
-            const auto big_radius = powf(1.0005, 10.5 * i) * i * 0.0001; // /* static_cast<float>(i) * 0.0048 */;
-            for (int j = 0; j < Slices; ++j) {
+        for (int i = 0; i < rings; ++i) {
+            // the radius curve was tuned for 450 rings
+            const auto ring = static_cast<float>(i) * 450 / rings;
+            const auto big_radius = powf(1.0005, 10.5 * ring) * ring * 0.0001; // /* static_cast<float>(i) * 0.0048 */;
+            for (int j = 0; j < slices; ++j) {
                 const auto small_radius = big_radius * .45; // /* sqrtf(static_cast<float>(i)) * */ i * 0.00025;
 
-                const auto phi = (static_cast<double>(i) / Rings) * 2.0 * M_PI * Turns;
-                const auto theta = (static_cast<double>(j) / Slices) * 2.0 * M_PI;
+                const auto phi = (static_cast<double>(i) / rings) * 2.0 * M_PI * Turns;
+                const auto theta = (static_cast<double>(j) / slices) * 2.0 * M_PI;
 
                 const auto r = glm::mat3(std::cos(phi), std::sin(phi), 0, -std::sin(phi), std::cos(phi), 0, 0, 0, 1);
                 const auto p = r * glm::vec3(0, big_radius + small_radius * std::cos(theta), small_radius * std::sin(theta));
                 const auto o = r * glm::vec3(0, big_radius, 0);
 
-                const auto uv = glm::vec2(static_cast<float>(i) / Rings, static_cast<float>(j) / Slices);
+                const auto uv = glm::vec2(static_cast<float>(i) / rings, static_cast<float>(j) / slices);
 
                 verts_.emplace_back(p, glm::normalize(p - o), uv);
             }
         }
 
-        for (int i = 0; i < Rings - 1; ++i) {
-            for (int j = 0; j < Slices; ++j) {
-                const auto i0 = i * Slices + j;
-                const auto i1 = (i + 1) * Slices + j;
-                const auto i2 = (i + 1) * Slices + (j + 1) % Slices;
-                const auto i3 = i * Slices + (j + 1) % Slices;
+        for (int i = 0; i < rings - 1; ++i) {
+            for (int j = 0; j < slices; ++j) {
+                const auto i0 = i * slices + j;
+                const auto i1 = (i + 1) * slices + j;
+                const auto i2 = (i + 1) * slices + (j + 1) % slices;
+                const auto i3 = i * slices + (j + 1) % slices;
 
                 indices_.push_back(i0);
                 indices_.push_back(i1);
@@ -93,29 +101,104 @@ private:
 class demo
 {
 public:
-    demo(int window_width, int window_height)
+    demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
-        , sphere_(new sphere_geometry)
+        , sphere_(new sphere_geometry(parameters.get("rings", 450), parameters.get("slices", 20)))
+        // -p single_pass=0 draws the two culled passes instead
+        , mode_(parameters.get("single_pass", 1) != 0 ? render_mode::layered : render_mode::two_pass)
     {
+        // -p oit=1 draws both sides in one unordered pass with weighted
+        // blended order-independent transparency
+        if (parameters.get("oit", 0) != 0) {
+            mode_ = render_mode::oit;
+            oit_.reset(new gl::weighted_oit(framebuffer_pool_, window_width_, window_height_));
+        }
         initialize_shader();
+        pattern_texture_ = textures_.get("shaders/dots.frag", parameters.get("pattern_size", 1024));
     }
 
     void render_and_step(float dt)
     {
-        render(program_);
+        framebuffer_pool_.begin_frame();
+        render(mode_);
         cur_time_ += dt;
     }
 
+    // renders the current frame with two culled passes and with one layered
+    // pass, writes both as golden frames and returns the largest channel
+    // difference
+    int compare_two_sided(gl::antialiasing &antialiasing)
+    {
+        std::array<std::vector<unsigned char>, 2> frames;
+        for (int i = 0; i < 2; ++i) {
+            framebuffer_pool_.begin_frame();
+            antialiasing.begin_frame();
+            render(i == 1 ? render_mode::layered : render_mode::two_pass);
+            antialiasing.end_frame();
+
+            dump_frame_to_file(i == 1 ? "single_pass.ppm" : "two_pass.ppm", window_width_, window_height_);
+            frames[i].resize(window_width_ * window_height_ * 3);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, window_width_, window_height_, GL_RGB, GL_UNSIGNED_BYTE, frames[i].data());
+        }
+
+        constexpr auto Threshold = 2;
+        int max_difference = 0;
+        int differing_pixels = 0;
+        for (std::size_t i = 0; i < frames[0].size(); i += 3) {
+            int difference = 0;
+            for (int j = 0; j < 3; ++j)
+                difference = std::max(difference, std::abs(frames[0][i + j] - frames[1][i + j]));
+            max_difference = std::max(max_difference, difference);
+            if (difference > Threshold)
+                ++differing_pixels;
+        }
+        std::printf("two-sided parity: max difference %d, %d of %d pixels differ by more than %d\n", max_difference,
+                    differing_pixels, window_width_ * window_height_, Threshold);
+        return max_difference;
+    }
+
 private:
+    enum class render_mode
+    {
+        two_pass, // back faces, then front faces
+        layered, // both sides from one submission, see render_layered()
+        oit, // both sides unordered, weighted blended
+    };
+
     void initialize_shader()
     {
         program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
         program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/output.frag");
         program_.link();
+
+        layered_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        layered_program_.add_shader(GL_GEOMETRY_SHADER, "shaders/two_sided.geom");
+        layered_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
+        layered_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/output.frag");
+        layered_program_.link();
+
+        // no fragment shader, only depth is written
+        back_depth_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        back_depth_program_.add_shader(GL_GEOMETRY_SHADER, "shaders/two_sided.geom");
+        back_depth_program_.link();
+
+        composite_program_.add_shader(GL_VERTEX_SHADER, COMMON_SHADER_DIR "/quad.vert");
+        composite_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/two_sided_composite.frag");
+        composite_program_.link();
+
+        quad_.set_data(std::vector<quad_vertex>{
+                { { -1, -1 }, { 0, 0 } }, { { -1, 1 }, { 0, 1 } }, { { 1, -1 }, { 1, 0 } }, { { 1, 1 }, { 1, 1 } } });
+
+        oit_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        oit_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
+        gl::weighted_oit::attach_output(oit_program_);
+        oit_program_.link();
     }
 
-    void render(const gl::shader_program &program) const
+    void render(render_mode mode)
     {
         glViewport(0, 0, window_width_, window_height_);
         glClearColor(0.5, 0.5, 0.5, 0);
@@ -145,6 +228,8 @@ private:
         model_normal = glm::inverse(model_normal);
         model_normal = glm::transpose(model_normal);
 
+        const auto &program =
+                mode == render_mode::oit ? oit_program_ : mode == render_mode::layered ? layered_program_ : program_;
         program.bind();
 
         constexpr const auto LocationMvp = 0;
@@ -160,22 +245,107 @@ private:
         const auto a = static_cast<float>(cur_time_) / CycleDuration; // sinf(cur_time_ * 2.f * M_PI / cycle_duration);
         program.set_uniform(LocationUvOffset, glm::vec2(-a, a));
 
-        glCullFace(GL_FRONT);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, pattern_texture_);
+
+        switch (mode) {
+        case render_mode::two_pass:
+            glCullFace(GL_FRONT);
+            sphere_->render();
+
+            glCullFace(GL_BACK);
+            sphere_->render();
+            break;
+
+        case render_mode::layered:
+            render_layered(mvp);
+            break;
+
+        case render_mode::oit:
+            // both sides in a single pass, no ordering needed
+            glDisable(GL_CULL_FACE);
+            oit_->bind();
+            sphere_->render();
+            oit_->render();
+            break;
+        }
+    }
+
+    // same image as the two culled passes with the mesh shaded once: back
+    // faces go to layer 0 and front faces to layer 1 (two_sided.geom), each
+    // layer is depth tested and blended in submission order like its pass,
+    // then the layers are composited back to front. layer 1 first gets the
+    // back faces' depth, so front faces behind a nearer back face are
+    // rejected as in the second pass
+    void render_layered(const glm::mat4 &mvp)
+    {
+        // match the samples of the target so msaa edges stay the same
+        GLint samples;
+        glGetIntegerv(GL_SAMPLES, &samples);
+        const gl::framebuffer_format format = { { GL_RGBA16F }, GL_DEPTH24_STENCIL8, std::max(samples, 1), 2 };
+        auto *layers = framebuffer_pool_.acquire(window_width_, window_height_, format);
+
+        GLint target_framebuffer;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer);
+
+        layers->bind();
+        const GLfloat zero[] = { 0, 0, 0, 0 };
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+        glDisable(GL_CULL_FACE);
+
+        constexpr const auto LocationMvp = 0;
+        constexpr const auto LocationBackDepth = 5;
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        back_depth_program_.bind();
+        back_depth_program_.set_uniform(LocationMvp, mvp);
+        back_depth_program_.set_uniform(LocationBackDepth, 1);
         sphere_->render();
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-        glCullFace(GL_BACK);
+        // premultiplied color and coverage, so the layers composite exactly
+        layered_program_.bind();
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
         sphere_->render();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+        glDisable(GL_DEPTH_TEST);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        glActiveTexture(GL_TEXTURE0);
+        layers->bind_texture();
+        composite_program_.bind();
+        quad_.bind();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        framebuffer_pool_.release(layers);
     }
 
     int window_width_;
     int window_height_;
     float cur_time_ = 0;
     gl::shader_program program_;
+    gl::shader_program layered_program_;
+    gl::shader_program back_depth_program_;
+    gl::shader_program composite_program_;
+    using quad_vertex = std::tuple<glm::vec2, glm::vec2>;
+    gl::geometry quad_;
     std::unique_ptr<sphere_geometry> sphere_;
+    render_mode mode_;
+    gl::procedural_texture_cache textures_;
+    GLuint pattern_texture_;
+    gl::framebuffer_pool framebuffer_pool_;
+    gl::shader_program oit_program_;
+    std::unique_ptr<gl::weighted_oit> oit_; // only with -p oit=1
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 512;
     constexpr auto window_height = 512;
 
@@ -198,7 +368,14 @@ int main()
 #endif
 
     {
-        demo d(window_width, window_height);
+        demo d(window_width, window_height, parameters);
+        gl::antialiasing antialiasing(gl::antialiasing::multisample(parameters.get("samples", 4)), window_width,
+                                      window_height);
+
+        // -p parity_check=N: golden frame diff of the single pass path,
+        // fails if a channel differs by more than N
+        if (const auto tolerance = parameters.get("parity_check", 0); tolerance > 0)
+            return d.compare_two_sided(antialiasing) > tolerance ? 1 : 0;
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -211,7 +388,9 @@ int main()
 #else
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
+            antialiasing.begin_frame();
             d.render_and_step(dt);
+            antialiasing.end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -0,0 +1,42 @@
+#version 450 core
+
+// the dot pattern of sphere.frag over one period, baked into a texture.
+// cells wrap at 16 so the pattern tiles
+
+in vec2 tex_coords;
+
+out vec4 frag_color;
+
+float random(vec2 st)
+{
+    return fract(sin(dot(st.xy, vec2(12.9898, 78.233))) * 43758.5453123);
+}
+
+float pattern(vec2 id, vec2 p, vec2 offs)
+{
+    id = mod(id + offs, 16);
+    float r = 0.5 * random(id);
+    vec2 o = vec2(random(id + vec2(0, 1)), random(id + vec2(1, 0))) + offs;
+    float d = distance(p, o);
+    return 1.0 - smoothstep(r - .05, r, d);
+}
+
+void main(void)
+{
+    vec2 uv = tex_coords * 16.0;
+
+    vec2 p = fract(uv) - 0.5;
+    vec2 id = floor(uv);
+
+    float l = 0;
+    for (float i = -1; i <= 1; ++i)
+    {
+        for (float j = -1; j <= 1; ++j)
+        {
+            l += pattern(id, p, vec2(i, j));
+        }
+    }
+    l = clamp(l, 0, 1);
+
+    frag_color = vec4(l);
+}
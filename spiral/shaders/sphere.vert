@@ -8,14 +8,17 @@ layout(location=0) uniform mat4 mvp;
 layout(location=1) uniform mat3 normalMatrix;
 layout(location=2) uniform mat4 modelMatrix;
 
-out vec3 vs_position;
-out vec3 vs_normal;
-out vec2 vs_uv;
+out Vertex
+{
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+} vs_out;
 
 void main(void)
 {
-    vs_position = vec3(modelMatrix * vec4(position, 1.0));
-    vs_normal = normalMatrix * normal;
-    vs_uv = uv;
+    vs_out.position = vec3(modelMatrix * vec4(position, 1.0));
+    vs_out.normal = normalMatrix * normal;
+    vs_out.uv = uv;
     gl_Position = mvp*vec4(position, 1.0);
 }
@@ -0,0 +1,16 @@
+#version 450 core
+
+// front layer over back layer, per sample. both hold premultiplied color
+// and coverage
+
+layout(binding=0) uniform sampler2DMSArray layers;
+
+out vec4 frag_color;
+
+void main(void)
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 back = texelFetch(layers, ivec3(texel, 0), gl_SampleID);
+    vec4 front = texelFetch(layers, ivec3(texel, 1), gl_SampleID);
+    frag_color = front + (1.0 - front.a) * back;
+}
@@ -4,7 +4,10 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
+#include "random.h"
 #include "shadow_buffer.h"
+#include "depth_prepass.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -46,12 +49,10 @@ struct Bezier
 
 using Path = std::vector<Bezier>;
 
-float frand()
-{
-    return static_cast<float>(rand()) / RAND_MAX;
-}
-
-void subdivide(std::vector<glm::vec3> &points, const glm::vec3 &from, const glm::vec3 &to, int level)
+// node numbers the subdivision tree from 1 like a binary heap, so every
+// midpoint has its own random values
+void subdivide(std::vector<glm::vec3> &points, const glm::vec3 &from, const glm::vec3 &to, int level,
+               const gl::random_stream &random, std::uint64_t node = 1)
 {
     if (level > 0)
     {
@@ -62,15 +63,15 @@ void subdivide(std::vector<glm::vec3> &points, const glm::vec3 &from, const glm:
         const auto n = glm::vec3(0, 0, 1);
         const auto u = glm::cross(d, n);
 
-        const auto perturbed = [&to, &from](float factor, const glm::vec3 &v) {
+        const auto perturbed = [&to, &from](float factor, float r, const glm::vec3 &v) {
             const auto l = glm::distance(to, from);
-            return factor * (2.0f * frand() - 1.0f) * l * v;
+            return factor * (2.0f * r - 1.0f) * l * v;
         };
 
-        m += perturbed(0.25f, u) + perturbed(0.25f, n);
+        m += perturbed(0.25f, random.uniform(2 * node), u) + perturbed(0.25f, random.uniform(2 * node + 1), n);
 
-        subdivide(points, from, m, level - 1);
-        subdivide(points, m, to, level - 1);
+        subdivide(points, from, m, level - 1, random, 2 * node);
+        subdivide(points, m, to, level - 1, random, 2 * node + 1);
     }
     else
     {
@@ -115,9 +116,9 @@ private:
 class StripGeometry
 {
 public:
-    StripGeometry(float angle_offset, float coil_radius)
+    StripGeometry(float angle_offset, float coil_radius, const gl::random_stream &random)
     {
-        initialize(angle_offset, coil_radius);
+        initialize(angle_offset, coil_radius, random);
         geometry_.set_data(verts_);
     }
 
@@ -128,7 +129,7 @@ public:
     }
 
 private:
-    void initialize(float angle_offset, float coil_radius)
+    void initialize(float angle_offset, float coil_radius, const gl::random_stream &random)
     {
         std::vector<glm::vec3> control_points;
 
@@ -146,7 +147,7 @@ private:
         {
             const auto v0 = vertex_at(i);
             const auto v1 = vertex_at(i + 1);
-            subdivide(control_points, v0, v1, 1);
+            subdivide(control_points, v0, v1, 1, random.substream(i));
         }
 
         std::vector<std::tuple<glm::vec3, glm::vec3>> path_points; // position, normal
@@ -208,25 +209,36 @@ private:
 class Demo
 {
 public:
-    Demo(int window_width, int window_height)
+    Demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
         , plane_(new PlaneGeometry(glm::vec3(0, 0, -1), glm::vec3(3, 0, 0), glm::vec3(0, 3, 0)))
         , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , report_overdraw_(parameters.get("overdraw", 0) != 0)
     {
         initialize_shader();
 
-        for (int i = 0; i < NumStrips; ++i)
+        // -p overdraw=1 prints the overdraw of the color pass, with
+        // -p depth_prepass=1 that's what's left after the pre-pass
+        prepass_.set_enabled(parameters.get("depth_prepass", 0) != 0);
+
+        // a stream per strip: its parameters, then a substream for its path
+        const gl::random_stream random(parameters.get("seed", 0));
+        const auto num_strips = parameters.get("strips", 40);
+        params_.resize(num_strips);
+        for (int i = 0; i < num_strips; ++i)
         {
-            const float a = static_cast<float>(i) * 2.0f * M_PI / NumStrips;
-            const auto coil_radius = 0.05f + frand() * 0.05f;
-            strips_.emplace_back(new StripGeometry(a, coil_radius));
+            const auto strip_random = random.substream(i);
+            const float a = static_cast<float>(i) * 2.0f * M_PI / num_strips;
+            const auto coil_radius = 0.05f + strip_random.uniform(0) * 0.05f;
+            strips_.emplace_back(new StripGeometry(a, coil_radius, strip_random.substream(0)));
 
             auto &params = params_[i];
-            params.offset = frand();
-            params.speed = /* 0.1f + frand() * 0.3f */ static_cast<float>(1 + rand() % 2) / CycleDuration;
-            params.length = 0.1f + frand() * 0.2f;
-            params.color = glm::vec3(frand(), frand(), frand()) * 0.5f + glm::vec3(0.5f);
+            params.offset = strip_random.uniform(1);
+            params.speed = /* 0.1f + frand() * 0.3f */ static_cast<float>(1 + strip_random.below(2, 2)) / CycleDuration;
+            params.length = 0.1f + strip_random.uniform(3) * 0.2f;
+            params.color = glm::vec3(strip_random.uniform(4), strip_random.uniform(5), strip_random.uniform(6)) * 0.5f +
+                           glm::vec3(0.5f);
             // this sucks
         }
     }
@@ -278,9 +290,7 @@ private:
         const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
         shadow_program_.bind();
-        shadow_program_.set_uniform("viewMatrix", light_view);
-        shadow_program_.set_uniform("projectionMatrix", light_projection);
-        shadow_program_.set_uniform("modelMatrix", model);
+        shadow_program_.set_uniform("mvp", light_projection * light_view * model);
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
@@ -304,6 +314,15 @@ private:
         const auto view = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
         const auto mvp = projection * view * model;
 
+        // the shadow shader discards the same fragments as the strip shader,
+        // so it doubles as the pre-pass shader
+        if (prepass_.enabled()) {
+            prepass_.begin_depth();
+            shadow_program_.bind();
+            shadow_program_.set_uniform("mvp", mvp);
+            render_strips(shadow_program_, true);
+        }
+
         shadow_buffer_.bind_texture();
 
         program_.bind();
@@ -313,7 +332,12 @@ private:
         program_.set_uniform("lightViewProjection", light_projection * light_view);
         program_.set_uniform("shadowMapTexture", 0);
 
+        prepass_.begin_color();
         render_strips(program_, false);
+        prepass_.end();
+
+        if (report_overdraw_)
+            std::printf("overdraw: %.3f\n", prepass_.overdraw(window_width_, window_height_));
     }
 
     void render_strips(const gl::shader_program &program, bool shadow) const
@@ -345,8 +369,6 @@ private:
         }
     }
 
-    static constexpr auto NumStrips = 40;
-
     static constexpr auto ShadowWidth = 2048;
     static constexpr auto ShadowHeight = ShadowWidth;
 
@@ -364,12 +386,17 @@ private:
         float speed;
         float length;
     };
-    std::array<StripParams, NumStrips> params_;
+    std::vector<StripParams> params_;
     gl::shadow_buffer shadow_buffer_;
+    gl::depth_prepass prepass_;
+    bool report_overdraw_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
@@ -386,7 +413,7 @@ int main()
 #endif
 
     {
-        Demo d(window_width, window_height);
+        Demo d(window_width, window_height, parameters);
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -4,14 +4,14 @@ layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 uv;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+uniform mat4 mvp;
+
+invariant gl_Position;
 
 out vec2 vs_uv;
 
 void main(void)
 {
     vs_uv = uv;
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+    gl_Position = mvp * vec4(position, 1.0);
 }
@@ -8,6 +8,7 @@ out vec3 vs_position;
 out vec3 vs_normal;
 out vec2 vs_uv;
 out vec4 vs_positionInLightSpace;
+invariant gl_Position;
 
 uniform mat4 mvp;
 uniform mat4 modelMatrix;
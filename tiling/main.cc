@@ -7,6 +7,11 @@
 #include "util.h"
 #include "tween.h"
 #include "buffer.h"
+#include "framebuffer.h"
+#include "frame_graph.h"
+#include "frustum_culler.h"
+#include "random.h"
+#include "matrix.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -21,19 +26,27 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 class Demo : public gl::demo
 {
 public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
-        , hexagon_states_(GL_SHADER_STORAGE_BUFFER, GridRows * GridColumns)
-        , diamond_states_(GL_SHADER_STORAGE_BUFFER, (GridRows - 1) * (GridColumns - 1))
+        , shadow_size_(parameters_.get("shadow_size", 2048))
+        , grid_rows_(parameters_.get("rows", 12))
+        , grid_columns_(parameters_.get("columns", 15))
+        , shadow_buffer_(shadow_size_, shadow_size_)
+        , hexagon_states_(GL_SHADER_STORAGE_BUFFER, grid_rows_ * grid_columns_)
+        , diamond_states_(GL_SHADER_STORAGE_BUFFER, (grid_rows_ - 1) * (grid_columns_ - 1))
+        , graph_(framebuffer_pool_)
     {
         initialize_shader();
         initialize_geometry();
         initialize_heights();
+        initialize_frame_graph();
+        graph_.set_timing(report_timings_ || benchmark_frames_ > 0);
+        initialize_culling();
     }
 
 private:
@@ -75,12 +88,16 @@ private:
 
     void initialize_heights()
     {
-        std::generate(hexagon_heights_.begin(), hexagon_heights_.end(), [] {
-            return static_cast<float>(std::rand()) / RAND_MAX;
-        });
-        std::generate(diamond_heights_.begin(), diamond_heights_.end(), [] {
-            return static_cast<float>(std::rand()) / RAND_MAX;
-        });
+        const gl::random_stream random(parameters_.get("seed", 0));
+        const auto hexagon_random = random.substream(0);
+        const auto diamond_random = random.substream(1);
+
+        hexagon_heights_.resize(grid_rows_);
+        diamond_heights_.resize(grid_rows_ - 1);
+        for (std::size_t i = 0; i < hexagon_heights_.size(); ++i)
+            hexagon_heights_[i] = hexagon_random.uniform(i);
+        for (std::size_t i = 0; i < diamond_heights_.size(); ++i)
+            diamond_heights_[i] = diamond_random.uniform(i);
     }
 
     void update(float dt) override
@@ -88,70 +105,128 @@ private:
         cur_time_ += dt;
     }
 
+    void initialize_frame_graph()
+    {
+        const auto shadow_map = graph_.import_target("shadow map", shadow_size_, shadow_size_,
+                                                     [this] { shadow_buffer_.bind(); });
+        const auto screen = graph_.import_target("screen", width_, height_, [] { gl::framebuffer::unbind(); });
+
+        graph_.add_pass(
+                "shadow", [shadow_map](gl::frame_graph::builder &builder) { builder.write(shadow_map); },
+                [this](const gl::frame_graph::context &) { render_shadow(); });
+
+        graph_.add_pass(
+                "scene",
+                [shadow_map, screen](gl::frame_graph::builder &builder) {
+                    builder.read(shadow_map);
+                    builder.write(screen);
+                },
+                [this](const gl::frame_graph::context &) { render_scene(); });
+
+        graph_.compile();
+    }
+
+    void initialize_culling()
+    {
+        if (!frustum_culling_)
+            return;
+        hexagon_culler_.reset(new gl::frustum_culler(grid_rows_ * grid_columns_, NumViews));
+        diamond_culler_.reset(new gl::frustum_culler((grid_rows_ - 1) * (grid_columns_ - 1), NumViews));
+        hexagon_bounds_.resize(grid_rows_ * grid_columns_);
+        diamond_bounds_.resize((grid_rows_ - 1) * (grid_columns_ - 1));
+    }
+
+    const gl::frame_graph *graph() const override { return &graph_; }
+
     void render() override
     {
         glDisable(GL_BLEND);
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
 
-        const auto light_position = glm::vec3(-6, 4, 6);
-
         const auto cos_30 = std::cos(M_PI / 6.0);
-        const auto x_offset = std::fmod(static_cast<float>(cur_time_) / cycle_duration_, 1.0) * 4.0 * cos_30;
-        auto model =
+        x_offset_ = std::fmod(static_cast<float>(cur_time_) / cycle_duration_, 1.0) * 4.0 * cos_30;
+        model_ =
             glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25 * M_PI), glm::vec3(0, 0, 1)) *
-            glm::translate(glm::mat4(1.0f), glm::vec3(-x_offset, 0, 0));
+            glm::translate(glm::mat4(1.0f), glm::vec3(-x_offset_, 0, 0));
+
+        update_buffers(model_, x_offset_);
+        antialiasing_->set_view_projection(camera_view_projection());
 
-        update_buffers(model, x_offset);
+        if (frustum_culling_) {
+            const auto view_projections = { camera_view_projection(), light_view_projection() };
+            hexagon_culler_->set_bounds(hexagon_bounds_);
+            hexagon_culler_->cull(view_projections, 6);
+            diamond_culler_->set_bounds(diamond_bounds_);
+            diamond_culler_->cull(view_projections, 4);
+        }
 
-        // shadow
+        graph_.execute();
 
-        const auto light_projection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 50.0f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        if (frustum_culling_ && report_stats_) {
+            std::printf("hexagons visible %d/%d camera, %d/%d light; diamonds visible %d/%d camera, %d/%d light\n",
+                        hexagon_culler_->visible_count(CameraView), hexagon_culler_->instance_count(),
+                        hexagon_culler_->visible_count(LightView), hexagon_culler_->instance_count(),
+                        diamond_culler_->visible_count(CameraView), diamond_culler_->instance_count(),
+                        diamond_culler_->visible_count(LightView), diamond_culler_->instance_count());
+        }
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
-        shadow_buffer_.bind();
+        if (report_timings_)
+            graph_.print_timings();
+    }
 
+    glm::mat4 camera_view_projection() const
+    {
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
+        const auto camera_position = /* glm::vec3(0, 0, 7); */ glm::vec3(0, -6, 15);
+        const auto look_at = glm::vec3(0, 0, 0);
+        const auto view = glm::lookAt(camera_position, look_at, glm::vec3(0, 1, 0));
+        return projection * view;
+    }
+
+    glm::mat4 light_view_projection() const
+    {
+        const auto light_projection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 50.0f);
+        const auto light_view = glm::lookAt(light_position_, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        return light_projection * light_view;
+    }
+
+    void render_shadow() const
+    {
         glClear(GL_DEPTH_BUFFER_BIT);
 
         shadow_program_.bind();
-        shadow_program_.set_uniform("viewProjectionMatrix", light_projection * light_view);
+        shadow_program_.set_uniform("viewProjectionMatrix", light_view_projection());
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
         glDisable(GL_CULL_FACE);
-        draw_grid(shadow_program_, model, x_offset);
+        draw_grid(shadow_program_, LightView);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
-        shadow_buffer_.unbind();
-
-        // render
+    }
 
-        glViewport(0, 0, width_, height_);
+    void render_scene() const
+    {
         glClearColor(0, 0, 0, 0);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
-        const auto camera_position = /* glm::vec3(0, 0, 7); */ glm::vec3(0, -6, 15);
-        const auto look_at = glm::vec3(0, 0, 0);
-        const auto view = glm::lookAt(camera_position, look_at, glm::vec3(0, 1, 0));
-
         shadow_buffer_.bind_texture();
 
         program_.bind();
-        program_.set_uniform("viewProjectionMatrix", projection * view);
-        program_.set_uniform("lightPosition", light_position);
-        program_.set_uniform("lightViewProjection", light_projection * light_view);
+        program_.set_uniform("viewProjectionMatrix", camera_view_projection());
+        program_.set_uniform("lightPosition", light_position_);
+        program_.set_uniform("lightViewProjection", light_view_projection());
         program_.set_uniform("shadowMapTexture", 0);
 
         glEnable(GL_CULL_FACE);
-        draw_grid(program_, model, x_offset);
+        draw_grid(program_, CameraView);
     }
 
-    void update_buffers(const glm::mat4 &model, float x_offset) const
+    void update_buffers(const glm::mat4 &model, float x_offset)
     {
         const auto cos_30 = std::cos(M_PI / 6.0);
         constexpr const auto StepHeight = 3.0;
@@ -190,17 +265,27 @@ private:
             }
         };
 
+        // bounding sphere of a tile, from its base to its top face
+        const auto tile_bounds = [](const glm::mat4 &transform, float height, float radius) {
+            const auto center = transform * glm::vec4(0, 0, 0.5 * height, 1);
+            return glm::vec4(center.x, center.y, center.z, std::sqrt(radius * radius + 0.25 * height * height));
+        };
+
         // hexagons
 
         {
             auto *state = hexagon_states_.map();
-            for (int i = 0; i < GridRows; ++i) {
-                for (int j = 0; j < GridColumns; ++j) {
-                    const auto x = 2.0 * cos_30 * (j - (0.5 * (GridColumns - 1)));
-                    const auto y = 2.0 * (i - 0.5 * (GridRows - 1));
+            for (int i = 0; i < grid_rows_; ++i) {
+                for (int j = 0; j < grid_columns_; ++j) {
+                    const auto x = 2.0 * cos_30 * (j - (0.5 * (grid_columns_ - 1)));
+                    const auto y = 2.0 * (i - 0.5 * (grid_rows_ - 1));
                     const auto t = glm::translate(glm::mat4(1.0), glm::vec3(x, y, 0));
-                    state->transform = model * t;
-                    state->height = tile_height(x, hexagon_heights_[i]);
+                    const auto transform = gl::multiply_affine(model, t);
+                    const auto height = tile_height(x, hexagon_heights_[i]);
+                    state->transform = transform;
+                    state->height = height;
+                    if (frustum_culling_)
+                        hexagon_bounds_[i * grid_columns_ + j] = tile_bounds(transform, height, 1.0);
                     ++state;
                 }
             }
@@ -211,13 +296,17 @@ private:
 
         {
             auto *state = diamond_states_.map();
-            for (int i = 0; i < GridRows - 1; ++i) {
-                for (int j = 0; j < GridColumns - 1; ++j) {
-                    const auto x = 2.0 * cos_30 * (j - (0.5 * (GridColumns - 2)));
-                    const auto y = 2.0 * (i - 0.5 * (GridRows - 2));
+            for (int i = 0; i < grid_rows_ - 1; ++i) {
+                for (int j = 0; j < grid_columns_ - 1; ++j) {
+                    const auto x = 2.0 * cos_30 * (j - (0.5 * (grid_columns_ - 2)));
+                    const auto y = 2.0 * (i - 0.5 * (grid_rows_ - 2));
                     const auto t = glm::translate(glm::mat4(1.0), glm::vec3(x, y, 0));
-                    state->transform = model * t;
-                    state->height = tile_height(x, diamond_heights_[i]);
+                    const auto transform = gl::multiply_affine(model, t);
+                    const auto height = tile_height(x, diamond_heights_[i]);
+                    state->transform = transform;
+                    state->height = height;
+                    if (frustum_culling_)
+                        diamond_bounds_[i * (grid_columns_ - 1) + j] = tile_bounds(transform, height, cos_30);
                     ++state;
                 }
             }
@@ -225,29 +314,40 @@ private:
         }
     }
 
-    void draw_grid(const gl::shader_program &program, const glm::mat4 &model, float x_offset) const
+    void draw_grid(const gl::shader_program &program, int view) const
     {
+        program.set_uniform("culledInstances", frustum_culling_ ? 1 : 0);
+
         // hexagons
         hexagon_.bind();
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, hexagon_states_.handle());
-        glDrawArraysInstanced(GL_LINE_LOOP, 0, 6, GridRows * GridColumns);
+        if (frustum_culling_)
+            hexagon_culler_->draw(view, 1, GL_LINE_LOOP);
+        else
+            glDrawArraysInstanced(GL_LINE_LOOP, 0, 6, grid_rows_ * grid_columns_);
 
         // diamonds
         diamond_.bind();
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, diamond_states_.handle());
-        glDrawArraysInstanced(GL_LINE_LOOP, 0, 4, (GridRows - 1) * (GridColumns - 1));
+        if (frustum_culling_)
+            diamond_culler_->draw(view, 1, GL_LINE_LOOP);
+        else
+            glDrawArraysInstanced(GL_LINE_LOOP, 0, 4, (grid_rows_ - 1) * (grid_columns_ - 1));
     }
 
     static constexpr auto NumStrips = 3;
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    int shadow_size_;
+
+    int grid_rows_;
+    int grid_columns_;
 
-    static constexpr auto GridRows = 12;
-    static constexpr auto GridColumns = 15;
+    static constexpr auto CameraView = 0;
+    static constexpr auto LightView = 1;
+    static constexpr auto NumViews = 2;
 
-    std::array<float, GridRows> hexagon_heights_;
-    std::array<float, GridRows - 1> diamond_heights_;
+    std::vector<float> hexagon_heights_;
+    std::vector<float> diamond_heights_;
 
     float cur_time_ = 0;
     gl::shader_program program_;
@@ -263,6 +363,14 @@ private:
     };
     gl::buffer<TileState> hexagon_states_;
     gl::buffer<TileState> diamond_states_;
+    gl::frame_graph graph_;
+    glm::vec3 light_position_ = glm::vec3(-6, 4, 6);
+    glm::mat4 model_;
+    float x_offset_;
+    std::unique_ptr<gl::frustum_culler> hexagon_culler_;
+    std::unique_ptr<gl::frustum_culler> diamond_culler_;
+    std::vector<glm::vec4> hexagon_bounds_;
+    std::vector<glm::vec4> diamond_bounds_;
 };
 
 int main(int argc, char *argv[])
@@ -0,0 +1,88 @@
+#include "window.h"
+#include "command_trace.h"
+#include "gpu_timer.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+#include <unistd.h>
+
+// replays a command trace recorded with -p trace=path and reports the GPU
+// time of every frame, and the CPU time spent submitting it, which is only
+// the driver's: the demo's simulation and scene traversal aren't in the
+// trace. -l replays the frames several times, -q prints the summary only.
+//
+//   trace-replay [-l loops] [-q] path
+
+namespace {
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+}
+
+void summarize(const char *name, std::vector<double> ms)
+{
+    std::sort(ms.begin(), ms.end());
+    const auto mean = std::accumulate(ms.begin(), ms.end(), 0.0) / ms.size();
+    std::printf(" %s_mean_ms=%.3f %s_p50_ms=%.3f %s_p90_ms=%.3f %s_max_ms=%.3f", name, mean, name,
+                percentile(ms, 0.5), name, percentile(ms, 0.9), name, ms.back());
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = 1;
+    bool quiet = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:q")) != -1) {
+        switch (opt)
+        {
+        case 'l':
+            loops = std::atoi(optarg);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        }
+    }
+    if (optind >= argc) {
+        std::fprintf(stderr, "usage: %s [-l loops] [-q] trace\n", argv[0]);
+        return 1;
+    }
+
+    gl::command_replay replay(argv[optind]);
+    gl::window w(replay.width(), replay.height(), "trace-replay", false);
+
+    replay.setup();
+    glFinish();
+
+    gl::gpu_timer timer;
+    std::vector<double> gpu_ms, submit_ms;
+    for (int loop = 0; loop < loops; ++loop) {
+        for (int i = 0; i < replay.frame_count(); ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            timer.begin();
+            replay.frame(i);
+            timer.end();
+            const auto submitted = std::chrono::steady_clock::now();
+
+            gpu_ms.push_back(timer.elapsed_ms());
+            submit_ms.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+            if (!quiet)
+                std::printf("frame %d: gpu %.3f ms, submit %.3f ms\n", i, gpu_ms.back(), submit_ms.back());
+        }
+    }
+
+    std::printf("replay: frames=%zu", gpu_ms.size());
+    summarize("gpu", gpu_ms);
+    summarize("submit", submit_ms);
+    std::printf("\n");
+}
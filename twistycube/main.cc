@@ -7,8 +7,8 @@
 #include <shadow_buffer.h>
 #include <util.h>
 #include <tween.h>
-
-#include "blur_effect.h"
+#include <blur_effect.h>
+#include <random.h>
 
 #include <GL/glew.h>
 
@@ -38,12 +38,12 @@ struct Bezier
     }
 };
 
-glm::vec3 rand_point()
+glm::vec3 rand_point(const gl::random_stream &random, int index)
 {
-    const auto r = [] {
-        return 2.0f * static_cast<float>(std::rand()) / RAND_MAX - 1.0f;
+    const auto r = [&random, index](int component) {
+        return random.uniform(3 * index + component, -1.0f, 1.0f);
     };
-    return glm::vec3(r(), r(), r()) * 1.5f;
+    return glm::vec3(r(0), r(1), r(2)) * 1.5f;
 }
 
 class Demo : public gl::demo
@@ -62,7 +62,10 @@ public:
 
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
+        , random_(parameters_.get("seed", 0))
     {
+        default_antialiasing_ = "none";
+
         geometry_.set_data(std::vector<Vertex>(Edge::ControlPointCount * SegmentPoints));
 
         const auto v0 = glm::vec3(-1, -1, 1);
@@ -92,7 +95,16 @@ public:
 
         initialize_shader();
 
-        blur_.reset(new blur_effect(width_, height_));
+        // glow is blurred anyway, run it at half resolution with half the kernel.
+        // an HDR target keeps the faint tails from banding, glow_exposure tone
+        // maps the composite
+        const gl::framebuffer_format glow_format = {
+            { gl::color_format(parameters_.get("glow_format", "r11f_g11f_b10f")) } };
+        const int glow_scale = parameters_.get("glow_scale", 2);
+        blur_.reset(new gl::blur_effect(framebuffer_pool_, width_ / glow_scale, height_ / glow_scale, 2, 1.0f,
+                                        glow_format));
+        blur_->set_exposure(parameters_.get("glow_exposure", 0.0f));
+        glow_passes_ = parameters_.get("glow_passes", 1);
     }
 
 private:
@@ -112,18 +124,18 @@ private:
     {
         glDisable(GL_CULL_FACE);
         glDisable(GL_DEPTH_TEST);
-        glDisable(GL_MULTISAMPLE);
 
         glViewport(0, 0, width_, height_);
         glClearColor(0, 0, 0, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
         const auto eye = glm::vec3(3, 3, 3);
         const auto center = glm::vec3(0, 0, 0);
         const auto up = glm::vec3(0, 1, 0);
         const auto view = glm::lookAt(eye, center, up);
+        antialiasing_->set_view_projection(projection * view);
 
 #if 1
         const float angle = 0.5f * sinf(cur_time_ * 2.f * M_PI / cycle_duration_);
@@ -137,7 +149,7 @@ private:
         program_.set_uniform("mvp", projection * view * model);
 
         glEnable(GL_LINE_SMOOTH);
-        glLineWidth(8.0);
+        glLineWidth(8.0f * blur_->width() / width_);
 
         const auto render_blurry = [this](const glm::vec4 &color, int num_passes) {
             program_.set_uniform("color", color);
@@ -156,7 +168,7 @@ private:
         glViewport(0, 0, width_, height_);
         glClearColor(0.25, 0.25, 0.25, 1);
         glClear(GL_COLOR_BUFFER_BIT);
-        render_blurry(glm::vec4(1, 1, 1, 1), 1);
+        render_blurry(glm::vec4(1, 1, 1, 1), glow_passes_);
 
 #if 0
         glLineWidth(2.0);
@@ -223,28 +235,30 @@ private:
 
     Edge make_edge(const glm::vec3 &v0, const glm::vec3 &v1) const
     {
+        // a stream per edge
+        const auto random = random_.substream(edges_.size());
         Edge e;
         for (int i = 0; i < Edge::ControlPointCount; ++i)
         {
             const auto t = static_cast<float>(i) / (Edge::ControlPointCount - 1);
             e.control_points[i][0] = v0 + t * (v1 - v0);
             for (int j = 1; j < Edge::NumStates; ++j)
-                e.control_points[i][j] = rand_point();
+                e.control_points[i][j] = rand_point(random, i * Edge::NumStates + j);
         }
         return e;
     }
 
+    gl::random_stream random_;
     float cur_time_;
     gl::geometry geometry_;
     std::vector<Edge> edges_;
     gl::shader_program program_;
-    std::unique_ptr<blur_effect> blur_;
+    std::unique_ptr<gl::blur_effect> blur_;
+    int glow_passes_;
 };
 
 int main(int argc, char *argv[])
 {
-    std::srand(time(nullptr));
-
     Demo d(argc, argv);
     d.run();
 }
@@ -4,9 +4,20 @@
 #include "geometry.h"
 #include "shader_program.h"
 #include "util.h"
+#include "parameters.h"
+#include "antialiasing.h"
+#include "benchmark.h"
 #include "buffer.h"
+#include "framebuffer_pool.h"
+#include "weighted_oit.h"
+#include "occlusion_culler.h"
+#include "frustum_culler.h"
+#include "software_rasterizer.h"
+#include "software_target.h"
 
 #include "tween.h"
+#include "random.h"
+#include "matrix.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -21,7 +32,6 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
-#include <random>
 
 // #define DUMP_FRAMES
 
@@ -39,6 +49,8 @@ public:
     {
         initialize_geometry();
         geometry_.set_data(verts_);
+        for (const auto &[position, normal] : verts_)
+            software_verts_.push_back({ position, normal, glm::vec3(1) });
     }
 
     void render(int instance_count) const
@@ -47,6 +59,11 @@ public:
         glDrawArraysInstanced(GL_TRIANGLES, 0, verts_.size(), instance_count);
     }
 
+    void bind() const { geometry_.bind(); }
+    int vertex_count() const { return verts_.size(); }
+    // white, the instance colors tint them
+    const std::vector<gl::software_rasterizer::vertex> &software_verts() const { return software_verts_; }
+
 private:
     void initialize_geometry()
     {
@@ -84,34 +101,86 @@ private:
 
     using vertex = std::tuple<glm::vec3, glm::vec3>; // position, normal, texuv
     std::vector<vertex> verts_;
+    std::vector<gl::software_rasterizer::vertex> software_verts_;
     gl::geometry geometry_;
 };
 
 class demo
 {
 public:
-    demo(int window_width, int window_height)
+    demo(int window_width, int window_height, const gl::parameters &parameters)
         : window_width_(window_width)
         , window_height_(window_height)
-        , states_(GL_SHADER_STORAGE_BUFFER, GridSize * GridSize * GridSize)
+        , grid_size_(parameters.get("grid", 5))
+        , cell_size_(1.f / grid_size_)
+        , states_(GL_SHADER_STORAGE_BUFFER, grid_size_ * grid_size_ * grid_size_)
         , cube_(new cube_geometry)
     {
         initialize_shader();
 
-        std::random_device device;
-        std::mt19937 generator(device());
-        std::uniform_real_distribution<float> distribution(0.5, 1.5);
+        // -p software=1: draw the instances on the cpu and only draw the
+        // result
+        set_software(parameters.get("software", 0) != 0);
+
+        // -p oit=1: the fading cubes in any order with weighted blended
+        // order-independent transparency
+        if (parameters.get("oit", 0) != 0)
+            oit_.reset(new gl::weighted_oit(framebuffer_pool_, window_width_, window_height_));
+
+        // -p culling=frustum culls the instances against the view frustum,
+        // -p culling=hiz against the previous frame's depth pyramid too.
+        // both print how many are visible every second
+        const auto culling = parameters.get("culling", "none");
+        if (culling == "frustum")
+            frustum_culler_.reset(new gl::frustum_culler(grid_size_ * grid_size_ * grid_size_, 1));
+        else if (culling == "hiz")
+            occlusion_culler_.reset(
+                    new gl::occlusion_culler(window_width_, window_height_, grid_size_ * grid_size_ * grid_size_));
+        else if (culling != "none")
+            panic("unknown culling %s, expected none, frustum or hiz\n", culling.c_str());
+        if (occlusion_culler_ || frustum_culler_)
+            bounds_.resize(grid_size_ * grid_size_ * grid_size_);
+
+        const gl::random_stream random(parameters.get("seed", 0));
+
+        collapse_start_.resize(grid_size_ * grid_size_ * grid_size_);
+        for (std::size_t i = 0; i < collapse_start_.size(); ++i)
+            collapse_start_[i] = random.uniform(i, 0.5f, 1.5f);
+    }
+
+    void set_software(bool software)
+    {
+        if (!software) {
+            software_.reset();
+            return;
+        }
+        if (!software_) {
+            software_.reset(new gl::software_rasterizer(window_width_, window_height_));
+            software_target_.reset(new gl::software_target(window_width_, window_height_));
+            software_instances_.resize(grid_size_ * grid_size_ * grid_size_);
+        }
+    }
 
-        collapse_start_.resize(GridSize * GridSize * GridSize);
-        std::generate(collapse_start_.begin(), collapse_start_.end(), [&distribution, &generator] {
-            return distribution(generator);
-        });
+    void render_at(float time)
+    {
+        cur_time_ = time;
+        framebuffer_pool_.begin_frame();
+        render();
     }
 
     void render_and_step(float dt)
     {
-        render(program_);
+        framebuffer_pool_.begin_frame();
+        render();
         cur_time_ += dt;
+        if (++frame_count_ % FramesPerSecond == 0) {
+            if (occlusion_culler_)
+                std::printf("%d of %d instances visible\n", occlusion_culler_->visible_count(),
+                            occlusion_culler_->instance_count());
+            else if (frustum_culler_)
+                std::printf("%d of %d instances visible\n", frustum_culler_->visible_count(0),
+                            frustum_culler_->instance_count());
+        }
     }
 
 private:
@@ -119,13 +188,33 @@ private:
     {
         program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
         program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
+        program_.add_shader(GL_FRAGMENT_SHADER, "shaders/output.frag");
         program_.link();
+
+        oit_program_.add_shader(GL_VERTEX_SHADER, "shaders/sphere.vert");
+        oit_program_.add_shader(GL_FRAGMENT_SHADER, "shaders/sphere.frag");
+        gl::weighted_oit::attach_output(oit_program_);
+        oit_program_.link();
     }
 
-    void render(const gl::shader_program &program) const
+    void render()
     {
         update_grid_state();
 
+        const auto projection =
+                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
+        const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
+        const auto view_up = glm::vec3(0, 1, 0);
+        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
+
+        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
+        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1));
+
+        if (software_) {
+            render_software(projection * view * model, model, view_pos);
+            return;
+        }
+
         glViewport(0, 0, window_width_, window_height_);
         glClearColor(0.75, 0.75, 0.75, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -140,40 +229,81 @@ private:
 
         glEnable(GL_CULL_FACE);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(window_width_) / window_height_, 0.1f, 100.f);
-        const auto view_pos = glm::vec3(1.5, -1.5, 1.5);
-        const auto view_up = glm::vec3(0, 1, 0);
-        const auto view = glm::lookAt(view_pos, glm::vec3(0, 0, 0), view_up);
-
-        const float angle = 0.3f * cosf(cur_time_ * 2.f * M_PI / CycleDuration);
-        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(-1, 1, 1));
+        if (occlusion_culler_) {
+            occlusion_culler_->set_bounds(bounds_);
+            occlusion_culler_->cull(projection * view * model, cube_->vertex_count());
+        } else if (frustum_culler_) {
+            frustum_culler_->set_bounds(bounds_);
+            frustum_culler_->cull({ projection * view * model }, cube_->vertex_count());
+        }
 
-        program.bind();
-        program.set_uniform(program.uniform_location("modelMatrix"), model);
-        program.set_uniform(program.uniform_location("viewMatrix"), view);
-        program.set_uniform(program.uniform_location("projectionMatrix"), projection);
-        program.set_uniform(program.uniform_location("eyePosition"), view_pos);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, states_.handle());
-
         glCullFace(GL_BACK);
-        cube_->render(GridSize * GridSize * GridSize);
+
+        const auto draw_cubes = [&](const gl::shader_program &program, int alpha_filter) {
+            program.bind();
+            program.set_uniform(program.uniform_location("modelMatrix"), model);
+            program.set_uniform(program.uniform_location("viewMatrix"), view);
+            program.set_uniform(program.uniform_location("projectionMatrix"), projection);
+            program.set_uniform(program.uniform_location("eyePosition"), view_pos);
+            program.set_uniform(program.uniform_location("alphaFilter"), alpha_filter);
+            if (occlusion_culler_) {
+                program.set_uniform(program.uniform_location("culledInstances"), 1);
+                cube_->bind();
+                occlusion_culler_->draw(1);
+            } else if (frustum_culler_) {
+                program.set_uniform(program.uniform_location("culledInstances"), 1);
+                cube_->bind();
+                frustum_culler_->draw(0, 1);
+            } else {
+                program.set_uniform(program.uniform_location("culledInstances"), 0);
+                cube_->render(grid_size_ * grid_size_ * grid_size_);
+            }
+        };
+
+        if (oit_) {
+            // opaque cubes first, then the fading ones in any order
+            glDisable(GL_BLEND);
+            draw_cubes(program_, 1);
+
+            oit_->bind();
+            draw_cubes(oit_program_, 2);
+            oit_->render();
+        } else {
+            draw_cubes(program_, 0);
+        }
+
+        if (occlusion_culler_)
+            occlusion_culler_->build_depth_pyramid();
+    }
+
+    // the state of render(): back faces culled, the fading cubes blended in
+    // instance order, sphere.frag's lighting
+    void render_software(const glm::mat4 &mvp, const glm::mat4 &model, const glm::vec3 &view_pos)
+    {
+        software_->set_state({ true, true, true });
+        software_->set_lighting({ glm::vec3(2, -3, 1), 0.15f, false, 0.5f, 0.5f, 8.0f, view_pos });
+        software_->clear(glm::vec4(0.75, 0.75, 0.75, 0));
+        software_->draw_instanced(cube_->software_verts(), 0, cube_->vertex_count(),
+                                  { mvp, model, glm::mat3(model) }, software_instances_);
+        software_->finish();
+        software_target_->draw(*software_);
     }
 
-    void update_grid_state() const
+    void update_grid_state()
     {
         const auto time = fmod(cur_time_, CycleDuration);
 
-        constexpr const auto CenterEntity = (GridSize / 2) * GridSize * GridSize + (GridSize / 2) * GridSize + (GridSize / 2);
+        const auto center_entity = (grid_size_ / 2) * grid_size_ * grid_size_ + (grid_size_ / 2) * grid_size_ + (grid_size_ / 2);
 
         auto *state = states_.map();
 
-        for (int i = 0; i < GridSize; ++i) {
-            for (int j = 0; j < GridSize; ++j) {
-                for (int k = 0; k < GridSize; ++k) {
-                    const auto index = i * GridSize * GridSize + j * GridSize + k;
+        for (int i = 0; i < grid_size_; ++i) {
+            for (int j = 0; j < grid_size_; ++j) {
+                for (int k = 0; k < grid_size_; ++k) {
+                    const auto index = i * grid_size_ * grid_size_ + j * grid_size_ + k;
                     float scale, alpha;
-                    if (index != CenterEntity) {
+                    if (index != center_entity) {
                         const auto start = collapse_start_[index];
                         if (time < start) {
                             scale = 1;
@@ -192,23 +322,29 @@ private:
                         if (time < ExpansionStart) {
                             scale = 1;
                         } else if (time > ExpansionStart + ExpansionDuration) {
-                            scale = static_cast<float>(GridSize);
+                            scale = static_cast<float>(grid_size_);
                         } else {
                             const auto t = (time - ExpansionStart) / ExpansionDuration;
-                            scale = 1 + out_bounce(t) * (static_cast<float>(GridSize) - 1);
+                            scale = 1 + out_bounce(t) * (static_cast<float>(grid_size_) - 1);
                         }
                         alpha = 1;
                     }
 
-                    const auto v = CellSize * (glm::vec3(i, j, k) - 0.5f * glm::vec3(GridSize - 1));
+                    const auto v = cell_size_ * (glm::vec3(i, j, k) - 0.5f * glm::vec3(grid_size_ - 1));
                     const auto translate_matrix = glm::translate(glm::mat4(1.0), v);
-                    const auto scale_matrix = glm::scale(glm::mat4(1.0), glm::vec3(scale * 0.5 * CellSize));
+                    const auto scale_matrix = glm::scale(glm::mat4(1.0), glm::vec3(scale * 0.5 * cell_size_));
 
                     const auto diffuse_color = glm::vec3(1.0, 0.0, 0.0);
 
-                    state->transform = translate_matrix * scale_matrix;
-                    state->color = glm::vec4(diffuse_color, alpha);
+                    const auto transform = gl::multiply_affine(translate_matrix, scale_matrix);
+                    const auto color = glm::vec4(diffuse_color, alpha);
+                    state->transform = transform;
+                    state->color = color;
                     ++state;
+                    if (software_)
+                        software_instances_[index] = { transform, color };
+                    if (!bounds_.empty())
+                        bounds_[index] = glm::vec4(v, std::sqrt(3.0f) * scale * 0.5f * cell_size_);
                 }
             }
         }
@@ -216,8 +352,6 @@ private:
         states_.unmap();
     }
 
-    static constexpr auto GridSize = 5;
-    static constexpr auto CellSize = 1.f / GridSize;
     static constexpr auto CollapseDuration = 0.5f;
 
     struct entity_state {
@@ -226,20 +360,36 @@ private:
     };
     int window_width_;
     int window_height_;
+    int grid_size_;
+    float cell_size_;
     float cur_time_ = 0;
     gl::shader_program program_;
+    gl::framebuffer_pool framebuffer_pool_;
+    gl::shader_program oit_program_;
+    std::unique_ptr<gl::weighted_oit> oit_; // only with -p oit=1
+    std::unique_ptr<gl::occlusion_culler> occlusion_culler_;
+    std::unique_ptr<gl::frustum_culler> frustum_culler_;
+    std::vector<glm::vec4> bounds_; // empty without culling
+    int frame_count_ = 0;
     static_assert(sizeof(glm::mat4) == 16 * sizeof(float));
     gl::buffer<entity_state> states_;
     std::unique_ptr<cube_geometry> cube_;
     std::vector<float> collapse_start_;
+    std::unique_ptr<gl::software_rasterizer> software_;
+    std::unique_ptr<gl::software_target> software_target_;
+    std::vector<gl::software_rasterizer::instance> software_instances_;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
+    gl::parameters parameters;
+    parameters.parse_arguments(argc, argv);
+
     constexpr auto window_width = 800;
     constexpr auto window_height = 800;
 
-    gl::window w(window_width, window_height, "demo");
+    const auto benchmark_frames = parameters.get("benchmark", 0);
+    gl::window w(window_width, window_height, "demo", benchmark_frames == 0);
 
     glfwSetKeyCallback(w, [](GLFWwindow *window, int key, int scancode, int action, int mode) {
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -252,7 +402,28 @@ int main()
 #endif
 
     {
-        demo d(window_width, window_height);
+        demo d(window_width, window_height, parameters);
+        gl::antialiasing antialiasing(gl::antialiasing::multisample(parameters.get("samples", 4)), window_width,
+                                      window_height);
+
+        // -p software_check=N: golden frame diff of the cpu renderer against
+        // the GPU, fails if more than N percent of the pixels differ. run
+        // with -p samples=0 so edges are comparable. the frame is
+        // -p software_check_time seconds in, while cubes fade
+        if (const auto tolerance = parameters.get("software_check", 0.0f); tolerance > 0) {
+            const auto time = parameters.get("software_check_time", 1.0f);
+            const auto differing = gl::compare_software(window_width, window_height, [&](bool software) {
+                d.set_software(software);
+                antialiasing.begin_frame();
+                d.render_at(time);
+                antialiasing.end_frame();
+            });
+            return differing > tolerance ? 1 : 0;
+        }
+
+        std::unique_ptr<gl::benchmark> benchmark;
+        if (benchmark_frames > 0)
+            benchmark.reset(new gl::benchmark(benchmark_frames));
 
 #ifndef DUMP_FRAMES
         double curTime = glfwGetTime();
@@ -260,12 +431,17 @@ int main()
         while (!glfwWindowShouldClose(w)) {
 #ifndef DUMP_FRAMES
             auto now = glfwGetTime();
-            const auto dt = now - curTime;
+            const auto dt = benchmark ? 1.0 / FramesPerSecond : now - curTime;
             curTime = now;
 #else
             constexpr auto dt = 1.0f / FramesPerSecond;
 #endif
+            if (benchmark)
+                benchmark->begin_frame();
+
+            antialiasing.begin_frame();
             d.render_and_step(dt);
+            antialiasing.end_frame();
 
 #ifdef DUMP_FRAMES
             char path[80];
@@ -278,6 +454,14 @@ int main()
 
             glfwSwapBuffers(w);
             glfwPollEvents();
+
+            if (benchmark) {
+                benchmark->end_frame();
+                if (benchmark->done()) {
+                    benchmark->report();
+                    break;
+                }
+            }
         }
     }
 }
@@ -0,0 +1,8 @@
+#version 450 core
+
+out vec4 frag_color;
+
+void writeColor(vec4 color)
+{
+    frag_color = color;
+}
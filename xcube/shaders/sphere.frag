@@ -13,7 +13,7 @@ const vec3 light_color = vec3(1.0, 1.0, 1.0);
 const float kd = 0.5;
 const float ks = 0.5;
 
-out vec4 frag_color;
+void writeColor(vec4 color);
 
 void main(void)
 {
@@ -26,5 +26,5 @@ void main(void)
     if (diffuse_light <= 0.0)
         specular_light = 0.0;
     vec3 specular = ks * specular_light * light_color;
-    frag_color = vec4(ambient + diffuse + specular, vs_color.w);
+    writeColor(vec4(ambient + diffuse + specular, vs_color.w));
 }
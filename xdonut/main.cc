@@ -22,15 +22,17 @@
 class DonutGeometry
 {
 public:
-    DonutGeometry()
+    DonutGeometry(int num_segments_outer, int num_segments_inner)
+        : num_segments_outer_(num_segments_outer)
+        , num_segments_inner_(num_segments_inner)
     {
-        geometry_.set_data(std::vector<Vertex>(VertexCount));
+        geometry_.set_data(std::vector<Vertex>(vertex_count()));
     }
 
     void render() const
     {
         geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, VertexCount);
+        glDrawArrays(GL_TRIANGLES, 0, vertex_count());
     }
 
     void update_verts(float angle_offset, float u_offset) const
@@ -38,14 +40,14 @@ public:
         glBindBuffer(GL_ARRAY_BUFFER, geometry_.array_buffer_handle());
         auto *verts = static_cast<Vertex *>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
 
-        for (int i = 0; i < NumSegmentsOuter; ++i)
+        for (int i = 0; i < num_segments_outer_; ++i)
         {
-            for (int j = 0; j < NumSegmentsInner; ++j)
+            for (int j = 0; j < num_segments_inner_; ++j)
             {
-                const auto vert_at = [angle_offset](int i, int j) -> std::tuple<glm::vec3, glm::vec3> {
-                    const float a = static_cast<float>(i) * 2.0 * M_PI / NumSegmentsOuter;
+                const auto vert_at = [this, angle_offset](int i, int j) -> std::tuple<glm::vec3, glm::vec3> {
+                    const float a = static_cast<float>(i) * 2.0 * M_PI / num_segments_outer_;
 
-                    float b = static_cast<float>(j) * 2.0 * M_PI / NumSegmentsInner + a + angle_offset;
+                    float b = static_cast<float>(j) * 2.0 * M_PI / num_segments_inner_ + a + angle_offset;
 
                     const auto p = glm::vec3(cosf(a) * DonutRadius, sinf(a) * DonutRadius, 0.0);
 
@@ -58,8 +60,8 @@ public:
                     return {pos, normal};
                 };
 
-                const auto i1 = (i + 1) % NumSegmentsOuter;
-                const auto j1 = (j + 1) % NumSegmentsInner;
+                const auto i1 = (i + 1) % num_segments_outer_;
+                const auto j1 = (j + 1) % num_segments_inner_;
 
                 const auto [v0, n0] = vert_at(i, j);
                 const auto [v1, n1] = vert_at(i1, j);
@@ -69,11 +71,11 @@ public:
                 const auto na = glm::normalize(n0 + n3);
                 const auto nb = glm::normalize(n1 + n2);
 
-                const auto s0 = 4.0 * (static_cast<float>(i) / NumSegmentsOuter + u_offset);
-                const auto s1 = 4.0 * (static_cast<float>(i + 1) / NumSegmentsOuter + u_offset);
+                const auto s0 = 4.0 * (static_cast<float>(i) / num_segments_outer_ + u_offset);
+                const auto s1 = 4.0 * (static_cast<float>(i + 1) / num_segments_outer_ + u_offset);
 
-                const auto t0 = static_cast<float>(j) / NumSegmentsInner;
-                const auto t1 = static_cast<float>(j + 1) / NumSegmentsInner;
+                const auto t0 = static_cast<float>(j) / num_segments_inner_;
+                const auto t1 = static_cast<float>(j + 1) / num_segments_inner_;
 
                 *verts++ = {v0, na, {s0, t0}};
                 *verts++ = {v1, nb, {s1, t0}};
@@ -92,10 +94,10 @@ private:
     static constexpr float DonutRadius = 1.0f;
     static constexpr float DonutSmallRadius = 0.3f;
 
-    static constexpr int NumSegmentsOuter = 128;
-    static constexpr int NumSegmentsInner = 4;
+    int vertex_count() const { return num_segments_outer_ * num_segments_inner_ * 6; }
 
-    static constexpr int VertexCount = NumSegmentsOuter * NumSegmentsInner * 6;
+    int num_segments_outer_;
+    int num_segments_inner_;
 
     using Vertex = std::tuple<glm::vec3, glm::vec3, glm::vec2>; // position, normal, uv
     gl::geometry geometry_;
@@ -106,6 +108,7 @@ class Demo : public gl::demo
 public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
+        , geometry_(parameters_.get("outer_segments", 128), parameters_.get("inner_segments", 4))
     {
         initialize_shader();
     }
@@ -151,10 +154,11 @@ private:
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
         const auto view = glm::lookAt(glm::vec3(0, 0, 4), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
         const auto mvp = projection * view * model;
+        antialiasing_->set_view_projection(projection * view);
 
         program_.bind();
         program_.set_uniform("mvp", mvp);
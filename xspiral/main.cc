@@ -153,15 +153,16 @@ public:
     {
         initialize_shader();
 
-        static const std::array<glm::vec3, NumStrips> colors =
+        static const std::array<glm::vec3, 3> colors =
             // {glm::vec3(1, 0, 1), glm::vec3(1, 0, 1), glm::vec3(1, 0.5, 1)};
             {glm::vec3(0x45, 0x3f, 0x78), glm::vec3(0x75, 0x9a, 0xab), glm::vec3(0xfa, 0xf2, 0xa1)};
 
-        for (int i = 0; i < NumStrips; ++i)
+        const auto num_strips = parameters_.get("strips", 3);
+        for (int i = 0; i < num_strips; ++i)
         {
             std::unique_ptr<Strip> strip(new Strip);
 
-            const float a = static_cast<float>(i) * 2.0f * M_PI / NumStrips;
+            const float a = static_cast<float>(i) * 2.0f * M_PI / num_strips;
             const auto coil_radius = 0.2f;
             strip->geometry.reset(new StripGeometry(a, coil_radius));
 
@@ -169,7 +170,7 @@ public:
             strip->speed = static_cast<float>(1) / cycle_duration_ / CircleVerts;
             strip->length = 0.75f;
             strip->color = // colors[i];
-                (1.f / 255) * colors[i]; // glm::vec3(frand(), frand(), frand()) * 0.5f + glm::vec3(0.5f);
+                (1.f / 255) * colors[i % colors.size()]; // glm::vec3(frand(), frand(), frand()) * 0.5f + glm::vec3(0.5f);
 
             strips_.push_back(std::move(strip));
         }
@@ -215,10 +216,11 @@ private:
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
         const auto view = glm::lookAt(glm::vec3(0, 0, 4), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
         const auto mvp = projection * view * model;
+        antialiasing_->set_view_projection(projection * view);
 
         program_.bind();
         program_.set_uniform("mvp", mvp);
@@ -248,8 +250,6 @@ private:
         }
     }
 
-    static constexpr auto NumStrips = 3;
-
     static constexpr auto ShadowWidth = 2048;
     static constexpr auto ShadowHeight = ShadowWidth;
 
@@ -3,6 +3,10 @@
 #include <tween.h>
 #include <geometry.h>
 #include <shadow_buffer.h>
+#include <buffer.h>
+#include <frustum_culler.h>
+#include <random.h>
+#include <matrix.h>
 
 #include <GL/glew.h>
 
@@ -13,19 +17,29 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
 
-#include <random>
 #include <algorithm>
+#include <memory>
+#include <vector>
 
 class Demo : public gl::demo
 {
 public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , shadow_size_(parameters_.get("shadow_size", 2048))
+        , grid_rows_(parameters_.get("rows", 25))
+        , grid_columns_(parameters_.get("columns", 25))
+        , shadow_buffer_(shadow_size_, shadow_size_)
+        , tile_transforms_(GL_SHADER_STORAGE_BUFFER, grid_rows_ * grid_columns_)
+        , transforms_(grid_rows_ * grid_columns_)
     {
         initialize_shader();
         initialize_geometry();
         initialize_flips();
+        if (frustum_culling_) {
+            culler_.reset(new gl::frustum_culler(grid_rows_ * grid_columns_, NumViews));
+            bounds_.resize(grid_rows_ * grid_columns_);
+        }
     }
 
 private:
@@ -67,28 +81,27 @@ private:
 
     void initialize_flips()
     {
-        std::random_device device;
-        std::mt19937 generator(device());
-        std::normal_distribution<> d0(0.25 * cycle_duration_, 0.125);
-        std::normal_distribution<> d1(0.75 * cycle_duration_, 0.125);
+        const gl::random_stream random(parameters_.get("seed", 0));
 
-        for (int i = 0; i < GridRows; ++i)
+        flip_start_.resize(grid_rows_ * grid_columns_);
+        for (int i = 0; i < grid_rows_; ++i)
         {
-            for (int j = 0; j < GridColumns; ++j)
+            for (int j = 0; j < grid_columns_; ++j)
             {
-                auto x = 2.0 * (j - (0.5 * GridColumns -1));
+                auto x = 2.0 * (j - (0.5 * grid_columns_ -1));
                 if (i % 2)
                     x += 1.0;
-                const auto y = 1.5 * (i - 0.5 * (GridRows - 1));
+                const auto y = 1.5 * (i - 0.5 * (grid_rows_ - 1));
 
                 const auto d = glm::length(glm::vec2(x, y));
 
-                auto &animation = flip_start_[i][j];
+                const int tile = i * grid_columns_ + j;
+                auto &animation = flip_start_[tile];
                 animation.s0 = 0.25 * cycle_duration_ + 0.03 * d;
                 animation.s1 = 0.75 * cycle_duration_ + 0.03 * d;
-                animation.flop = rand() % 4;
-                animation.h0 = 3.0 + 5.0 * static_cast<float>(rand()) / RAND_MAX;
-                animation.h1 = 3.0 + 5.0 * static_cast<float>(rand()) / RAND_MAX;
+                animation.flop = random.below(3 * tile, 4);
+                animation.h0 = random.uniform(3 * tile + 1, 3.0f, 8.0f);
+                animation.h1 = random.uniform(3 * tile + 2, 3.0f, 8.0f);
             }
         }
     }
@@ -113,12 +126,29 @@ private:
         auto model = glm::rotate(glm::mat4(1.0f), static_cast<float>(0.25 * M_PI), glm::vec3(0, 0, 1));
 #endif
 
-        // shadow
-
         const auto light_projection = glm::ortho(-15.0f, 15.0f, -15.0f, 15.0f, 1.0f, 50.0f);
         const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
+        const auto camera_position = /* glm::vec3(0, 0, 7); */ glm::vec3(0, -6, 15) * 1.5f;
+        const auto look_at = glm::vec3(0, 0, 0);
+        const auto view = glm::lookAt(camera_position, look_at, glm::vec3(0, 1, 0));
+        antialiasing_->set_view_projection(projection * view);
+
+        update_transforms(model);
+
+        if (frustum_culling_) {
+            culler_->set_bounds(bounds_);
+            culler_->cull({ projection * view, light_projection * light_view }, 12);
+            if (report_stats_)
+                std::printf("tiles visible %d/%d camera, %d/%d light\n", culler_->visible_count(CameraView),
+                            culler_->instance_count(), culler_->visible_count(LightView), culler_->instance_count());
+        }
+
+        // shadow
+
+        glViewport(0, 0, shadow_size_, shadow_size_);
         shadow_buffer_.bind();
 
         glClear(GL_DEPTH_BUFFER_BIT);
@@ -130,7 +160,7 @@ private:
         glPolygonOffset(4, 4);
 
         glDisable(GL_CULL_FACE);
-        draw_grid(model, shadow_program_);
+        draw_grid(shadow_program_, LightView);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
         shadow_buffer_.unbind();
@@ -142,40 +172,31 @@ private:
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
-        const auto camera_position = /* glm::vec3(0, 0, 7); */ glm::vec3(0, -6, 15) * 1.5f;
-        const auto look_at = glm::vec3(0, 0, 0);
-        const auto view = glm::lookAt(camera_position, look_at, glm::vec3(0, 1, 0));
-
         shadow_buffer_.bind_texture();
 
         program_.bind();
         program_.set_uniform("viewProjectionMatrix", projection * view);
-        program_.set_uniform("modelMatrix", model);
         program_.set_uniform("lightPosition", light_position);
         program_.set_uniform("lightViewProjection", light_projection * light_view);
         program_.set_uniform("shadowMapTexture", 0);
 
-        draw_grid(model, program_);
+        draw_grid(program_, CameraView);
     }
 
-    void draw_grid(const glm::mat4 &model, gl::shader_program &program)
+    void update_transforms(const glm::mat4 &model)
     {
-        tile_.bind();
-
         float time = fmod(cur_time_, cycle_duration_);
 
-        for (int i = 0; i < GridRows; ++i)
+        for (int i = 0; i < grid_rows_; ++i)
         {
-            for (int j = 0; j < GridColumns; ++j)
+            for (int j = 0; j < grid_columns_; ++j)
             {
-                auto x = 2.0 * (j - (0.5 * GridColumns -1));
+                auto x = 2.0 * (j - (0.5 * grid_columns_ -1));
                 if (i % 2)
                     x += 1.0;
-                const auto y = 1.5 * (i - 0.5 * (GridRows - 1));
+                const auto y = 1.5 * (i - 0.5 * (grid_rows_ - 1));
                 const auto t = glm::translate(glm::mat4(1.0), glm::vec3(x, y, 0));
-                const auto &animation = flip_start_[i][j];
+                const auto &animation = flip_start_[i * grid_columns_ + j];
                 float a, h;
                 if (time < animation.s0) {
                     a = h = 0;
@@ -197,24 +218,54 @@ private:
                 glm::mat4 r0 = glm::rotate(glm::mat4(1.0), a, glm::vec3(1, 0, 0));
                 glm::mat4 r1 = glm::rotate(glm::mat4(1.0), static_cast<float>(animation.flop * 0.5 * M_PI), glm::vec3(0, 0, 1));
                 glm::mat4 ts = glm::translate(glm::mat4(1.0), glm::vec3(0, 0, h));
-                program.set_uniform("modelMatrix", model * t * ts * r1 * r0);
-                glDrawArrays(GL_LINE_LOOP, 0, 12);
+                transforms_[i * grid_columns_ + j] =
+                        gl::multiply_affine(gl::multiply_affine(t, ts), gl::multiply_affine(r1, r0));
+            }
+        }
+
+        gl::multiply_many(model, transforms_.data(), transforms_.data(), transforms_.size());
+
+        if (frustum_culling_) {
+            for (std::size_t i = 0; i < transforms_.size(); ++i) {
+                const auto center = transforms_[i] * glm::vec4(0, 0, 0, 1);
+                bounds_[i] = glm::vec4(center.x, center.y, center.z, 1);
             }
         }
+
+        std::copy(transforms_.begin(), transforms_.end(), tile_transforms_.map());
+        tile_transforms_.unmap();
+    }
+
+    void draw_grid(gl::shader_program &program, int view)
+    {
+        tile_.bind();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tile_transforms_.handle());
+        program.set_uniform("culledInstances", frustum_culling_ ? 1 : 0);
+        if (frustum_culling_)
+            culler_->draw(view, 1, GL_LINE_LOOP);
+        else
+            glDrawArraysInstanced(GL_LINE_LOOP, 0, 12, grid_rows_ * grid_columns_);
     }
 
-    static constexpr const auto GridColumns = 25;
-    static constexpr const auto GridRows = 25;
     static constexpr const auto FlipDuration = 0.8f;
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    static constexpr auto CameraView = 0;
+    static constexpr auto LightView = 1;
+    static constexpr auto NumViews = 2;
+
+    int shadow_size_;
 
+    int grid_rows_;
+    int grid_columns_;
     float cur_time_ = 0.0f;
     gl::shader_program program_;
     gl::shader_program shadow_program_;
     gl::geometry tile_;
     gl::shadow_buffer shadow_buffer_;
+    gl::buffer<glm::mat4> tile_transforms_;
+    std::vector<glm::mat4> transforms_; // the tiles' local transforms, then times the model
+    std::unique_ptr<gl::frustum_culler> culler_;
+    std::vector<glm::vec4> bounds_;
     struct TileAnimation
     {
         float s0;
@@ -223,7 +274,7 @@ private:
         float h1;
         int flop;
     };
-    std::array<std::array<TileAnimation, GridColumns>, GridRows> flip_start_;
+    std::vector<TileAnimation> flip_start_; // grid_rows_ * grid_columns_
 };
 
 int main(int argc, char *argv[])
@@ -2,9 +2,18 @@
 
 layout(location=0) in vec2 position;
 
+layout(std430, binding=1) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+};
+
+uniform bool culledInstances;
+
 out vec2 vs_position;
+out int vs_instanceID;
 
 void main(void)
 {
     vs_position = position;
+    vs_instanceID = culledInstances ? int(visibleInstances[gl_InstanceID]) : gl_InstanceID;
 }
@@ -6,8 +6,10 @@
 #include <shader_program.h>
 #include <shadow_buffer.h>
 #include <util.h>
-
-#include "blur_effect.h"
+#include <blur_effect.h>
+#include <bloom_effect.h>
+#include <frame_graph.h>
+#include <depth_prepass.h>
 
 #include <GL/glew.h>
 
@@ -19,8 +21,11 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
 
 class PlaneGeometry
 {
@@ -59,15 +64,17 @@ private:
 class DonutGeometry
 {
 public:
-    DonutGeometry()
+    DonutGeometry(int num_segments_outer, int num_segments_inner)
+        : num_segments_outer_(num_segments_outer)
+        , num_segments_inner_(num_segments_inner)
     {
-        geometry_.set_data(std::vector<Vertex>(VertexCount));
+        geometry_.set_data(std::vector<Vertex>(vertex_count()));
     }
 
     void render() const
     {
         geometry_.bind();
-        glDrawArrays(GL_TRIANGLES, 0, VertexCount);
+        glDrawArrays(GL_TRIANGLES, 0, vertex_count());
     }
 
     void update_verts(float small_radius, float big_radius, float angle_offset, float u_offset) const
@@ -75,14 +82,14 @@ public:
         glBindBuffer(GL_ARRAY_BUFFER, geometry_.array_buffer_handle());
         auto *verts = static_cast<Vertex *>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
 
-        for (int i = 0; i < NumSegmentsOuter; ++i)
+        for (int i = 0; i < num_segments_outer_; ++i)
         {
-            for (int j = 0; j < NumSegmentsInner; ++j)
+            for (int j = 0; j < num_segments_inner_; ++j)
             {
-                const auto vert_at = [angle_offset, small_radius, big_radius](int i, int j) -> std::tuple<glm::vec3, glm::vec3> {
-                    const float a = static_cast<float>(i) * 2.0 * M_PI / NumSegmentsOuter;
+                const auto vert_at = [this, angle_offset, small_radius, big_radius](int i, int j) -> std::tuple<glm::vec3, glm::vec3> {
+                    const float a = static_cast<float>(i) * 2.0 * M_PI / num_segments_outer_;
 
-                    const float b = static_cast<float>(j) * 2.0 * M_PI / NumSegmentsInner + a + angle_offset;
+                    const float b = static_cast<float>(j) * 2.0 * M_PI / num_segments_inner_ + a + angle_offset;
 
                     const auto p = glm::vec3(cosf(a) * big_radius, sinf(a) * big_radius, 0.0);
 
@@ -98,8 +105,8 @@ public:
                     return {pos, normal};
                 };
 
-                const auto i1 = (i + 1) % NumSegmentsOuter;
-                const auto j1 = (j + 1) % NumSegmentsInner;
+                const auto i1 = (i + 1) % num_segments_outer_;
+                const auto j1 = (j + 1) % num_segments_inner_;
 
                 const auto [v0, n0] = vert_at(i, j);
                 const auto [v1, n1] = vert_at(i1, j);
@@ -109,11 +116,11 @@ public:
                 const auto na = glm::normalize(n0 + n3);
                 const auto nb = glm::normalize(n1 + n2);
 
-                const auto s0 = 4.0 * (static_cast<float>(i) / NumSegmentsOuter + u_offset);
-                const auto s1 = 4.0 * (static_cast<float>(i + 1) / NumSegmentsOuter + u_offset);
+                const auto s0 = 4.0 * (static_cast<float>(i) / num_segments_outer_ + u_offset);
+                const auto s1 = 4.0 * (static_cast<float>(i + 1) / num_segments_outer_ + u_offset);
 
-                const auto t0 = static_cast<float>(j) / NumSegmentsInner;
-                const auto t1 = static_cast<float>(j + 1) / NumSegmentsInner;
+                const auto t0 = static_cast<float>(j) / num_segments_inner_;
+                const auto t1 = static_cast<float>(j + 1) / num_segments_inner_;
 
                 *verts++ = {v0, na, {s0, t0}};
                 *verts++ = {v1, nb, {s1, t0}};
@@ -129,10 +136,10 @@ public:
     }
 
 private:
-    static constexpr int NumSegmentsOuter = 128;
-    static constexpr int NumSegmentsInner = 4;
+    int vertex_count() const { return num_segments_outer_ * num_segments_inner_ * 6; }
 
-    static constexpr int VertexCount = NumSegmentsOuter * NumSegmentsInner * 6;
+    int num_segments_outer_;
+    int num_segments_inner_;
 
     using Vertex = std::tuple<glm::vec3, glm::vec3, glm::vec2>; // position, normal, uv
     gl::geometry geometry_;
@@ -143,11 +150,31 @@ class Demo : public gl::demo
 public:
     Demo(int argc, char *argv[])
         : gl::demo(argc, argv)
+        , shadow_size_(parameters_.get("shadow_size", 2048))
+        , geometry_(parameters_.get("outer_segments", 128), parameters_.get("inner_segments", 4))
         , plane_(glm::vec3(0, 0, 0), glm::vec3(50, 0, 0), glm::vec3(0, 0, 50))
-        , shadow_buffer_(ShadowWidth, ShadowHeight)
+        , shadow_buffer_(shadow_size_, shadow_size_)
+        , graph_(framebuffer_pool_)
+        , glow_passes_(parameters_.get("glow_passes", 8))
+        , glow_scale_(parameters_.get("glow_scale", 4))
+        , glow_enabled_(parameters_.get("glow", 1) != 0)
     {
-        blur_.reset(new blur_effect(width_/4, height_/4));
+        default_antialiasing_ = "none";
+        // HDR glow doesn't clip and doesn't band after many passes, so it can
+        // take a lower resolution and fewer passes; glow_exposure tone maps it
+        const gl::framebuffer_format glow_format = {
+            { gl::color_format(parameters_.get("glow_format", "r11f_g11f_b10f")) } };
+        const float glow_exposure = parameters_.get("glow_exposure", 0.0f);
+        blur_.reset(new gl::blur_effect(framebuffer_pool_, width_ / glow_scale_, height_ / glow_scale_, 4, 2.0f,
+                                        glow_format));
+        blur_->set_exposure(glow_exposure);
+        bloom_.reset(new gl::bloom_effect(framebuffer_pool_, width_ / glow_scale_, height_ / glow_scale_, 2,
+                                          glow_format));
+        bloom_->set_exposure(glow_exposure);
+        prepass_.set_enabled(depth_prepass_);
         initialize_shader();
+        initialize_frame_graph();
+        graph_.set_timing(report_timings_ || benchmark_frames_ > 0);
     }
 
 private:
@@ -171,11 +198,86 @@ private:
         cur_time_ += dt;
     }
 
+    void initialize_frame_graph()
+    {
+        const auto shadow_map = graph_.import_target("shadow map", shadow_size_, shadow_size_,
+                                                     [this] { shadow_buffer_.bind(); });
+        const auto screen = graph_.import_target("screen", width_, height_, [] { gl::framebuffer::unbind(); });
+
+        graph_.add_pass(
+                "shadow", [shadow_map](gl::frame_graph::builder &builder) { builder.write(shadow_map); },
+                [this](const gl::frame_graph::context &) { render_shadow(); });
+
+        // the effects' intermediates are transients of the graph: the
+        // reflection and glow sources have the same size and format and
+        // disjoint lifetimes, so they share a framebuffer
+        const int glow_width = width_ / glow_scale_;
+        const int glow_height = height_ / glow_scale_;
+        const auto reflection = graph_.create_target("reflection", glow_width, glow_height, blur_->source_format());
+        const auto reflection_blur =
+                graph_.create_target("reflection blur", glow_width, glow_height, blur_->target_format());
+        const auto glow = graph_.create_target("glow", glow_width, glow_height, bloom_->source_format());
+        std::vector<gl::frame_graph::resource> glow_levels = { glow };
+        for (int i = 1; i <= bloom_->levels(); ++i) {
+            glow_levels.push_back(graph_.create_target("glow level " + std::to_string(i), glow_width >> i,
+                                                       glow_height >> i, bloom_->level_format()));
+        }
+
+        const auto scene_pass = [shadow_map](gl::frame_graph::resource target) {
+            return [shadow_map, target](gl::frame_graph::builder &builder) {
+                builder.read(shadow_map);
+                builder.write(target);
+            };
+        };
+        graph_.add_pass("reflection scene", scene_pass(reflection),
+                        [this](const gl::frame_graph::context &) { render_reflection(); });
+        graph_.add_pass(
+                "blur",
+                [screen, reflection, reflection_blur](gl::frame_graph::builder &builder) {
+                    builder.read(reflection);
+                    builder.write(screen);
+                    builder.write(reflection);
+                    builder.write(reflection_blur);
+                },
+                [this, reflection, reflection_blur](const gl::frame_graph::context &ctx) {
+                    glClearColor(0.25, 0.25, 0.25, 1.0);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    blur_->render(ctx.framebuffer(reflection), ctx.framebuffer(reflection_blur), width_, height_,
+                                  glow_passes_);
+                });
+        graph_.add_pass("plane", scene_pass(screen), [this](const gl::frame_graph::context &) {
+            glEnable(GL_DEPTH_TEST);
+            draw_plane(plane_program_, view_projection_, model_, light_position_);
+        });
+        // culled with -p glow=0, nothing reads it then
+        graph_.add_pass("glow scene", scene_pass(glow), [this](const gl::frame_graph::context &) { render_glow(); });
+        graph_.add_pass("donut", scene_pass(screen), [this](const gl::frame_graph::context &) { render_donut(); });
+        if (glow_enabled_) {
+            graph_.add_pass(
+                    "bloom",
+                    [screen, glow_levels](gl::frame_graph::builder &builder) {
+                        builder.read(glow_levels[0]);
+                        builder.write(screen);
+                        for (std::size_t i = 1; i < glow_levels.size(); ++i)
+                            builder.write(glow_levels[i]);
+                    },
+                    [this, glow_levels](const gl::frame_graph::context &ctx) {
+                        std::vector<const gl::framebuffer *> levels;
+                        for (const auto level : glow_levels)
+                            levels.push_back(&ctx.framebuffer(level));
+                        bloom_->render(levels, width_, height_);
+                    });
+        }
+
+        graph_.compile();
+    }
+
+    const gl::frame_graph *graph() const override { return &graph_; }
+
     void render() override
     {
         glDisable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
-        glDisable(GL_MULTISAMPLE);
 
         {
             const float angle = cur_time_ * 2.f * M_PI / (cycle_duration_ / 2.0);
@@ -186,100 +288,77 @@ private:
 #if 1
         // const float angle = 0.5f * cosf(cur_time_ * 2.f * M_PI / cycle_duration_);
         const float angle = cur_time_ * 2.f * M_PI / cycle_duration_;
-        const auto model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0, 1, 0));
+        model_ = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0, 1, 0));
 #else
-        auto model = glm::mat4(1.0f); // glm::translate(glm::mat4(1.0f), glm::vec3(0, 1.5, 0));
+        model_ = glm::mat4(1.0f); // glm::translate(glm::mat4(1.0f), glm::vec3(0, 1.5, 0));
 #endif
 
-        const auto light_position = glm::vec3(3, 4, 3);
-
-        const auto projection =
-                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f);
+        const auto projection = camera_projection(
+                glm::perspective(glm::radians(45.0f), static_cast<float>(width_) / height_, 0.1f, 100.f));
         const auto eye = glm::vec3(0, 4, 5);
         const auto center = glm::vec3(0, 1, 0);
         const auto up = glm::vec3(0, 1, 0);
         const auto view = glm::lookAt(eye, center, up);
-        const auto viewProjection = projection * view;
-
-#if 0
-        blur_->bind();
-
-        glViewport(0, 0, blur_->width(), blur_->height());
-        glClearColor(0, 0, 0, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        draw_scene(program_, glm::vec3(0), model);
-        gl::framebuffer::unbind();
-#endif
-
-#if 0
-        blur_->render(width_, height_, 4);
-#endif
-
-        // shadow
+        view_projection_ = projection * view;
+        antialiasing_->set_view_projection(view_projection_);
 
         const auto light_projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 50.0f);
-        const auto light_view = glm::lookAt(light_position, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        const auto light_view = glm::lookAt(light_position_, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        light_view_projection_ = light_projection * light_view;
+
+        graph_.execute();
 
-        glViewport(0, 0, ShadowWidth, ShadowHeight);
-        shadow_buffer_.bind();
+        if (report_timings_)
+            graph_.print_timings();
+    }
 
+    void render_shadow()
+    {
         glClear(GL_DEPTH_BUFFER_BIT);
 
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(4, 4);
 
         glDisable(GL_CULL_FACE);
-        draw_scene(shadow_program_, glm::vec3(1), light_projection * light_view, model, light_position);
+        draw_scene(shadow_program_, glm::vec3(1), light_view_projection_, model_, light_position_);
 
         glDisable(GL_POLYGON_OFFSET_FILL);
-        shadow_buffer_.unbind();
 
         donut_program_.bind();
-        donut_program_.set_uniform("lightViewProjection", light_projection * light_view);
+        donut_program_.set_uniform("lightViewProjection", light_view_projection_);
         donut_program_.set_uniform("shadowMapTexture", 0);
 
         plane_program_.bind();
-        plane_program_.set_uniform("lightViewProjection", light_projection * light_view);
+        plane_program_.set_uniform("lightViewProjection", light_view_projection_);
         plane_program_.set_uniform("shadowMapTexture", 0);
+    }
 
-        // reflection
-
-        blur_->bind();
-        glViewport(0, 0, blur_->width(), blur_->height());
+    void render_reflection()
+    {
         glClearColor(0, 0, 0, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        draw_scene(donut_program_, glm::vec3(1), viewProjection, glm::scale(model, glm::vec3(1, -1, 1)), light_position);
-        gl::framebuffer::unbind();
-
-        // scene
-
-        glViewport(0, 0, width_, height_);
-        glClearColor(0.25, 0.25, 0.25, 1.0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        blur_->render(width_, height_, 8);
-
-        glEnable(GL_DEPTH_TEST);
-        draw_plane(plane_program_, viewProjection, model, light_position);
-
-#if 1
-        // bloom
+        draw_scene(donut_program_, glm::vec3(1), view_projection_, glm::scale(model_, glm::vec3(1, -1, 1)), light_position_);
+    }
 
-        blur_->bind();
-        glViewport(0, 0, blur_->width(), blur_->height());
+    void render_glow()
+    {
         glClearColor(0, 0, 0, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        draw_scene(donut_program_, glm::vec3(0), viewProjection, model, light_position);
-        gl::framebuffer::unbind();
+        draw_scene(donut_program_, glm::vec3(0), view_projection_, model_, light_position_);
+    }
 
-        glViewport(0, 0, width_, height_);
-        draw_scene(donut_program_, glm::vec3(1), viewProjection, model, light_position);
+    void render_donut()
+    {
+        if (prepass_.enabled()) {
+            prepass_.begin_depth();
+            draw_scene(shadow_program_, glm::vec3(1), view_projection_, model_, light_position_);
+        }
+        prepass_.begin_color();
+        draw_scene(donut_program_, glm::vec3(1), view_projection_, model_, light_position_);
+        prepass_.end();
 
-        blur_->render(width_, height_, 8);
-#else
-        draw_scene(donut_program_, glm::vec3(1), viewProjection, model);
-#endif
+        if (report_stats_)
+            std::printf("donut overdraw: %.3f\n", prepass_.overdraw(width_, height_));
     }
 
     void draw_plane(gl::shader_program &program, const glm::mat4 &viewProjection, const glm::mat4 &model, const glm::vec3 &light_position)
@@ -329,15 +408,24 @@ private:
     static constexpr float DonutRadius = 1.0f;
     static constexpr float DonutSmallRadius = 0.25f;
 
-    static constexpr auto ShadowWidth = 2048;
-    static constexpr auto ShadowHeight = ShadowWidth;
+    int shadow_size_;
 
     float cur_time_ = 0;
     gl::shader_program donut_program_, plane_program_, shadow_program_;
     DonutGeometry geometry_;
     PlaneGeometry plane_;
-    std::unique_ptr<blur_effect> blur_;
+    std::unique_ptr<gl::blur_effect> blur_;
+    std::unique_ptr<gl::bloom_effect> bloom_;
     gl::shadow_buffer shadow_buffer_;
+    gl::frame_graph graph_;
+    int glow_passes_;
+    int glow_scale_;
+    bool glow_enabled_;
+    gl::depth_prepass prepass_;
+    glm::vec3 light_position_ = glm::vec3(3, 4, 3);
+    glm::mat4 model_;
+    glm::mat4 view_projection_;
+    glm::mat4 light_view_projection_;
 };
 
 int main(int argc, char *argv[])
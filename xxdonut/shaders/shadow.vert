@@ -4,6 +4,8 @@ layout(location=0) in vec3 position;
 
 uniform mat4 mvp;
 
+invariant gl_Position;
+
 void main(void)
 {
     gl_Position = mvp * vec4(position, 1.0);